@@ -6,14 +6,37 @@
 # See file LICENSE for details.
 ############################################################################
 
+import io
 import os.path
 from struct import Struct
 import sys
+import zlib
 from signal import signal, SIGPIPE, SIG_DFL
 signal(SIGPIPE, SIG_DFL)
 
 from Bio.Seq import Seq
 
+#---- Block-compressed framing (see io/binary/block_stream.hpp) ----------------
+BLOCK_MAGIC = b"SPBZ"
+BLOCK_FRAME = Struct("=III") # raw size, packed size, crc32
+
+def open_save(filename):
+    with open(filename, "rb") as file:
+        header = file.read(len(BLOCK_MAGIC) + 8)
+        if not header.startswith(BLOCK_MAGIC):
+            return io.BytesIO(header + file.read())
+        data = bytearray()
+        while True:
+            frame = file.read(BLOCK_FRAME.size)
+            if len(frame) < BLOCK_FRAME.size:
+                break
+            raw_size, packed_size, crc = BLOCK_FRAME.unpack(frame)
+            block = zlib.decompress(file.read(packed_size))
+            if len(block) != raw_size or zlib.crc32(block) != crc:
+                raise IOError("Corrupted block in " + filename)
+            data += block
+        return io.BytesIO(bytes(data))
+
 def read_int(file, size=None, signed=False):
     if size:
         bytes = file.read(size)
@@ -147,5 +170,5 @@ basename, ext = os.path.splitext(sys.argv[1])
 target = ext
 if ext in [".grp", ".sqn"]:
     target = ".grseq"
-with open(basename + target, "rb") as file:
+with open_save(basename + target) as file:
     showers[ext](file)
@@ -81,6 +81,7 @@ class Dijkstra {
 
     void Init(VertexId start, queue_t &queue) {
         vertex_number_ = 0;
+        vertex_limit_exceeded_ = false;
         distances_.clear();
         processed_vertices_.clear();
         prev_vert_map_.clear();
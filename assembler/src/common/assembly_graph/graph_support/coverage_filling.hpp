@@ -2,6 +2,9 @@
 
 #include "assembly_graph/core/coverage.hpp"
 #include "assembly_graph/graph_support/detail_coverage.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+
+#include <vector>
 
 namespace debruijn_graph {
 
@@ -26,13 +29,45 @@ struct SimultaneousCoverageCollector<utils::InvertableStoring> {
     }
 };
 
+/**
+ * Values of the count index are split between threads, every thread accumulates coverage
+ * into its own arrays indexed by edge id, arrays are summed up and added to the graph at the end.
+ * Since raw coverages are integral, the result is identical to the sequential fill.
+ */
 template<class Graph, class CountIndex>
 class SimultaneousCoverageFiller {
+    typedef typename Graph::EdgeId EdgeId;
+    typedef typename CountIndex::KmerPos Value;
+
     const Graph& g_;
     const CountIndex& count_index_;
     omnigraph::FlankingCoverage<Graph>& flanking_coverage_;
     omnigraph::CoverageIndex<Graph>& coverage_index_;
-    typedef typename CountIndex::KmerPos Value;
+
+    class LocalCoverage {
+        const Graph &g_;
+        size_t averaging_range_;
+    public:
+        std::vector<unsigned> coverage;
+        std::vector<unsigned> flanking;
+
+        LocalCoverage(const Graph &g, size_t averaging_range, size_t id_bound)
+                : g_(g), averaging_range_(averaging_range),
+                  coverage(id_bound, 0), flanking(id_bound, 0) {}
+
+        const Graph& g() const {
+            return g_;
+        }
+
+        void inc_coverage(const Value &edge_info) {
+            uint64_t id = edge_info.edge().int_id();
+            coverage[id] += edge_info.count();
+            if (edge_info.offset() < averaging_range_) {
+                flanking[id] += edge_info.count();
+            }
+        }
+    };
+
 public:
     SimultaneousCoverageFiller(const Graph& g, const CountIndex& count_index,
                                omnigraph::FlankingCoverage<Graph>& flanking_coverage,
@@ -51,24 +86,49 @@ public:
         return g_;
     }
 
-    void inc_coverage(const Value &edge_info) {
-        coverage_index_.IncRawCoverage(edge_info.edge(), edge_info.count());
-        if (edge_info.offset() < flanking_coverage_.averaging_range()) {
-            flanking_coverage_.IncRawCoverage(edge_info.edge(), edge_info.count());
+    void Fill() {
+        std::vector<EdgeId> edges;
+        size_t id_bound = 0;
+        for (auto it = g_.ConstEdgeBegin(); !it.IsEnd(); ++it) {
+            edges.push_back(*it);
+            id_bound = std::max(id_bound, size_t((*it).int_id()) + 1);
         }
-    }
 
-    void Fill() {
-        for (auto I = count_index_.value_cbegin(), E = count_index_.value_cend();
-             I != E; ++I) {
-            const auto& edge_info = *I;
+        size_t nthreads = omp_get_max_threads();
+        std::vector<LocalCoverage> local;
+        local.reserve(nthreads);
+        for (size_t i = 0; i < nthreads; ++i)
+            local.emplace_back(g_, flanking_coverage_.averaging_range(), id_bound);
+
+        auto values = count_index_.value_cbegin();
+        size_t size = count_index_.value_cend() - values;
+        size_t invalid = 0;
+#       pragma omp parallel for schedule(guided) reduction(+:invalid)
+        for (size_t i = 0; i < size; ++i) {
+            const auto& edge_info = values[i];
             //VERIFY(edge_info.valid());
             if (edge_info.valid()) {
-                SimultaneousCoverageCollector<typename CountIndex::storing_type>::CollectCoverage(*this, edge_info);
+                SimultaneousCoverageCollector<typename CountIndex::storing_type>::CollectCoverage(local[omp_get_thread_num()], edge_info);
             } else {
                 VERIFY(edge_info.removed());
-                WARN("Duplicating k+1-mers in graph (known bug in construction)");
+                invalid += 1;
+            }
+        }
+        if (invalid)
+            WARN("Duplicating k+1-mers in graph (known bug in construction): " << invalid << " k+1-mers");
+
+#       pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < edges.size(); ++i) {
+            EdgeId e = edges[i];
+            unsigned coverage = 0, flanking = 0;
+            for (const auto &l : local) {
+                coverage += l.coverage[e.int_id()];
+                flanking += l.flanking[e.int_id()];
             }
+            if (coverage)
+                coverage_index_.IncRawCoverage(e, coverage);
+            if (flanking)
+                flanking_coverage_.IncRawCoverage(e, flanking);
         }
     }
 };
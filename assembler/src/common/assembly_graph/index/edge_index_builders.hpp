@@ -9,6 +9,7 @@
 
 #include "edge_info_updater.hpp"
 #include "utils/ph_map/perfect_hash_map_builder.hpp"
+#include "utils/memory_limit.hpp"
 
 namespace debruijn_graph {
 
@@ -101,7 +102,15 @@ public:
                                   utils::StoringTypeFilter<typename Index::storing_type>>
                 splitter(workdir, index.k(), g, read_buffer_size);
         utils::KMerDiskCounter<RtSeq> counter(workdir, splitter);
-        BuildIndex(index, counter, 16, nthreads);
+
+        // Graph k-mers are known in advance, so choose the number of buckets to make
+        // buckets being processed simultaneously fit into memory budget
+        size_t kmers = 0;
+        for (auto it = g.ConstEdgeBegin(); !it.IsEnd(); ++it)
+            kmers += g.length(*it) + 1;
+        unsigned num_buckets = utils::MemoryGovernor::instance().BucketCount(
+            kmers * RtSeq::GetDataSize(index.k()) * sizeof(RtSeq::DataType), nthreads, 16, 256);
+        BuildIndex(index, counter, num_buckets, nthreads);
 
         // Now use the index to fill the coverage and EdgeId's
         INFO("Collecting edge information from graph, this takes a while.");
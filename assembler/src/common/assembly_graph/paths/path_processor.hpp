@@ -40,6 +40,10 @@ public:
 
         virtual void HandleReversedPath(const std::vector<EdgeId> &reversed_path) = 0;
 
+        //Traversal stops as soon as it returns true
+        virtual bool Finished() const {
+            return false;
+        }
 
     protected:
         Path ReversePath(const Path &path) const {
@@ -66,6 +70,7 @@ private:
         Path reversed_edge_path_;
         adt::bag<VertexId> vertex_cnts_;
         bool usage_limit_triggered_;
+        bool stopped_;
 
         const Graph& g_;
         const DijkstraT& dijkstra_;
@@ -106,7 +111,7 @@ private:
             return true;
         }
 
-        //returns true iff call number limit exceeded
+        //returns true iff call number limit exceeded or the callback has finished
         bool Go(VertexId v, const size_t min_len) {
             TRACE("Got to vertex " << g_.str(v));
             if (++call_cnt_ >= PathProcessor::MAX_CALL_CNT) {
@@ -117,6 +122,10 @@ private:
             if (v == outer_.start_ && curr_len_ >= min_len) {
                 //TRACE("New path found: " << PrintPath(g_, path_));
                 callback_.HandleReversedPath(reversed_edge_path_);
+                if (callback_.Finished()) {
+                    stopped_ = true;
+                    return true;
+                }
             }
 
             TRACE("Iterating through incoming edges of vertex " << g_.int_id(v))
@@ -158,6 +167,7 @@ private:
             edge_depth_bound_(edge_depth_bound),
             curr_len_(0), curr_depth_(0), call_cnt_(0),
             usage_limit_triggered_(false),
+            stopped_(false),
             g_(outer.g_),
             dijkstra_(outer.dijkstra_) {
             reversed_edge_path_.reserve(PathProcessor::MAX_CALL_CNT);
@@ -170,7 +180,7 @@ private:
                 return false;
             }
 
-            bool call_limit_triggered = Go(end_, min_len_);
+            bool call_limit_triggered = Go(end_, min_len_) && !stopped_;
             VERIFY(curr_len_ == 0);
             VERIFY(curr_depth_ == 0);
             vertex_cnts_.take(end_);
@@ -189,6 +199,20 @@ public:
               start_(start),
               dijkstra_(DijkstraHelper<Graph>::CreateBoundedDijkstra(g, length_bound,
                                                                      dijkstra_vertex_limit)) {
+        Reset(start);
+    }
+
+    //Processor without a start vertex, Reset should be called before Process
+    PathProcessor(const Graph& g, size_t length_bound,
+                  size_t dijkstra_vertex_limit = MAX_DIJKSTRA_VERTICES) :
+              g_(g),
+              dijkstra_(DijkstraHelper<Graph>::CreateBoundedDijkstra(g, length_bound,
+                                                                     dijkstra_vertex_limit)) {
+    }
+
+    //Relaunches the search from the new start vertex reusing the allocated dijkstra storage
+    void Reset(VertexId start) {
+        start_ = start;
         TRACE("Dijkstra launched");
         dijkstra_.Run(start);
         TRACE("Dijkstra finished");
@@ -256,6 +280,29 @@ public:
 
 };
 
+//Stops the traversal on the first path found
+template<class Graph>
+class PathExistenceCallback: public PathProcessor<Graph>::Callback {
+    typedef typename Graph::EdgeId EdgeId;
+    typedef std::vector<EdgeId> Path;
+    bool found_;
+public:
+    PathExistenceCallback() :
+        found_(false) {}
+
+    void HandleReversedPath(const Path&) override {
+        found_ = true;
+    }
+
+    bool Finished() const override {
+        return found_;
+    }
+
+    bool found() const {
+        return found_;
+    }
+};
+
 template<class Graph, class Comparator>
 class BestPathStorage: public PathProcessor<Graph>::Callback {
     typedef typename Graph::EdgeId EdgeId;
@@ -302,6 +349,10 @@ public:
         return paths_;
     }
 
+    void Clear() {
+        paths_.clear();
+    }
+
 private:
     const Graph& g_;
     std::vector<Path> paths_;
@@ -0,0 +1,157 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "assembly_graph/dijkstra/dijkstra_helper.hpp"
+#include "utils/verify.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace omnigraph {
+
+/**
+ * @brief Computes the sets of lengths of all walks (not only simple paths) from the start
+ *        vertex to every vertex within the length bound in a single sweep.
+ *        Length sets are stored as bitsets of (max_len + 1) bits, new bits are propagated
+ *        along the edges until nothing changes. Only vertices reached by the bounded Dijkstra
+ *        are considered, the same way as PathProcessor does, so for any pair of vertices
+ *        the result equals the set of lengths of paths enumerated by PathProcessor (unless
+ *        the enumeration was cut by its call / vertex usage limits).
+ */
+template<class Graph>
+class ReachableLengths {
+    typedef typename Graph::VertexId VertexId;
+    typedef typename Graph::EdgeId EdgeId;
+    typedef uint64_t Word;
+    static constexpr size_t WORD_BITS = 64;
+
+public:
+    ReachableLengths(const Graph &g, VertexId start, size_t max_len,
+                     size_t dijkstra_vertex_limit = MAX_DIJKSTRA_VERTICES)
+            : g_(g), max_len_(max_len), words_(max_len / WORD_BITS + 1) {
+        auto dijkstra = DijkstraHelper<Graph>::CreateBoundedDijkstra(g, max_len, dijkstra_vertex_limit);
+        dijkstra.Run(start);
+        for (VertexId v : dijkstra.ReachedVertices()) {
+            if (dijkstra.GetDistance(v) > max_len)
+                continue;
+            size_t idx = ids_.size();
+            ids_[v] = idx;
+        }
+        bits_.assign(ids_.size() * words_, 0);
+
+        Propagate(start);
+    }
+
+    /**
+     * @return sorted lengths of walks from start to v within [min_len, max_len]
+     */
+    std::vector<size_t> Lengths(VertexId v, size_t min_len) const {
+        std::vector<size_t> res;
+        auto it = ids_.find(v);
+        if (it == ids_.end())
+            return res;
+
+        const Word *set = bits_.data() + it->second * words_;
+        for (size_t w = min_len / WORD_BITS; w < words_; ++w) {
+            Word word = set[w];
+            while (word) {
+                size_t len = w * WORD_BITS + __builtin_ctzll(word);
+                word &= word - 1;
+                if (len >= min_len && len <= max_len_)
+                    res.push_back(len);
+            }
+        }
+        return res;
+    }
+
+    // Same as PathProcessor
+    static const size_t MAX_DIJKSTRA_VERTICES = 3000;
+
+private:
+    void Propagate(VertexId start) {
+        auto start_it = ids_.find(start);
+        if (start_it == ids_.end())
+            return;
+
+        // Bits which were set but not yet pushed along outgoing edges
+        std::vector<Word> pending(bits_.size(), 0);
+        std::vector<bool> queued(ids_.size(), false);
+        std::vector<std::pair<VertexId, size_t>> queue;
+
+        bits_[start_it->second * words_] = pending[start_it->second * words_] = 1;
+        queue.emplace_back(start, start_it->second);
+        queued[start_it->second] = true;
+
+        std::vector<Word> shifted(words_);
+        for (size_t head = 0; head < queue.size(); ++head) {
+            VertexId u = queue[head].first;
+            size_t uid = queue[head].second;
+            queued[uid] = false;
+
+            std::vector<Word> delta(pending.begin() + uid * words_, pending.begin() + (uid + 1) * words_);
+            std::fill(pending.begin() + uid * words_, pending.begin() + (uid + 1) * words_, 0);
+
+            for (EdgeId e : g_.OutgoingEdges(u)) {
+                auto it = ids_.find(g_.EdgeEnd(e));
+                if (it == ids_.end())
+                    continue;
+                size_t vid = it->second;
+
+                if (!ShiftLeft(delta, g_.length(e), shifted))
+                    continue;
+
+                bool updated = false;
+                Word *set = bits_.data() + vid * words_, *pend = pending.data() + vid * words_;
+                for (size_t w = 0; w < words_; ++w) {
+                    Word fresh = shifted[w] & ~set[w];
+                    if (!fresh)
+                        continue;
+                    set[w] |= fresh;
+                    pend[w] |= fresh;
+                    updated = true;
+                }
+
+                if (updated && !queued[vid]) {
+                    queued[vid] = true;
+                    queue.emplace_back(it->first, vid);
+                }
+            }
+        }
+    }
+
+    // res = (src << shift) truncated to max_len_ bits. Returns false if res is empty.
+    bool ShiftLeft(const std::vector<Word> &src, size_t shift, std::vector<Word> &res) const {
+        std::fill(res.begin(), res.end(), 0);
+        if (shift > max_len_)
+            return false;
+
+        size_t word_shift = shift / WORD_BITS, bit_shift = shift % WORD_BITS;
+        Word any = 0;
+        for (size_t w = words_; w-- > word_shift; ) {
+            Word val = src[w - word_shift] << bit_shift;
+            if (bit_shift && w > word_shift)
+                val |= src[w - word_shift - 1] >> (WORD_BITS - bit_shift);
+            res[w] = val;
+        }
+        // Clear the bits beyond max_len_
+        size_t tail = (max_len_ + 1) % WORD_BITS;
+        if (tail)
+            res[words_ - 1] &= (Word(1) << tail) - 1;
+        for (Word w : res)
+            any |= w;
+        return any != 0;
+    }
+
+    const Graph &g_;
+    size_t max_len_;
+    size_t words_;
+    std::unordered_map<VertexId, size_t> ids_;
+    std::vector<Word> bits_;
+};
+
+}
@@ -20,7 +20,9 @@ class BasicGraphIO : public GraphIO<Graph> {
 public:
     void Save(const std::string &basename, const Graph &graph) override {
         Base::Save(basename, graph);
-        io::binary::Save(basename, graph.coverage_index());
+        CoverageIO<Graph> coverage_io;
+        coverage_io.SetCompression(this->compression());
+        coverage_io.Save(basename, graph.coverage_index());
     }
 
     bool Load(const std::string &basename, Graph &graph) override {
@@ -0,0 +1,201 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "block_stream.hpp"
+
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/verify.hpp"
+
+#include <zlib.h>
+
+#include <cstring>
+
+namespace io {
+
+namespace binary {
+
+const char BlockFormat::MAGIC[4] = { 'S', 'P', 'B', 'Z' };
+
+namespace {
+
+struct FrameHeader {
+    uint32_t raw_size;
+    uint32_t packed_size;
+    uint32_t crc;
+};
+
+uint32_t Checksum(const std::vector<char> &data) {
+    return (uint32_t)crc32(0, reinterpret_cast<const Bytef*>(data.data()), (uInt)data.size());
+}
+
+unsigned DefaultThreads(unsigned nthreads) {
+    return nthreads ? nthreads : (unsigned)omp_get_max_threads();
+}
+
+}
+
+BlockCompressedOStreamBuf::BlockCompressedOStreamBuf(std::ostream &os, size_t block_size,
+                                                     int level, unsigned nthreads)
+        : os_(os), block_size_(block_size), level_(level),
+          nthreads_(DefaultThreads(nthreads)),
+          raw_size_(0), stored_size_(0) {
+    VERIFY(block_size_ > 0 && block_size_ < (1ull << 31));
+    uint32_t version = BlockFormat::VERSION, bs = (uint32_t)block_size_;
+    os_.write(BlockFormat::MAGIC, sizeof(BlockFormat::MAGIC));
+    os_.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    os_.write(reinterpret_cast<const char*>(&bs), sizeof(bs));
+    stored_size_ += sizeof(BlockFormat::MAGIC) + sizeof(version) + sizeof(bs);
+
+    current_.resize(block_size_);
+    setp(current_.data(), current_.data() + current_.size());
+}
+
+BlockCompressedOStreamBuf::~BlockCompressedOStreamBuf() {
+    sync();
+}
+
+void BlockCompressedOStreamBuf::SealBlock() {
+    size_t size = pptr() - pbase();
+    if (!size)
+        return;
+
+    current_.resize(size);
+    raw_size_ += size;
+    batch_.push_back(std::move(current_));
+    current_.resize(block_size_);
+    setp(current_.data(), current_.data() + current_.size());
+
+    if (batch_.size() >= nthreads_)
+        FlushBatch();
+}
+
+void BlockCompressedOStreamBuf::FlushBatch() {
+    if (batch_.empty())
+        return;
+
+    std::vector<std::vector<char>> packed(batch_.size());
+    std::vector<FrameHeader> headers(batch_.size());
+#   pragma omp parallel for num_threads(nthreads_) schedule(static, 1)
+    for (size_t i = 0; i < batch_.size(); ++i) {
+        const auto &raw = batch_[i];
+        uLongf packed_size = compressBound((uLong)raw.size());
+        packed[i].resize(packed_size);
+        int res = compress2(reinterpret_cast<Bytef*>(packed[i].data()), &packed_size,
+                            reinterpret_cast<const Bytef*>(raw.data()), (uLong)raw.size(), level_);
+        VERIFY_MSG(res == Z_OK, "Block compression failed, zlib error " << res);
+        packed[i].resize(packed_size);
+        headers[i] = { (uint32_t)raw.size(), (uint32_t)packed_size, Checksum(raw) };
+    }
+
+    for (size_t i = 0; i < batch_.size(); ++i) {
+        os_.write(reinterpret_cast<const char*>(&headers[i]), sizeof(headers[i]));
+        os_.write(packed[i].data(), packed[i].size());
+        stored_size_ += sizeof(headers[i]) + packed[i].size();
+    }
+    batch_.clear();
+}
+
+BlockCompressedOStreamBuf::int_type BlockCompressedOStreamBuf::overflow(int_type ch) {
+    SealBlock();
+    if (traits_type::eq_int_type(ch, traits_type::eof()))
+        return traits_type::not_eof(ch);
+
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+    return ch;
+}
+
+int BlockCompressedOStreamBuf::sync() {
+    SealBlock();
+    FlushBatch();
+    os_.flush();
+    return os_ ? 0 : -1;
+}
+
+BlockCompressedIStreamBuf::BlockCompressedIStreamBuf(std::istream &is, unsigned nthreads)
+        : is_(is), nthreads_(DefaultThreads(nthreads)), compressed_(false), next_(0) {
+    char header[sizeof(BlockFormat::MAGIC) + 2 * sizeof(uint32_t)];
+    is_.read(header, sizeof(header));
+    size_t read = (size_t)is_.gcount();
+    if (read == sizeof(header) &&
+        memcmp(header, BlockFormat::MAGIC, sizeof(BlockFormat::MAGIC)) == 0) {
+        uint32_t version;
+        memcpy(&version, header + sizeof(BlockFormat::MAGIC), sizeof(version));
+        VERIFY_MSG(version == BlockFormat::VERSION, "Unsupported block format version " << version);
+        compressed_ = true;
+    } else {
+        // Not our format: hand out already consumed bytes first
+        raw_.assign(header, header + read);
+        setg(raw_.data(), raw_.data(), raw_.data() + raw_.size());
+    }
+}
+
+bool BlockCompressedIStreamBuf::FillBatch() {
+    std::vector<FrameHeader> headers;
+    std::vector<std::vector<char>> packed;
+    while (headers.size() < nthreads_) {
+        FrameHeader h;
+        if (!is_.read(reinterpret_cast<char*>(&h), sizeof(h)))
+            break;
+        packed.emplace_back(h.packed_size);
+        is_.read(packed.back().data(), h.packed_size);
+        VERIFY_MSG(is_, "Truncated compressed block");
+        headers.push_back(h);
+    }
+    if (headers.empty())
+        return false;
+
+    batch_.resize(headers.size());
+#   pragma omp parallel for num_threads(nthreads_) schedule(static, 1)
+    for (size_t i = 0; i < headers.size(); ++i) {
+        auto &raw = batch_[i];
+        raw.resize(headers[i].raw_size);
+        uLongf raw_size = headers[i].raw_size;
+        int res = uncompress(reinterpret_cast<Bytef*>(raw.data()), &raw_size,
+                             reinterpret_cast<const Bytef*>(packed[i].data()), headers[i].packed_size);
+        VERIFY_MSG(res == Z_OK && raw_size == headers[i].raw_size,
+                   "Block decompression failed, zlib error " << res);
+        VERIFY_MSG(Checksum(raw) == headers[i].crc, "Block checksum mismatch");
+    }
+    next_ = 0;
+    return true;
+}
+
+bool BlockCompressedIStreamBuf::FillRaw() {
+    raw_.resize(BlockFormat::DEFAULT_BLOCK_SIZE);
+    is_.read(raw_.data(), raw_.size());
+    raw_.resize((size_t)is_.gcount());
+    if (raw_.empty())
+        return false;
+
+    setg(raw_.data(), raw_.data(), raw_.data() + raw_.size());
+    return true;
+}
+
+BlockCompressedIStreamBuf::int_type BlockCompressedIStreamBuf::underflow() {
+    if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+
+    if (!compressed_) {
+        if (!FillRaw())
+            return traits_type::eof();
+        return traits_type::to_int_type(*gptr());
+    }
+
+    // Skip empty blocks, if any
+    do {
+        if (next_ == batch_.size() && !FillBatch())
+            return traits_type::eof();
+        auto &block = batch_[next_++];
+        setg(block.data(), block.data(), block.data() + block.size());
+    } while (gptr() == egptr());
+
+    return traits_type::to_int_type(*gptr());
+}
+
+} // namespace binary
+
+} // namespace io
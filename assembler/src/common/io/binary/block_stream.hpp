@@ -0,0 +1,133 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace io {
+
+namespace binary {
+
+/**
+ * @brief  Block-compressed framing for binary saves.
+ *         A file starts with a header (magic, version, block size) followed by
+ *         frames (raw size, packed size, CRC32 of the raw data, deflated payload).
+ *         Blocks are deflated / inflated in batches, one block per thread.
+ */
+struct BlockFormat {
+    static const char MAGIC[4];
+    static const uint32_t VERSION = 1;
+    static const size_t DEFAULT_BLOCK_SIZE = 4 << 20;
+};
+
+class BlockCompressedOStreamBuf : public std::streambuf {
+public:
+    BlockCompressedOStreamBuf(std::ostream &os,
+                              size_t block_size = BlockFormat::DEFAULT_BLOCK_SIZE,
+                              int level = 1, unsigned nthreads = 0);
+    ~BlockCompressedOStreamBuf() override;
+
+    size_t raw_size() const { return raw_size_; }
+    size_t stored_size() const { return stored_size_; }
+
+protected:
+    int_type overflow(int_type ch) override;
+    int sync() override;
+
+private:
+    void SealBlock();
+    void FlushBatch();
+
+    std::ostream &os_;
+    size_t block_size_;
+    int level_;
+    unsigned nthreads_;
+    std::vector<std::vector<char>> batch_;
+    std::vector<char> current_;
+    size_t raw_size_, stored_size_;
+};
+
+/**
+ * @brief  Reads block-compressed data verifying block checksums. Input without
+ *         the block header is passed through unchanged, so plain binary saves
+ *         could be read via the same stream.
+ */
+class BlockCompressedIStreamBuf : public std::streambuf {
+public:
+    BlockCompressedIStreamBuf(std::istream &is, unsigned nthreads = 0);
+
+    bool compressed() const { return compressed_; }
+
+protected:
+    int_type underflow() override;
+
+private:
+    bool FillBatch();
+    bool FillRaw();
+
+    std::istream &is_;
+    unsigned nthreads_;
+    bool compressed_;
+    std::vector<std::vector<char>> batch_;
+    size_t next_;
+    std::vector<char> raw_;
+};
+
+class BlockCompressedOFStream : public std::ostream {
+public:
+    BlockCompressedOFStream(const std::string &filename,
+                            size_t block_size = BlockFormat::DEFAULT_BLOCK_SIZE,
+                            int level = 1)
+            : std::ostream(nullptr),
+              file_(filename, std::ios::binary),
+              buf_(file_, block_size, level) {
+        rdbuf(&buf_);
+        if (!file_.is_open())
+            setstate(std::ios::failbit);
+    }
+
+    void close() {
+        flush();
+        if (!file_)
+            setstate(std::ios::badbit);
+        file_.close();
+    }
+
+    size_t raw_size() const { return buf_.raw_size(); }
+    size_t stored_size() const { return buf_.stored_size(); }
+
+private:
+    std::ofstream file_;
+    BlockCompressedOStreamBuf buf_;
+};
+
+class BlockCompressedIFStream : public std::istream {
+public:
+    BlockCompressedIFStream(const std::string &filename)
+            : std::istream(nullptr),
+              file_(filename, std::ios::binary),
+              buf_(file_) {
+        rdbuf(&buf_);
+        if (!file_.is_open())
+            setstate(std::ios::failbit);
+    }
+
+    bool compressed() const { return buf_.compressed(); }
+
+private:
+    std::ifstream file_;
+    BlockCompressedIStreamBuf buf_;
+};
+
+} // namespace binary
+
+} // namespace io
@@ -8,6 +8,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include <fstream>
+#include <functional>
 #include <memory>
 
 #include "basic.hpp"
@@ -19,6 +22,7 @@
 #include "paired_index.hpp"
 #include "positions.hpp"
 #include "pipeline/graph_pack.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
 namespace io {
 
@@ -31,21 +35,30 @@ class BasePackIO : public IOBase<debruijn_graph::graph_pack<Graph>> {
 public:
     typedef typename debruijn_graph::graph_pack<Graph> Type;
 
-    void Save(const std::string &basename, const Type &gp) override {
-        //1. Save basic graph
-        graph_io_.Save(basename, gp.g);
-
-        //2. Save edge positions
-        SaveAttached(basename, gp.edge_pos);
-
-        //3. Save kmer edge index
-        SaveAttached(basename, gp.index);
+    BasePackIO(bool compress = false) {
+        this->SetCompression(compress);
+    }
 
-        //4. Save kmer mapper
-        SaveAttached(basename, gp.kmer_mapper);
+    void Save(const std::string &basename, const Type &gp) override {
+        auto components = SaveJobs(basename, gp);
+
+        // Every component goes into its own set of files, so they could be written concurrently.
+        // Compressed blocks of each component are deflated in a nested parallel region,
+        // the threads are split between the components and the blocks.
+        unsigned nthreads = (unsigned)omp_get_max_threads();
+        unsigned outer = (unsigned)std::max<size_t>(1, std::min<size_t>(nthreads, components.size()));
+        unsigned inner = std::max(1u, nthreads / outer);
+        int levels = omp_get_max_active_levels();
+        omp_set_max_active_levels(std::max(levels, 2));
+#       pragma omp parallel for num_threads(outer) schedule(dynamic, 1)
+        for (size_t i = 0; i < components.size(); ++i) {
+            omp_set_num_threads((int)inner);
+            components[i].run();
+        }
+        omp_set_max_active_levels(levels);
+        omp_set_num_threads((int)nthreads);
 
-        //5. Save flanking coverage
-        SaveAttached(basename, gp.flanking_cov);
+        WriteManifest(basename, components);
     }
 
     bool Load(const std::string &basename, Type &gp) override {
@@ -55,22 +68,51 @@ public:
         DetachIfAttached(gp.kmer_mapper);
         DetachIfAttached(gp.flanking_cov);
 
-        //1. Load basic graph
-        graph_io_.Load(basename, gp.g);
+        // Components refer to graph edges, so they are loaded one by one, graph first.
+        // Compressed blocks of each component are inflated in parallel.
+        for (const auto &component : LoadJobs(basename, gp))
+            component.run();
 
-        //2. Load edge positions
-        LoadAttached(basename, gp.edge_pos);
-
-        //3. Load kmer edge index
-        LoadAttached(basename, gp.index);
+        return true;
+    }
 
-        //4. Load kmer mapper
-        LoadAttached(basename, gp.kmer_mapper);
+    /**
+     * @brief  Loads a single component (as named in the manifest) of the saved graph pack.
+     *         All components except "graph" expect the graph to be loaded already.
+     */
+    void LoadComponent(const std::string &basename, const std::string &name, Type &gp) {
+        auto manifest = ReadManifest(basename);
+        VERIFY_MSG(std::find(manifest.begin(), manifest.end(), name) != manifest.end(),
+                   "Component " << name << " is missing in " << ManifestName(basename));
+        for (const auto &component : LoadJobs(basename, gp)) {
+            if (component.name == name) {
+                DEBUG("Loading component " << name);
+                component.run();
+                return;
+            }
+        }
+        FATAL_ERROR("Unknown graph pack component " << name);
+    }
 
-        //5. Load flanking coverage
-        LoadAttached(basename, gp.flanking_cov);
+    static std::string ManifestName(const std::string &basename) {
+        return basename + ".manifest";
+    }
 
-        return true;
+    /**
+     * @return names of the components listed in the manifest, in the order of saving
+     */
+    static std::vector<std::string> ReadManifest(const std::string &basename) {
+        std::string filename = ManifestName(basename);
+        VERIFY_MSG(fs::check_existence(filename), "File not found: " + filename);
+        std::ifstream is(filename);
+        std::vector<std::string> res;
+        std::string line;
+        while (std::getline(is, line)) {
+            std::string name = line.substr(0, line.find('\t'));
+            if (!name.empty() && (res.empty() || res.back() != name))
+                res.push_back(name);
+        }
+        return res;
     }
 
     virtual void BinWrite(std::ostream &os, const Type &gp)  {
@@ -116,6 +158,59 @@ public:
     }
 
 protected:
+    struct Component {
+        std::string name;
+        std::vector<std::string> files;
+        std::function<void()> run;
+    };
+
+    virtual std::vector<Component> SaveJobs(const std::string &basename, const Type &gp) {
+        graph_io_.SetCompression(this->compression());
+        CoverageIO<Graph> coverage_io;
+        return {
+            { "graph", { graph_io_.FileName(basename), coverage_io.FileName(basename) },
+              [this, basename, &gp] { graph_io_.Save(basename, gp.g); } },
+            SaveAttachedJob("edge positions", basename, gp.edge_pos),
+            SaveAttachedJob("edge index", basename, gp.index),
+            SaveAttachedJob("kmer mapper", basename, gp.kmer_mapper),
+            SaveAttachedJob("flanking coverage", basename, gp.flanking_cov)
+        };
+    }
+
+    virtual std::vector<Component> LoadJobs(const std::string &basename, Type &gp) {
+        return {
+            { "graph", {}, [this, basename, &gp] { graph_io_.Load(basename, gp.g); } },
+            LoadAttachedJob("edge positions", basename, gp.edge_pos),
+            LoadAttachedJob("edge index", basename, gp.index),
+            LoadAttachedJob("kmer mapper", basename, gp.kmer_mapper),
+            LoadAttachedJob("flanking coverage", basename, gp.flanking_cov)
+        };
+    }
+
+    template<typename T>
+    Component SaveAttachedJob(const char *name, const std::string &basename, const T &component) {
+        typename IOTraits<T>::Type io;
+        return { name, { io.FileName(basename) },
+                 [this, basename, &component] { SaveAttached(basename, component); } };
+    }
+
+    template<typename T>
+    Component LoadAttachedJob(const char *name, const std::string &basename, T &component) {
+        return { name, {}, [this, basename, &component] { LoadAttached(basename, component); } };
+    }
+
+    void WriteManifest(const std::string &basename, const std::vector<Component> &components) {
+        std::ofstream os(ManifestName(basename));
+        VERIFY_MSG(os, "Failed to write " << ManifestName(basename));
+        for (const auto &component : components) {
+            for (const auto &file : component.files) {
+                if (!fs::check_existence(file))
+                    continue;
+                os << component.name << '\t' << fs::filename(file) << '\t' << fs::filesize(file) << '\n';
+            }
+        }
+    }
+
     BasicGraphIO<Graph> graph_io_;
 
     template<typename T>
@@ -128,6 +223,7 @@ protected:
     template<typename T>
     void SaveAttached(const std::string &basename, const T &component) {
         typename IOTraits<T>::Type io;
+        io.SetCompression(this->compression());
         if (component.IsAttached()) {
             io.Save(basename, component);
         } else {
@@ -169,51 +265,10 @@ class FullPackIO : public BasePackIO<Graph> {
 public:
     typedef BasePackIO<Graph> base;
     typedef typename debruijn_graph::graph_pack<Graph> Type;
-    void Save(const std::string &basename, const Type &gp) override {
-        //1. Save basic graph
-        base::Save(basename, gp);
-
-        //2. Save unclustered paired indices
-        using namespace omnigraph::de;
-        io::binary::Save(basename, gp.paired_indices);
-
-        //3. Save clustered & scaffolding indices
-        io::binary::Save(basename + "_cl", gp.clustered_indices);
-        io::binary::Save(basename + "_scf", gp.scaffolding_indices);
-
-        //4. Save long reads
-        io::binary::Save(basename, gp.single_long_reads);
-
-        //5. Save genome info
-        gp.ginfo.Save(basename + ".ginfo");
+    typedef typename base::Component Component;
 
-        //6. Save SS coverage
-        io::binary::Save(basename, gp.ss_coverage);
-    }
-
-    bool Load(const std::string &basename, Type &gp) override {
-        //1. Load basic graph
-        bool loaded = base::Load(basename, gp);
-        VERIFY(loaded);
-
-        //2. Load paired indices
-        using namespace omnigraph::de;
-        io::binary::Load(basename, gp.paired_indices);
-
-        //3. Load clustered & scaffolding indices
-        io::binary::Load(basename + "_cl", gp.clustered_indices);
-        io::binary::Load(basename + "_scf", gp.scaffolding_indices);
-
-        //4. Load long reads
-        io::binary::Load(basename, gp.single_long_reads);
-
-        //5. Load genome info
-        gp.ginfo.Load(basename + ".ginfo");
-
-        //6. Save SS coverage
-        io::binary::Load(basename, gp.ss_coverage);
-
-        return true;
+    FullPackIO(bool compress = true)
+            : base(compress) {
     }
 
     void BinWrite(std::ostream &os, const Type &gp) override {
@@ -256,6 +311,49 @@ public:
 
         return true;
     }
+
+protected:
+    std::vector<Component> SaveJobs(const std::string &basename, const Type &gp) override {
+        auto res = base::SaveJobs(basename, gp);
+        res.push_back(SaveCollectionJob("paired indices", basename, gp.paired_indices));
+        res.push_back(SaveCollectionJob("clustered indices", basename + "_cl", gp.clustered_indices));
+        res.push_back(SaveCollectionJob("scaffolding indices", basename + "_scf", gp.scaffolding_indices));
+        res.push_back(SaveCollectionJob("long reads", basename, gp.single_long_reads));
+        res.push_back({ "genome info", { basename + ".ginfo" },
+                        [basename, &gp] { gp.ginfo.Save(basename + ".ginfo"); } });
+        res.push_back(SaveCollectionJob("ss coverage", basename, gp.ss_coverage));
+        return res;
+    }
+
+    std::vector<Component> LoadJobs(const std::string &basename, Type &gp) override {
+        auto res = base::LoadJobs(basename, gp);
+        res.push_back(LoadCollectionJob("paired indices", basename, gp.paired_indices));
+        res.push_back(LoadCollectionJob("clustered indices", basename + "_cl", gp.clustered_indices));
+        res.push_back(LoadCollectionJob("scaffolding indices", basename + "_scf", gp.scaffolding_indices));
+        res.push_back(LoadCollectionJob("long reads", basename, gp.single_long_reads));
+        res.push_back({ "genome info", {},
+                        [basename, &gp] { gp.ginfo.Load(basename + ".ginfo"); } });
+        res.push_back(LoadCollectionJob("ss coverage", basename, gp.ss_coverage));
+        return res;
+    }
+
+private:
+    template<typename T>
+    Component SaveCollectionJob(const char *name, const std::string &basename, const T &value) {
+        typename IOTraits<T>::Type io;
+        bool compress = this->compression();
+        return { name, io.FileNames(basename, value),
+                 [compress, basename, &value] {
+                     typename IOTraits<T>::Type io;
+                     io.SetCompression(compress);
+                     io.Save(basename, value);
+                 } };
+    }
+
+    template<typename T>
+    Component LoadCollectionJob(const char *name, const std::string &basename, T &value) {
+        return { name, {}, [basename, &value] { io::binary::Load(basename, value); } };
+    }
 };
 
 } // namespace binary
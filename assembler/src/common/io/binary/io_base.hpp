@@ -7,6 +7,7 @@
 #pragma once
 
 #include "binary.hpp"
+#include "block_stream.hpp"
 #include "utils/logger/logger.hpp"
 #include "utils/filesystem/path_helper.hpp"
 
@@ -27,6 +28,16 @@ struct IOBase {
     virtual void Save(const std::string &basename, const T &value) = 0;
     virtual bool Load(const std::string &basename, T &value) = 0;
     virtual ~IOBase() {}
+
+    /**
+     * @brief  Enables block-compressed framing for subsequent saves. Loading
+     *         detects the framing automatically.
+     */
+    void SetCompression(bool compress) { compress_ = compress; }
+    bool compression() const { return compress_; }
+
+private:
+    bool compress_ = false;
 };
 
 /**
@@ -97,12 +108,21 @@ public:
     }
 
     void Save(const std::string &basename, const T &value) override {
-        std::string filename = basename + this->ext_;
-        std::ofstream file(filename, std::ios::binary);
+        std::string filename = FileName(basename);
         DEBUG("Saving " << this->name_ << " into " << filename);
-        VERIFY(file);
-        BinOStream writer(file);
-        this->SaveImpl(writer, value);
+        if (this->compression()) {
+            BlockCompressedOFStream file(filename);
+            VERIFY(file);
+            BinOStream writer(file);
+            this->SaveImpl(writer, value);
+            file.close();
+            VERIFY_MSG(file, "Failed to write " << filename);
+        } else {
+            std::ofstream file(filename, std::ios::binary);
+            VERIFY(file);
+            BinOStream writer(file);
+            this->SaveImpl(writer, value);
+        }
     }
 
     void SaveEmpty(const std::string &basename) {
@@ -117,13 +137,13 @@ public:
      *         Fails if the file is present but cannot be read.
      */
     bool Load(const std::string &basename, T &value) override {
-        std::string filename = basename + this->ext_;
+        std::string filename = FileName(basename);
         VERIFY_MSG(fs::check_existence(filename), "File not found: " + filename);
-        std::ifstream file(filename, std::ios::binary);
-        //check file is empty
-        if (file.peek() == std::ifstream::traits_type::eof()) {
+        //empty file is written by SaveEmpty
+        if (fs::filesize(filename) == 0) {
             return false;
         }
+        BlockCompressedIFStream file(filename);
         VERIFY_MSG(file, "Failed to read " << filename);
         DEBUG("Loading " << this->name_ << " from " << filename);
         BinIStream reader(file);
@@ -131,6 +151,10 @@ public:
         return true;
     }
 
+    std::string FileName(const std::string &basename) const {
+        return basename + this->ext_;
+    }
+
     virtual bool BinRead(std::istream &is, T &value) {
         BinIStream str(is);
         bool file_is_present;
@@ -211,11 +235,19 @@ public:
     }
 
     void Save(const std::string &basename, const T &value) override {
+        io_->SetCompression(this->compression());
         for (size_t i = 0; i < value.size(); ++i) {
             io_->Save(basename + "_" + std::to_string(i), value[i]);
         }
     }
 
+    std::vector<std::string> FileNames(const std::string &basename, const T &value) const {
+        std::vector<std::string> res;
+        for (size_t i = 0; i < value.size(); ++i)
+            res.push_back(io_->FileName(basename + "_" + std::to_string(i)));
+        return res;
+    }
+
     bool Load(const std::string &basename, T &value) override {
         bool res = true;
         for (size_t i = 0; i < value.size(); ++i) {
@@ -144,30 +144,36 @@ void ConvertIfNeeded(DataSet<LibraryData> &data, unsigned nthreads) {
     }
 }
 
-BinaryPairedStreams paired_binary_readers(SequencingLibraryT &lib,
-                                          bool followed_by_rc,
-                                          size_t insert_size,
-                                          bool include_merged) {
+BinaryPairedStream paired_binary_reader(SequencingLibraryT &lib,
+                                        size_t insert_size,
+                                        bool include_merged,
+                                        size_t portion_count, size_t portion_num) {
     const auto& data = lib.data();
     CHECK_FATAL_ERROR(data.binary_reads_info.binary_converted,
             "Lib was not converted to binary, cannot produce binary stream");
 
+    BinaryPairedStream stream{BinaryFilePairedStream(data.binary_reads_info.paired_read_prefix,
+                                                     insert_size, portion_count, portion_num)};
+    if (include_merged) {
+        VERIFY(lib.data().unmerged_read_length != 0);
+        stream = MultifileWrap<PairedReadSeq>(std::move(stream),
+                                              BinaryUnmergingPairedStream(data.binary_reads_info.merged_read_prefix,
+                                                                          insert_size, lib.data().unmerged_read_length,
+                                                                          portion_count, portion_num));
+    }
+
+    return stream;
+}
+
+BinaryPairedStreams paired_binary_readers(SequencingLibraryT &lib,
+                                          bool followed_by_rc,
+                                          size_t insert_size,
+                                          bool include_merged) {
     ReadStreamList<PairedReadSeq> paired_streams;
-    const size_t n = data.binary_reads_info.chunk_num;
+    const size_t n = lib.data().binary_reads_info.chunk_num;
 
-    for (size_t i = 0; i < n; ++i) {
-        ReadStream<PairedReadSeq> stream{BinaryFilePairedStream(data.binary_reads_info.paired_read_prefix,
-                                                                   insert_size, n, i)};
-        if (include_merged) {
-            VERIFY(lib.data().unmerged_read_length != 0);
-            stream = MultifileWrap<PairedReadSeq>(std::move(stream),
-                                                  BinaryUnmergingPairedStream(data.binary_reads_info.merged_read_prefix,
-                                                                              insert_size, lib.data().unmerged_read_length,
-                                                                              n, i));
-        }
-
-        paired_streams.push_back(std::move(stream));
-    }
+    for (size_t i = 0; i < n; ++i)
+        paired_streams.push_back(paired_binary_reader(lib, insert_size, include_merged, n, i));
 
     if (followed_by_rc)
         paired_streams = RCWrap<PairedReadSeq>(std::move(paired_streams));
@@ -38,6 +38,13 @@ public:
 
 void ConvertIfNeeded(DataSet<LibraryData> &data, unsigned nthreads);
 
+/**
+ * @brief Reader of the portion_num-th of portion_count (roughly equal) portions of paired reads.
+ */
+BinaryPairedStream paired_binary_reader(SequencingLibraryT &lib,
+                                        size_t insert_size,
+                                        bool include_merged,
+                                        size_t portion_count, size_t portion_num);
 BinaryPairedStreams paired_binary_readers(SequencingLibraryT &lib,
                                           bool followed_by_rc,
                                           size_t insert_size,
@@ -15,12 +15,14 @@ raw_kmer_iterator<Seq> make_kmer_iterator(const std::string &FileName,
     return raw_kmer_iterator<Seq>(FileName, Seq::GetDataSize(K));
 }
 
+// Splits the file into at most amount chunks of whole k-mers with page aligned offsets.
+// Returns (offset, size) pairs in bytes, zero size stands for the whole file.
 template<class Seq>
-std::vector<raw_kmer_iterator<Seq>> make_kmer_iterator(const std::string &FileName,
-                                                       size_t K, size_t amount) {
-    std::vector<raw_kmer_iterator<Seq>> res;
+std::vector<std::pair<size_t, size_t>> kmer_file_chunks(const std::string &FileName,
+                                                        size_t K, size_t amount) {
+    std::vector<std::pair<size_t, size_t>> res;
     if (amount == 1) {
-        res.emplace_back(FileName, Seq::GetDataSize(K));
+        res.emplace_back(0, 0);
         return res;
     }
 
@@ -30,7 +32,7 @@ std::vector<raw_kmer_iterator<Seq>> make_kmer_iterator(const std::string &FileNa
                "stat(2) failed. Reason: " << strerror(errno) << ". Error code: " << errno);
     size_t file_size = buf.st_size;
 
-    // Now start creating the iterators keeping in mind, that offset should be
+    // Now start creating the chunks keeping in mind, that offset should be
     // multiple of page size.
     size_t chunk = round_up(file_size / amount,
                             getpagesize() * Seq::GetDataSize(K) * sizeof(typename Seq::DataType));
@@ -39,15 +41,28 @@ std::vector<raw_kmer_iterator<Seq>> make_kmer_iterator(const std::string &FileNa
         chunk = file_size;
 
     while (offset < file_size) {
-        res.emplace_back(FileName, Seq::GetDataSize(K),
-                         offset,
-                         offset + chunk > file_size ? file_size - offset : chunk);
+        res.emplace_back(offset, offset + chunk > file_size ? file_size - offset : chunk);
         offset += chunk;
     }
 
     return res;
 }
 
+template<class Seq>
+raw_kmer_iterator<Seq> make_kmer_iterator(const std::string &FileName,
+                                          size_t K, const std::pair<size_t, size_t> &chunk) {
+    return raw_kmer_iterator<Seq>(FileName, Seq::GetDataSize(K), chunk.first, chunk.second);
+}
+
+template<class Seq>
+std::vector<raw_kmer_iterator<Seq>> make_kmer_iterator(const std::string &FileName,
+                                                       size_t K, size_t amount) {
+    std::vector<raw_kmer_iterator<Seq>> res;
+    for (const auto &chunk : kmer_file_chunks<Seq>(FileName, K, amount))
+        res.push_back(make_kmer_iterator<Seq>(FileName, K, chunk));
+
+    return res;
+}
 
 };
 
@@ -13,6 +13,7 @@
 
 #include "pipeline/library.hpp"
 #include "utils/logger/logger.hpp"
+#include "utils/memory_limit.hpp"
 #include "utils/verify.hpp"
 
 #include "threadpool/threadpool.hpp"
@@ -50,9 +51,12 @@ public:
 template<class Writer, class Read>
 ReadStreamStat BinaryWriter::ToBinary(const Writer &writer, io::ReadStream<Read> &stream,
                                       ThreadPool::ThreadPool *pool) {
+    // Two buffers are alive at once: one is being filled while another one is flushed
+    size_t buf_size = utils::MemoryGovernor::instance().ItemCount(sizeof(Read) + READ_FOOTPRINT,
+                                                                  BUF_SIZE, CHUNK, 2);
     std::vector<Read> buf, flush_buf;
-    DEBUG("Reserving a buffer for " << BUF_SIZE << " reads");
-    buf.reserve(BUF_SIZE); flush_buf.reserve(BUF_SIZE);
+    DEBUG("Reserving a buffer for " << buf_size << " reads");
+    buf.reserve(buf_size); flush_buf.reserve(buf_size);
 
     // Reserve space for stats
     ReadStreamStat read_stats;
@@ -95,7 +99,8 @@ ReadStreamStat BinaryWriter::ToBinary(const Writer &writer, io::ReadStream<Read>
 
         VERBOSE_POWER(++read_count, " reads processed");
 
-        if (buf.size() == buf.capacity())
+        if (buf.size() == buf.capacity() ||
+            (buf.size() % CHUNK == 0 && utils::MemoryGovernor::instance().under_pressure()))
             flush_buffer();
     }
     flush_buffer(); //Write leftovers
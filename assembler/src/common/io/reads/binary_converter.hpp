@@ -33,7 +33,10 @@ class BinaryWriter {
 public:
     typedef size_t CountType;
     static constexpr size_t CHUNK = 100;
+    // Maximum number of buffered reads, the actual buffer is sized from the memory budget
     static constexpr size_t BUF_SIZE = 50000;
+    // Rough estimate of read sequence / name payload
+    static constexpr size_t READ_FOOTPRINT = 512;
 
     BinaryWriter(const std::string &file_name_prefix);
 
@@ -161,12 +161,7 @@ public:
     }
 
     static bool IsValid(const std::string &seq) {
-        for (size_t i = 0; i < seq.size(); ++i) {
-            if (!is_nucl(seq[i])) {
-                return false;
-            }
-        }
-        return true;
+        return nucl_kernels::AllNucls(seq.data(), seq.size());
     }
 
     SequenceOffsetT GetLeftOffset() const {
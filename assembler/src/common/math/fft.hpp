@@ -0,0 +1,168 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "utils/verify.hpp"
+
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace math {
+
+/**
+ * @brief Radix-2 FFT of real sequences of a fixed power of two length n.
+ *        A real sequence is packed into a complex one of length n / 2, transformed and split
+ *        into the non-negative half of its (Hermitian) spectrum. Bit reversal permutation and
+ *        twiddle factors of every stage are computed once per plan and stored contiguously,
+ *        complex values are kept as separate arrays of real and imaginary parts, so all the
+ *        butterflies are plain stride-one loops.
+ *        Forward transform uses exp(+2 pi i k t / n), backward one uses exp(-2 pi i k t / n)
+ *        and divides by n, so Backward(Forward(x)) == x.
+ */
+class RealFFTPlan {
+public:
+    explicit RealFFTPlan(size_t n)
+            : n_(n), m_(n / 2) {
+        VERIFY(n >= 2 && (n & (n - 1)) == 0);
+
+        size_t lg_m = 0;
+        while ((size_t(1) << lg_m) < m_)
+            ++lg_m;
+        rev_.resize(m_);
+        for (size_t i = 0; i < m_; ++i) {
+            size_t r = 0;
+            for (size_t b = 0; b < lg_m; ++b)
+                r |= ((i >> b) & 1) << (lg_m - 1 - b);
+            rev_[i] = r;
+        }
+
+        // Twiddles of the stage with butterflies of length len start at len / 2 - 1
+        for (size_t len = 2; len <= m_; len <<= 1) {
+            for (size_t j = 0; j < len / 2; ++j) {
+                double ang = 2 * M_PI * (double) j / (double) len;
+                stage_re_.push_back(cos(ang));
+                stage_im_.push_back(sin(ang));
+            }
+        }
+
+        for (size_t k = 0; k <= m_; ++k) {
+            double ang = 2 * M_PI * (double) k / (double) n_;
+            split_re_.push_back(cos(ang));
+            split_im_.push_back(sin(ang));
+        }
+    }
+
+    size_t size() const { return n_; }
+
+    /**
+     * @brief Transforms x[0, n) into bins [0, n / 2] stored in re and im, the rest of
+     *        the spectrum is the complex conjugate of them.
+     */
+    void Forward(const double *x, double *re, double *im) const {
+        for (size_t j = 0; j < m_; ++j) {
+            re[rev_[j]] = x[2 * j];
+            im[rev_[j]] = x[2 * j + 1];
+        }
+        Transform(re, im, 1.);
+
+        // Split the spectrum of the packed sequence into spectra of even and odd samples
+        re[m_] = re[0];
+        im[m_] = im[0];
+        for (size_t k = 0, l = m_; k <= l; ++k, --l) {
+            double er = .5 * (re[k] + re[l]), ei = .5 * (im[k] - im[l]);
+            double or_ = .5 * (im[k] + im[l]), oi = .5 * (re[l] - re[k]);
+            double wr = split_re_[k], wi = split_im_[k];
+            double tr = or_ * wr - oi * wi, ti = or_ * wi + oi * wr;
+            // The mirrored bin uses the conjugate even and odd parts and the mirrored twiddle
+            double lr = split_re_[l], li = split_im_[l];
+            double ur = or_ * lr + oi * li, ui = or_ * li - oi * lr;
+            re[k] = er + tr;
+            im[k] = ei + ti;
+            re[l] = er + ur;
+            im[l] = -ei + ui;
+        }
+    }
+
+    /**
+     * @brief Restores x[0, n) from bins [0, n / 2] of its spectrum. Imaginary parts of
+     *        the bins 0 and n / 2 are supposed to be zero. re and im are used as scratch space.
+     */
+    void Backward(double *re, double *im, double *x) const {
+        // Merge the spectra of even and odd samples into the spectrum of the packed sequence
+        for (size_t k = 0, l = m_; k <= l; ++k, --l) {
+            double ar = re[k] + re[l], ai = im[k] - im[l];
+            double dr = re[k] - re[l], di = im[k] + im[l];
+            double wr = split_re_[k], wi = -split_im_[k];
+            double br = dr * wr - di * wi, bi = dr * wi + di * wr;
+            double lr = split_re_[l], li = -split_im_[l];
+            double cr = dr * lr + di * li, ci = -dr * li + di * lr;
+            re[k] = ar - bi;
+            im[k] = ai + br;
+            re[l] = ar - ci;
+            im[l] = -ai - cr;
+        }
+
+        for (size_t j = 0; j < m_; ++j) {
+            if (j < rev_[j]) {
+                std::swap(re[j], re[rev_[j]]);
+                std::swap(im[j], im[rev_[j]]);
+            }
+        }
+        Transform(re, im, -1.);
+
+        double norm = 1. / (double) n_;
+        for (size_t j = 0; j < m_; ++j) {
+            x[2 * j] = re[j] * norm;
+            x[2 * j + 1] = im[j] * norm;
+        }
+    }
+
+    /**
+     * @brief Plan of size n shared by all the transforms of the calling thread
+     */
+    static const RealFFTPlan &Get(size_t n) {
+        thread_local std::vector<std::unique_ptr<RealFFTPlan>> plans;
+        size_t lg = 0;
+        while ((size_t(1) << lg) < n)
+            ++lg;
+        if (plans.size() <= lg)
+            plans.resize(lg + 1);
+        if (!plans[lg])
+            plans[lg].reset(new RealFFTPlan(n));
+        return *plans[lg];
+    }
+
+private:
+    // In-place complex transform of bit reversed re and im of length n / 2
+    void Transform(double *re, double *im, double sign) const {
+        for (size_t len = 2; len <= m_; len <<= 1) {
+            size_t half = len / 2;
+            const double *wre = stage_re_.data() + half - 1, *wim = stage_im_.data() + half - 1;
+            for (size_t i = 0; i < m_; i += len) {
+                double *ar = re + i, *ai = im + i, *br = re + i + half, *bi = im + i + half;
+                for (size_t j = 0; j < half; ++j) {
+                    double wr = wre[j], wi = sign * wim[j];
+                    double vr = br[j] * wr - bi[j] * wi, vi = br[j] * wi + bi[j] * wr;
+                    double ur = ar[j], ui = ai[j];
+                    ar[j] = ur + vr;
+                    ai[j] = ui + vi;
+                    br[j] = ur - vr;
+                    bi[j] = ui - vi;
+                }
+            }
+        }
+    }
+
+    size_t n_, m_;
+    std::vector<size_t> rev_;
+    std::vector<double> stage_re_, stage_im_;
+    std::vector<double> split_re_, split_im_;
+};
+
+}
@@ -8,133 +8,385 @@
 #define __KMER_MAP_HPP__
 
 #include "sequence/rtseq.hpp"
+#include "utils/verify.hpp"
 
-#include <tsl/htrie_map.h>
 #include <boost/iterator/iterator_facade.hpp>
 
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
 namespace debruijn_graph {
-class KMerMap {
-    struct str_hash {
-        std::size_t operator()(const char* key, std::size_t key_size) const {
-            return CityHash64(key, key_size);
-        }
-    };
 
+/**
+ * @brief Open addressing (linear probing) map from k-mers to k-mers.
+ *        Every slot keeps the key and the value packed one after another as raw k-mer words,
+ *        so the memory consumption is fixed 2 * GetDataSize(k) words per slot plus one byte of
+ *        occupancy. Erase uses backward shift deletion, so there are no tombstones.
+ *        Keys are distributed between independent tables (shards) by the high bits of the hash,
+ *        modifications of different shards could run concurrently (see shard()).
+ *        Iteration goes over the shards in order, every shard is traversed starting right after
+ *        an empty slot: inserting the elements in iteration order into shards of the same capacity
+ *        reproduces exactly the same layout.
+ */
+class KMerMap {
     typedef RtSeq Kmer;
     typedef RtSeq Seq;
     typedef typename Seq::DataType RawSeqData;
-    typedef typename tsl::htrie_map<char, RawSeqData*, str_hash> HTMap;
+
+    static constexpr size_t MIN_CAPACITY = 16;
+    static constexpr size_t NO_SLOT = -1ull;
+
+    // "#KMM" in the little-endian byte order, files without it start with 32-bit number of entries
+    static const uint32_t FORMAT_MARKER = 0x4D4D4B23;
+    static const uint32_t FORMAT_VERSION = 1;
+
+    struct Shard {
+        std::vector<RawSeqData> data;
+        std::vector<uint8_t> used;
+        size_t size = 0;
+        size_t mask = 0;
+
+        size_t capacity() const {
+            return used.size();
+        }
+    };
 
     class iterator : public boost::iterator_facade<iterator,
                                                    const std::pair<Kmer, Seq>,
                                                    std::forward_iterator_tag,
                                                    const std::pair<Kmer, Seq>> {
       public:
-        iterator(unsigned k, HTMap::const_iterator iter)
-                : k_(k), iter_(iter) {}
+        iterator(const KMerMap &map, size_t shard, size_t pos)
+                : map_(&map), shard_(shard), start_(0), pos_(pos) {
+            if (shard_ < map_->shards_.size())
+                start_ = first_empty(map_->shards_[shard_]);
+            skip();
+        }
 
       private:
         friend class boost::iterator_core_access;
 
+        size_t slot() const {
+            return (start_ + pos_) & map_->shards_[shard_].mask;
+        }
+
+        void skip() {
+            while (shard_ < map_->shards_.size()) {
+                const Shard &shard = map_->shards_[shard_];
+                while (pos_ < shard.capacity() && !shard.used[slot()])
+                    ++pos_;
+                if (pos_ < shard.capacity())
+                    return;
+
+                shard_ += 1;
+                pos_ = 0;
+                if (shard_ < map_->shards_.size())
+                    start_ = first_empty(map_->shards_[shard_]);
+            }
+        }
+
         void increment() {
-            ++iter_;
+            ++pos_;
+            skip();
         }
 
         bool equal(const iterator &other) const {
-            return iter_ == other.iter_;
+            return shard_ == other.shard_ && pos_ == other.pos_;
         }
 
         const std::pair<Kmer, Seq> dereference() const {
-            iter_.key(key_out_);
-            Kmer k(k_, (const RawSeqData*)key_out_.data());
-            Seq s(k_, (const RawSeqData*)iter_.value());
-            return std::make_pair(k, s);
+            const Shard &shard = map_->shards_[shard_];
+            size_t s = slot();
+            return std::make_pair(Kmer(map_->k_, map_->key(shard, s)), Seq(map_->k_, map_->value(shard, s)));
         }
 
-        unsigned k_;
-        HTMap::const_iterator iter_;
-        mutable std::string key_out_;
+        const KMerMap *map_;
+        size_t shard_;
+        size_t start_;
+        size_t pos_;
     };
 
   public:
-    KMerMap(unsigned k)
-            : k_(k) {
-        rawcnt_ = (unsigned)Seq::GetDataSize(k_);
+    KMerMap(unsigned k, unsigned shard_bits = 6)
+            : k_(k), rawcnt_(Seq::GetDataSize(k)), shard_bits_(shard_bits),
+              shards_(size_t(1) << shard_bits) {
+        VERIFY(shard_bits < 16);
     }
 
-    ~KMerMap() {
-        clear();
+    /**
+     * Index of the shard keeping the k-mer. Operations on k-mers of different shards could
+     * be performed concurrently, Normalize, BinRead and clear require exclusive access.
+     */
+    size_t shard(const Kmer &kmer) const {
+        return shard(hash(kmer.data()));
     }
 
-    void erase(const Kmer &key) {
-        auto res = mapping_.find_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData));
-        if (res == mapping_.end())
+    size_t shard_count() const {
+        return shards_.size();
+    }
+
+    void erase(const Kmer &kmer) {
+        size_t h = hash(kmer.data());
+        Shard &shard = shards_[this->shard(h)];
+        size_t i = FindSlot(shard, kmer.data(), h);
+        if (i == NO_SLOT)
             return;
 
-        delete[] res.value();
-        mapping_.erase(res);
+        // Backward shift: move the following elements of the cluster closer to their home slots
+        for (size_t j = (i + 1) & shard.mask; shard.used[j]; j = (j + 1) & shard.mask) {
+            size_t home = hash(key(shard, j)) & shard.mask;
+            // Element at j may be moved into the hole at i iff its home is not in (i, j]
+            if (((j - home) & shard.mask) >= ((j - i) & shard.mask)) {
+                memcpy(slot_data(shard, i), slot_data(shard, j), 2 * rawcnt_ * sizeof(RawSeqData));
+                i = j;
+            }
+        }
+        shard.used[i] = 0;
+        shard.size -= 1;
     }
 
     void set(const Kmer &key, const Seq &value) {
-        RawSeqData *rawvalue = nullptr;
-        auto res = mapping_.find_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData));
-        if (res == mapping_.end()) {
-            rawvalue = new RawSeqData[rawcnt_];
-            mapping_.insert_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData), rawvalue);
-        } else {
-            rawvalue = res.value();
+        set(key.data(), value.data());
+    }
+
+    void set(const RawSeqData *key, const RawSeqData *value) {
+        size_t h = hash(key);
+        Shard &shard = shards_[this->shard(h)];
+        if ((shard.size + 1) * 4 > shard.capacity() * 3)
+            Rehash(shard, std::max(MIN_CAPACITY, shard.capacity() * 2));
+
+        size_t i = h & shard.mask;
+        for (; shard.used[i]; i = (i + 1) & shard.mask) {
+            if (equal(this->key(shard, i), key))
+                break;
+        }
+        if (!shard.used[i]) {
+            shard.used[i] = 1;
+            memcpy(slot_data(shard, i), key, rawcnt_ * sizeof(RawSeqData));
+            shard.size += 1;
         }
-        memcpy(rawvalue, value.data(), rawcnt_ * sizeof(RawSeqData));
+        memcpy(slot_data(shard, i) + rawcnt_, value, rawcnt_ * sizeof(RawSeqData));
     }
 
     bool count(const Kmer &key) const {
-        return mapping_.count_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData));
+        return find(key.data()) != nullptr;
     }
 
     const RawSeqData *find(const Kmer &key) const {
-        auto res = mapping_.find_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData));
-        if (res == mapping_.end())
-            return nullptr;
-
-        return res.value();
+        return find(key.data());
     }
 
     const RawSeqData *find(const RawSeqData *key) const {
-        auto res = mapping_.find_ks((const char*)key, rawcnt_ * sizeof(RawSeqData));
-        if (res == mapping_.end())
-            return nullptr;
-
-        return res.value();
+        size_t h = hash(key);
+        const Shard &shard = shards_[this->shard(h)];
+        size_t i = FindSlot(shard, key, h);
+        return i == NO_SLOT ? nullptr : value(shard, i);
     }
 
-    void clear() {
-        // Delete all the values
-        for (auto it = mapping_.begin(); it != mapping_.end(); ++it) {
-            VERIFY(it.value() != nullptr);
-            delete[] it.value();
-            it.value() = nullptr;
+    /**
+     * Replaces every value with the end of its chain of substitutions, so every lookup
+     * afterwards needs a single probe. Links between the slots of all shards are resolved
+     * in parallel first, then the chains are followed over the links without hashing.
+     * The chains are compressed on the way, so every link is followed a constant number of times.
+     */
+    void Normalize() {
+        // Slots of all shards are numbered one after another
+        std::vector<size_t> offsets(shards_.size() + 1, 0);
+        for (size_t s = 0; s < shards_.size(); ++s)
+            offsets[s + 1] = offsets[s] + shards_[s].capacity();
+        std::vector<size_t> next(offsets.back(), NO_SLOT);
+
+#       pragma omp parallel for schedule(dynamic)
+        for (size_t s = 0; s < shards_.size(); ++s) {
+            const Shard &shard = shards_[s];
+            for (size_t i = 0; i < shard.capacity(); ++i) {
+                if (!shard.used[i])
+                    continue;
+                size_t h = hash(value(shard, i));
+                size_t target = this->shard(h);
+                size_t j = FindSlot(shards_[target], value(shard, i), h);
+                if (j != NO_SLOT)
+                    next[offsets[s] + i] = offsets[target] + j;
+            }
         }
 
-        // Delete the mapping and all the keys
-        mapping_.clear();
+        // Every link is redirected to the last slot of its chain (the one with unresolved value)
+        size_t total = size();
+        std::vector<size_t> chain;
+        for (size_t i = 0; i < next.size(); ++i) {
+            size_t last = i;
+            while (next[last] != NO_SLOT && next[next[last]] != NO_SLOT) {
+                chain.push_back(last);
+                last = next[last];
+                VERIFY_MSG(chain.size() <= total, "Cyclic k-mer substitution");
+            }
+            for (size_t j : chain)
+                next[j] = next[last];
+            chain.clear();
+        }
+
+        // Values of the chain ends are never modified, so they could be read concurrently
+#       pragma omp parallel for schedule(dynamic)
+        for (size_t s = 0; s < shards_.size(); ++s) {
+            Shard &shard = shards_[s];
+            for (size_t i = 0; i < shard.capacity(); ++i) {
+                size_t root = next[offsets[s] + i];
+                if (root == NO_SLOT)
+                    continue;
+
+                size_t root_shard = std::upper_bound(offsets.begin(), offsets.end(), root) - offsets.begin() - 1;
+                memcpy(slot_data(shard, i) + rawcnt_,
+                       value(shards_[root_shard], root - offsets[root_shard]), rawcnt_ * sizeof(RawSeqData));
+            }
+        }
+    }
+
+    void clear() {
+        for (Shard &shard : shards_)
+            shard = Shard();
     }
 
     size_t size() const {
-        return mapping_.size();
+        size_t res = 0;
+        for (const Shard &shard : shards_)
+            res += shard.size;
+        return res;
+    }
+
+    /**
+     * Writes the format marker and version, 64-bit number of entries followed by raw key and
+     * value words of every entry in the iteration order
+     */
+    void BinWrite(std::ostream &file) const {
+        uint32_t marker = FORMAT_MARKER, version = FORMAT_VERSION;
+        file.write((const char *) &marker, sizeof(marker));
+        file.write((const char *) &version, sizeof(version));
+        uint64_t sz = size();
+        file.write((const char *) &sz, sizeof(sz));
+
+        for (const Shard &shard : shards_) {
+            size_t start = first_empty(shard);
+            for (size_t pos = 0; pos < shard.capacity(); ++pos) {
+                size_t s = (start + pos) & shard.mask;
+                if (shard.used[s])
+                    file.write((const char *) slot_data(shard, s), 2 * rawcnt_ * sizeof(RawSeqData));
+            }
+        }
+    }
+
+    /**
+     * Reads the entries written by BinWrite. Files without the format marker are read as
+     * the legacy format with 32-bit number of entries.
+     */
+    void BinRead(std::istream &file) {
+        clear();
+
+        uint32_t marker;
+        file.read((char *) &marker, sizeof(marker));
+        VERIFY_MSG(file, "Failed to read k-mer map header");
+        uint64_t sz = marker;
+        if (marker == FORMAT_MARKER) {
+            uint32_t version;
+            file.read((char *) &version, sizeof(version));
+            file.read((char *) &sz, sizeof(sz));
+            VERIFY_MSG(file, "Failed to read k-mer map header");
+            VERIFY_MSG(version == FORMAT_VERSION, "Unsupported k-mer map format version " << version);
+        }
+
+        std::vector<RawSeqData> entry(2 * rawcnt_);
+        for (uint64_t i = 0; i < sz; ++i) {
+            file.read((char *) entry.data(), 2 * rawcnt_ * sizeof(RawSeqData));
+            VERIFY_MSG(file, "Failed to read k-mer map entry " << i << " of " << sz);
+            set(entry.data(), entry.data() + rawcnt_);
+        }
     }
 
     iterator begin() const {
-        return iterator(k_, mapping_.begin());
+        return iterator(*this, 0, 0);
     }
 
     iterator end() const {
-        return iterator(k_, mapping_.end());
+        return iterator(*this, shards_.size(), 0);
     }
 
   private:
+    RawSeqData *slot_data(Shard &shard, size_t i) {
+        return shard.data.data() + 2 * rawcnt_ * i;
+    }
+
+    const RawSeqData *slot_data(const Shard &shard, size_t i) const {
+        return shard.data.data() + 2 * rawcnt_ * i;
+    }
+
+    const RawSeqData *key(const Shard &shard, size_t i) const {
+        return slot_data(shard, i);
+    }
+
+    const RawSeqData *value(const Shard &shard, size_t i) const {
+        return slot_data(shard, i) + rawcnt_;
+    }
+
+    size_t hash(const RawSeqData *key) const {
+        return Seq::GetHash(key, rawcnt_);
+    }
+
+    // Shards are chosen by the high bits of the hash, the low ones give the home slot
+    size_t shard(size_t hash) const {
+        return shard_bits_ ? hash >> (sizeof(size_t) * 8 - shard_bits_) : 0;
+    }
+
+    bool equal(const RawSeqData *a, const RawSeqData *b) const {
+        return memcmp(a, b, rawcnt_ * sizeof(RawSeqData)) == 0;
+    }
+
+    static size_t first_empty(const Shard &shard) {
+        size_t i = 0;
+        while (i < shard.capacity() && shard.used[i])
+            ++i;
+        return i;
+    }
+
+    size_t FindSlot(const Shard &shard, const RawSeqData *key, size_t hash) const {
+        if (!shard.size)
+            return NO_SLOT;
+
+        for (size_t i = hash & shard.mask; shard.used[i]; i = (i + 1) & shard.mask) {
+            if (equal(this->key(shard, i), key))
+                return i;
+        }
+        return NO_SLOT;
+    }
+
+    void Rehash(Shard &shard, size_t capacity) {
+        std::vector<RawSeqData> data(2 * rawcnt_ * capacity);
+        std::vector<uint8_t> used(capacity, 0);
+        data.swap(shard.data);
+        used.swap(shard.used);
+        shard.mask = capacity - 1;
+
+        // Reinsert in the old iteration order to keep the layout canonical
+        size_t old_capacity = used.size(), start = 0;
+        while (start < old_capacity && used[start])
+            ++start;
+        for (size_t pos = 0; pos < old_capacity; ++pos) {
+            size_t s = (start + pos) % old_capacity;
+            if (!used[s])
+                continue;
+
+            const RawSeqData *entry = data.data() + 2 * rawcnt_ * s;
+            size_t i = hash(entry) & shard.mask;
+            while (shard.used[i])
+                i = (i + 1) & shard.mask;
+            shard.used[i] = 1;
+            memcpy(slot_data(shard, i), entry, 2 * rawcnt_ * sizeof(RawSeqData));
+        }
+    }
+
     unsigned k_;
-    unsigned rawcnt_;
-    HTMap mapping_;
+    size_t rawcnt_;
+    unsigned shard_bits_;
+    std::vector<Shard> shards_;
 };
 
 }
@@ -8,12 +8,14 @@
 #pragma once
 
 #include "sequence/sequence_tools.hpp"
-#include "adt/kmer_vector.hpp"
 #include "edge_index.hpp"
 
 #include "kmer_map.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
+#include <atomic>
 #include <set>
+#include <mutex>
 #include <cstdlib>
 
 namespace debruijn_graph {
@@ -27,7 +29,9 @@ class KmerMapper : public omnigraph::GraphActionHandler<Graph> {
 
     unsigned k_;
     KMerMap mapping_;
-    bool normalized_;
+    // One lock per shard of the mapping
+    mutable std::vector<std::mutex> locks_;
+    std::atomic<bool> normalized_;
 
     bool CheckAllDifferent(const Sequence &old_s, const Sequence &new_s) const {
         std::set<Kmer> kmers;
@@ -44,11 +48,99 @@ class KmerMapper : public omnigraph::GraphActionHandler<Graph> {
         return kmers.size() == old_s.size() - k_ + 1 + new_s.size() - k_ + 1;
     }
 
+    // Aligns k-mers of old_s to k-mers of new_s, does not touch the mapping
+    void CollectRemaps(const Sequence &old_s, const Sequence &new_s,
+                       std::vector<std::pair<Kmer, Kmer>> &remaps) const {
+        size_t old_length = old_s.size() - k_ + 1;
+        size_t new_length = new_s.size() - k_ + 1;
+        UniformPositionAligner aligner(old_s.size() - k_ + 1,
+                                       new_s.size() - k_ + 1);
+        Kmer old_kmer = old_s.start<Kmer>(k_) >> 'A';
+        typename Kmer::less2 kmer_less;
+        remaps.reserve(old_length);
+        for (size_t i = k_ - 1; i < old_s.size(); ++i) {
+            old_kmer <<= old_s[i];
+
+            size_t old_kmer_offset = i - k_ + 1;
+            size_t new_kmer_offest = aligner.GetPosition(old_kmer_offset);
+            if (old_kmer_offset * 2 + 1 == old_length && new_length % 2 == 0) {
+                Kmer middle(k_-1, new_s, new_length / 2);
+                if (kmer_less(middle, !middle)) {
+                    new_kmer_offest = new_length - 1 - new_kmer_offest;
+                }
+            }
+            Kmer new_kmer(k_, new_s, new_kmer_offest);
+            if (old_kmer == new_kmer)
+                continue;
+
+            remaps.emplace_back(old_kmer, new_kmer);
+        }
+    }
+
+    // Locks the shards of both k-mers, a shard is locked once if they coincide
+    std::pair<std::unique_lock<std::mutex>, std::unique_lock<std::mutex>>
+    LockShards(const Kmer &kmer1, const Kmer &kmer2) const {
+        size_t s1 = mapping_.shard(kmer1), s2 = mapping_.shard(kmer2);
+        std::unique_lock<std::mutex> lock1(locks_[s1], std::defer_lock), lock2;
+        if (s1 == s2) {
+            lock1.lock();
+        } else {
+            lock2 = std::unique_lock<std::mutex>(locks_[s2], std::defer_lock);
+            std::lock(lock1, lock2);
+        }
+        return std::make_pair(std::move(lock1), std::move(lock2));
+    }
+
+    // Same as Substitute, but every lookup is made under the lock of the corresponding shard
+    Kmer LockedSubstitute(const Kmer &kmer) const {
+        Kmer answer = kmer;
+        while (true) {
+            std::lock_guard<std::mutex> lock(locks_[mapping_.shard(answer)]);
+            const auto *rawval = mapping_.find(answer);
+            if (rawval == nullptr)
+                return answer;
+            answer = Kmer(k_, rawval);
+        }
+    }
+
+    /**
+     * old_kmer is only ever mapped to a k-mer which is not mapped itself (possibly after
+     * erasing its mapping), while the shards of both are locked. So no cycle of substitutions
+     * appears even if the chains are modified concurrently.
+     */
+    void ApplyRemap(const Kmer &old_kmer, const Kmer &new_kmer) {
+        {
+            auto locks = LockShards(old_kmer, new_kmer);
+            // Checking if already have info for this kmer
+            if (mapping_.count(old_kmer))
+                return;
+
+            if (!mapping_.count(new_kmer)) {
+                mapping_.set(old_kmer, new_kmer);
+                normalized_ = false;
+                return;
+            }
+        }
+
+        // Special case of remapping back.
+        // Not sure that we actually need it
+        if (LockedSubstitute(new_kmer) != old_kmer)
+            return;
+
+        auto locks = LockShards(old_kmer, new_kmer);
+        if (mapping_.count(old_kmer))
+            return;
+        mapping_.erase(new_kmer);
+        mapping_.set(old_kmer, new_kmer);
+        normalized_ = false;
+    }
+
 public:
     KmerMapper(const Graph &g) :
             base(g, "KmerMapper"),
             k_(unsigned(g.k() + 1)),
             mapping_(k_),
+            locks_(mapping_.shard_count()),
             normalized_(false) {
     }
 
@@ -66,26 +158,7 @@ public:
         if (normalized_)
             return;
 
-        adt::KMerVector<Kmer> all(k_, size());
-        for (auto it = begin(); it != end(); ++it)
-            all.push_back(it->first);
-
-        std::vector<const RawSeqData*> roots(all.size(), nullptr);
-
-#       pragma omp parallel for
-        for (size_t i = 0; i < all.size(); ++i) {
-            Seq val(k_, all[i]);
-            roots[i] = GetRoot(val);
-        }
-
-#       pragma omp parallel for
-        for (size_t i = 0; i < all.size(); ++i) {
-            if (roots[i] != nullptr) {
-                Seq kmer(k_, all[i]);
-                mapping_.set(kmer, Seq(k_, roots[i]));
-            }
-        }
-
+        mapping_.Normalize();
         normalized_ = true;
     }
 
@@ -102,44 +175,33 @@ public:
 //        }
 //    }
 
+    /**
+     * Could be called concurrently from several threads, the mapping is updated under
+     * per-shard locks.
+     */
     void RemapKmers(const Sequence &old_s, const Sequence &new_s) {
         VERIFY(this->IsAttached());
-        size_t old_length = old_s.size() - k_ + 1;
-        size_t new_length = new_s.size() - k_ + 1;
-        UniformPositionAligner aligner(old_s.size() - k_ + 1,
-                                       new_s.size() - k_ + 1);
-        Kmer old_kmer = old_s.start<Kmer>(k_) >> 'A';
-        typename Kmer::less2 kmer_less;
-        for (size_t i = k_ - 1; i < old_s.size(); ++i) {
-            old_kmer <<= old_s[i];
-
-            // Checking if already have info for this kmer
-            if (mapping_.count(old_kmer))
-                continue;
-
-            size_t old_kmer_offset = i - k_ + 1;
-            size_t new_kmer_offest = aligner.GetPosition(old_kmer_offset);
-            if (old_kmer_offset * 2 + 1 == old_length && new_length % 2 == 0) {
-                Kmer middle(k_-1, new_s, new_length / 2);
-                if (kmer_less(middle, !middle)) {
-                    new_kmer_offest = new_length - 1 - new_kmer_offest;
-                }
-            }
-            Kmer new_kmer(k_, new_s, new_kmer_offest);
-            if (old_kmer == new_kmer)
-                continue;
-
-            if (mapping_.count(new_kmer)) {
-                // Special case of remapping back.
-                // Not sure that we actually need it
-                if (Substitute(new_kmer) == old_kmer)
-                    mapping_.erase(new_kmer);
-                else
-                    continue;
-            }
+        std::vector<std::pair<Kmer, Kmer>> remaps;
+        CollectRemaps(old_s, new_s, remaps);
+        for (const auto &remap : remaps)
+            ApplyRemap(remap.first, remap.second);
+    }
 
-            mapping_.set(old_kmer, new_kmer);
-            normalized_ = false;
+    /**
+     * Same as calling RemapKmers for every pair of sequences in order. K-mer alignments
+     * are computed in parallel, then the remaps are applied in order under per-shard locks,
+     * so the batches could be submitted concurrently from several threads.
+     */
+    void RemapKmers(const std::vector<std::pair<Sequence, Sequence>> &batch) {
+        VERIFY(this->IsAttached());
+        std::vector<std::vector<std::pair<Kmer, Kmer>>> remaps(batch.size());
+#       pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < batch.size(); ++i)
+            CollectRemaps(batch[i].first, batch[i].second, remaps[i]);
+
+        for (const auto &pair_remaps : remaps) {
+            for (const auto &remap : pair_remaps)
+                ApplyRemap(remap.first, remap.second);
         }
     }
 
@@ -183,27 +245,11 @@ public:
     }
 
     void BinWrite(std::ostream &file) const {
-        uint32_t sz = (uint32_t)size();
-        file.write((const char *) &sz, sizeof(uint32_t));
-
-        for (auto iter = begin(); iter != end(); ++iter) {
-            Kmer::BinWrite(file, iter->first);
-            Kmer::BinWrite(file, iter->second);
-        }
+        mapping_.BinWrite(file);
     }
 
     void BinRead(std::istream &file) {
-        clear();
-
-        uint32_t size;
-        file.read((char *) &size, sizeof(uint32_t));
-        for (uint32_t i = 0; i < size; ++i) {
-            Kmer key(k_);
-            Seq value(k_);
-            Kmer::BinRead(file, &key);
-            Seq::BinRead(file, &value);
-            mapping_.set(key, value);
-        }
+        mapping_.BinRead(file);
         normalized_ = false;
     }
 
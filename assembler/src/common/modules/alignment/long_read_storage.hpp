@@ -13,6 +13,9 @@
 #include <map>
 #include <set>
 #include <algorithm>
+#include <numeric>
+#include <atomic>
+#include <mutex>
 
 namespace debruijn_graph {
 
@@ -49,10 +52,10 @@ public:
             path_(p), w_(weight) {
     }
 
-    PathInfo(const PathInfo<Graph> &other) {
-        path_ = other.path_;
-        w_ = other.w_;
-    }
+    PathInfo(const PathInfo<Graph> &other) = default;
+    PathInfo(PathInfo<Graph> &&other) = default;
+    PathInfo &operator=(const PathInfo<Graph> &other) = default;
+    PathInfo &operator=(PathInfo<Graph> &&other) = default;
 
     std::string str(const Graph &g_) const {
         std::stringstream s;
@@ -63,89 +66,192 @@ public:
     }
 };
 
+/**
+ * @brief Storage of long read paths with weights.
+ *        Paths are kept in a contiguous table sorted lexicographically (hence grouped by the
+ *        start edge), duplicates are collapsed with their weights summed up. New paths are
+ *        appended to an unsorted buffer which is merged into the table once it grows as large
+ *        as the table itself or the table is queried. Per-thread storages could therefore be
+ *        filled without any synchronization and merged afterwards via AddStorage.
+ *        Queries merging the buffer do it under a lock, so a storage could be read from
+ *        several threads at once.
+ */
 template<class Graph>
 class PathStorage {
-    friend class PathInfo<Graph> ;
     typedef typename Graph::EdgeId EdgeId;
-    typedef std::map<EdgeId, std::set<PathInfo<Graph>>> InnerIndex;
+
+    // Edges of i-th path are edges[offsets[i]..offsets[i + 1])
+    struct PathTable {
+        std::vector<EdgeId> edges;
+        std::vector<size_t> offsets;
+        std::vector<size_t> weights;
+
+        PathTable()
+                : offsets(1, 0) {}
+
+        size_t size() const {
+            return weights.size();
+        }
+
+        const EdgeId *begin(size_t i) const {
+            return edges.data() + offsets[i];
+        }
+
+        const EdgeId *end(size_t i) const {
+            return edges.data() + offsets[i + 1];
+        }
+
+        size_t length(size_t i) const {
+            return offsets[i + 1] - offsets[i];
+        }
+
+        bool Less(size_t i, const PathTable &other, size_t j) const {
+            return std::lexicographical_compare(begin(i), end(i), other.begin(j), other.end(j));
+        }
+
+        bool Equal(size_t i, const PathTable &other, size_t j) const {
+            return length(i) == other.length(j) && std::equal(begin(i), end(i), other.begin(j));
+        }
+
+        template<class It>
+        void Add(It b, It e, size_t w) {
+            edges.insert(edges.end(), b, e);
+            offsets.push_back(edges.size());
+            weights.push_back(w);
+        }
+
+        void Append(const PathTable &other) {
+            edges.reserve(edges.size() + other.edges.size());
+            for (size_t i = 0; i < other.size(); ++i)
+                Add(other.begin(i), other.end(i), other.weights[i]);
+        }
+
+        void Clear() {
+            PathTable().Swap(*this);
+        }
+
+        void Swap(PathTable &other) {
+            edges.swap(other.edges);
+            offsets.swap(other.offsets);
+            weights.swap(other.weights);
+        }
+
+        // Sorts paths lexicographically, equal paths are collapsed with their weights summed up
+        // if sum_weights is set, otherwise the first one is kept
+        void SortUnique(bool sum_weights) {
+            std::vector<size_t> order(size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [this](size_t i, size_t j) {
+                return Less(i, *this, j);
+            });
+
+            PathTable res;
+            res.edges.reserve(edges.size());
+            for (size_t i : order) {
+                size_t last = res.size() - 1;
+                if (res.size() && res.Equal(last, *this, i)) {
+                    if (sum_weights)
+                        res.weights[last] += weights[i];
+                    continue;
+                }
+                res.Add(begin(i), end(i), weights[i]);
+            }
+            Swap(res);
+        }
+
+        // Merges two sorted tables without duplicates, weights of equal paths are summed up
+        static PathTable Merge(const PathTable &a, const PathTable &b) {
+            PathTable res;
+            res.edges.reserve(a.edges.size() + b.edges.size());
+            size_t i = 0, j = 0;
+            while (i < a.size() || j < b.size()) {
+                if (j == b.size() || (i < a.size() && a.Less(i, b, j))) {
+                    res.Add(a.begin(i), a.end(i), a.weights[i]);
+                    ++i;
+                } else if (i == a.size() || b.Less(j, a, i)) {
+                    res.Add(b.begin(j), b.end(j), b.weights[j]);
+                    ++j;
+                } else {
+                    res.Add(a.begin(i), a.end(i), a.weights[i] + b.weights[j]);
+                    ++i, ++j;
+                }
+            }
+            return res;
+        }
+    };
 
     const Graph &g_;
-    InnerIndex inner_index_;
+    // Consolidation happens lazily on queries as well, hence mutable
+    mutable PathTable table_;
+    mutable PathTable pending_;
+    // Set while pending_ is not empty, checked by the queries before taking the lock
+    mutable std::atomic<bool> dirty_;
+    mutable std::mutex consolidate_lock_;
     static const size_t kLongEdgeForStats = 500;
+    static const size_t kMinPendingPaths = 1 << 12;
 
     void HiddenAddPath(const std::vector<EdgeId> &p, int w) {
-        if (p.size() == 0 ) return;
-        for (typename std::set<PathInfo<Graph>>::iterator iter = inner_index_[p[0]].begin(); iter != inner_index_[p[0]].end(); ++iter) {
-            if (iter->path() == p) {
-                iter->increase_weight(w);
-                return;
-            }
+        if (p.size() == 0) return;
+        pending_.Add(p.begin(), p.end(), size_t(w));
+        dirty_.store(true, std::memory_order_relaxed);
+        if (pending_.size() >= std::max(table_.size(), kMinPendingPaths))
+            Consolidate();
+    }
+
+    void Consolidate() const {
+        if (!dirty_.load(std::memory_order_acquire))
+            return;
+        std::lock_guard<std::mutex> lock(consolidate_lock_);
+        if (!dirty_.load(std::memory_order_relaxed))
+            return;
+        pending_.SortUnique(/*sum_weights*/true);
+        PathTable merged = PathTable::Merge(table_, pending_);
+        table_.Swap(merged);
+        pending_.Clear();
+        dirty_.store(false, std::memory_order_release);
+    }
+
+    // Calls f(begin, end) for every group of paths sharing the start edge
+    template<class F>
+    void ForEachStartEdge(F f) const {
+        Consolidate();
+        for (size_t i = 0; i < table_.size(); ) {
+            size_t j = i + 1;
+            while (j < table_.size() && *table_.begin(j) == *table_.begin(i))
+                ++j;
+            f(i, j);
+            i = j;
         }
-        inner_index_[p[0]].insert(PathInfo<Graph>(p, w));
-        size_++;
+    }
+
+    PathInfo<Graph> Info(size_t i) const {
+        return PathInfo<Graph>(std::vector<EdgeId>(table_.begin(i), table_.end(i)), table_.weights[i]);
     }
 
 public:
     PathStorage(const Graph &g)
-            : g_(g),
-              inner_index_(),
-              size_(0) {
+            : g_(g), dirty_(false) {
     }
 
-    PathStorage(const PathStorage & p)
-            : g_(p.g_),
-              inner_index_(),
-              size_(0) {
-        for (auto iter = p.inner_index_.begin(); iter != p.inner_index_.end();
-                iter++) {
-            for (auto j_iter = iter->second.begin();
-                    j_iter != iter->second.end(); j_iter++) {
-                this->AddPath(j_iter->path(), (int) j_iter->weight());
-            }
-        }
+    PathStorage(const PathStorage &p)
+            : g_(p.g_), dirty_(false) {
+        p.Consolidate();
+        table_ = p.table_;
     }
 
     void ReplaceEdges(std::map<EdgeId, EdgeId> &old_to_new){
-        std::map<int, EdgeId> tmp_map;
-//        for (auto iter = g_.SmartEdgeBegin(); !iter.IsEnd(); ++iter ){
-//            tmp_map[g_.int_id(*iter)] = *iter;
-//        }
-        InnerIndex new_index;
-        for (auto iter = inner_index_.begin(); iter != inner_index_.end(); iter++) {
-            auto tmp = iter->second;
-            EdgeId new_first;
-            if (old_to_new.find(iter->first) == old_to_new.end())
-                new_first = iter->first;
-            else {
-                DEBUG("new first edge: "<< g_.int_id(old_to_new[iter->first]) << " with " << tmp.size() << " edges ");
-                new_first = old_to_new[iter->first];
+        Consolidate();
+        size_t replaced = 0;
+        for (auto &e : table_.edges) {
+            auto it = old_to_new.find(e);
+            if (it != old_to_new.end()) {
+                e = it->second;
+                ++replaced;
             }
-            std::set<PathInfo<Graph>> new_tmp;
-            for (auto j_iter = tmp.begin(); j_iter != tmp.end(); j_iter++) {
-                PathInfo<Graph> pi = *(j_iter);
-                for (size_t k = 0; k < pi.path().size(); k++)
-                    if (old_to_new.find(pi.path()[k]) != old_to_new.end()) {
-//                        INFO(g_.int_id(old_to_new[pi.path[k]]));
-                        pi.path()[k] = old_to_new[pi.path()[k]];
-                    }
-                DEBUG(pi.str(g_));
-                new_tmp.insert(pi);
-
-            }
-            if (new_first != iter->first) {
-                TRACE("and mmew_tmp.size: "<< new_tmp.size());
-            }
-            if (new_index.find(new_first) == new_index.end()) {
-                new_index[new_first] = new_tmp;
-            } else {
-                for (auto j_iter = new_tmp.begin(); j_iter != new_tmp.end(); j_iter++) {
-                    new_index[new_first].insert(*j_iter);
-                }
-            }
-
         }
-
-        inner_index_ = new_index;
+        DEBUG("Replaced " << replaced << " edge occurrences in " << table_.size() << " paths");
+        // Paths which became equal after the replacement are not merged, the first one is kept
+        table_.SortUnique(/*sum_weights*/false);
     }
 
     void AddPath(const std::vector<EdgeId> &p, int w, bool add_rc = false) {
@@ -165,21 +271,23 @@ public:
 
     void BinWrite(std::ostream &str) const {
         using io::binary::BinWrite;
-        BinWrite(str, inner_index_.size());
-        for (const auto &i : inner_index_) {
-            BinWrite(str, (size_t)i.second.size());
-            for (const auto &j : i.second) {
-                BinWrite(str, j.weight());
-                BinWrite(str, j.path().size());
-                for (const auto &p : j.path()) {
-                    BinWrite(str, g_.int_id(p));
+        size_t groups = 0;
+        ForEachStartEdge([&](size_t, size_t) { ++groups; });
+        BinWrite(str, groups);
+        ForEachStartEdge([&](size_t b, size_t e) {
+            BinWrite(str, e - b);
+            for (size_t i = b; i < e; ++i) {
+                BinWrite(str, table_.weights[i]);
+                BinWrite(str, table_.length(i));
+                for (const EdgeId *p = table_.begin(i); p != table_.end(i); ++p) {
+                    BinWrite(str, g_.int_id(*p));
                 }
             }
-        }
+        });
     }
 
     void BinRead(std::istream &str) {
-        inner_index_.clear();
+        Clear();
         using io::binary::BinRead;
 
         auto size = BinRead<size_t>(str);
@@ -204,26 +312,23 @@ public:
         std::ofstream filestr(filename);
         std::set<EdgeId> continued_edges;
 
-        for(auto iter = inner_index_.begin(); iter != inner_index_.end(); ++iter){
-            filestr << iter->second.size() << std::endl;
-            int non1 = 0;
-            for (auto j_iter = iter->second.begin(); j_iter != iter->second.end(); ++j_iter) {
-                filestr << " Weight: " << j_iter->weight();
-                if (j_iter->weight() > stats_weight_cutoff)
-                    non1++;
-
-                filestr << " length: " << j_iter->path().size() << " ";
-                for (auto p_iter = j_iter->path().begin(); p_iter != j_iter->path().end(); ++p_iter) {
-                    if (p_iter != j_iter->path().end() - 1 && j_iter->weight() > stats_weight_cutoff) {
-                        continued_edges.insert(*p_iter);
+        ForEachStartEdge([&](size_t b, size_t e) {
+            filestr << e - b << std::endl;
+            for (size_t i = b; i < e; ++i) {
+                size_t weight = table_.weights[i];
+                filestr << " Weight: " << weight;
+                filestr << " length: " << table_.length(i) << " ";
+                for (const EdgeId *p = table_.begin(i); p != table_.end(i); ++p) {
+                    if (p != table_.end(i) - 1 && weight > stats_weight_cutoff) {
+                        continued_edges.insert(*p);
                     }
 
-                    filestr << g_.int_id(*p_iter) << "(" << g_.length(*p_iter) << ") ";
+                    filestr << g_.int_id(*p) << "(" << g_.length(*p) << ") ";
                 }
                 filestr << std::endl;
             }
             filestr << std::endl;
-        }
+        });
 
         int noncontinued = 0;
         int long_gapped = 0;
@@ -258,11 +363,10 @@ public:
     }
 
     void SaveAllPaths(std::vector<PathInfo<Graph>> &res) const {
-        for (auto iter = inner_index_.begin(); iter != inner_index_.end(); ++iter) {
-            for (auto j_iter = iter->second.begin(); j_iter != iter->second.end(); ++j_iter) {
-                res.push_back(*j_iter);
-            }
-        }
+        Consolidate();
+        res.reserve(res.size() + table_.size());
+        for (size_t i = 0; i < table_.size(); ++i)
+            res.push_back(Info(i));
     }
 
     void LoadFromFile(const std::string &s, bool force_exists = true) {
@@ -317,35 +421,28 @@ public:
         INFO("Loading finished.");
     }
 
+    /**
+     * @brief Adds all the paths of the given storage. Paths are only appended to the buffer,
+     *        so merging many per-thread storages one by one does not rebuild the table each time.
+     */
     void AddStorage(PathStorage<Graph> &to_add) {
-        for (auto iter = to_add.inner_index_.begin(); iter != to_add.inner_index_.end(); iter++) {
-            for(auto j_iter = iter->second.begin(); j_iter != iter->second.end(); j_iter ++) {
-                this->AddPath(j_iter->path(), (int) j_iter->weight());
-            }
-        }
+        to_add.Consolidate();
+        pending_.Append(to_add.table_);
+        dirty_.store(true, std::memory_order_relaxed);
+        if (pending_.size() >= std::max(table_.size(), kMinPendingPaths))
+            Consolidate();
     }
 
     void Clear() {
-        inner_index_.clear();
-        size_ = 0;
+        table_.Clear();
+        pending_.Clear();
+        dirty_.store(false, std::memory_order_relaxed);
     }
 
     size_t size() const {
-        return size_;
+        Consolidate();
+        return table_.size();
     }
-
-//    typename InnerIndex::iterator begin() const {
-//        return inner_index.begin();
-//    }
-//
-//    typename InnerIndex::iterator end() const {
-//        return inner_index.end();
-//    }
-//    typename InnerIndex::iterator operator*(){
-//        return this->first;
-//    }
-private:
-    size_t size_;
 };
 
 template<class Graph>
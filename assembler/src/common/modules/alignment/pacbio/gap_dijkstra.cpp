@@ -13,6 +13,157 @@ using namespace std;
 const int DijkstraGraphSequenceBase::SHORT_SEQ_LENGTH;
 const int DijkstraGraphSequenceBase::ED_DEVIATION;
 
+const size_t DijkstraStateTable::NO_STATE;
+const size_t DijkstraStateTable::ARITY;
+const size_t DijkstraStateTable::MIN_CAPACITY;
+
+DijkstraStateTable::DijkstraStateTable()
+        : slots_(MIN_CAPACITY, NO_STATE) {}
+
+void DijkstraStateTable::Clear() {
+    for (size_t slot : slot_of_)
+        slots_[slot] = NO_STATE;
+    states_.clear();
+    slot_of_.clear();
+    scores_.clear();
+    prevs_.clear();
+    heap_pos_.clear();
+    heap_.clear();
+}
+
+size_t DijkstraStateTable::Find(const QueueState &state) const {
+    for (size_t slot = Slot(state); slots_[slot] != NO_STATE; slot = (slot + 1) & (slots_.size() - 1)) {
+        if (states_[slots_[slot]] == state)
+            return slots_[slot];
+    }
+    return NO_STATE;
+}
+
+size_t DijkstraStateTable::Insert(const QueueState &state, int score, size_t prev) {
+    //Load factor is kept below 1/2
+    if (2 * (states_.size() + 1) > slots_.size())
+        Rehash(2 * slots_.size());
+
+    size_t slot = Slot(state);
+    for (; slots_[slot] != NO_STATE; slot = (slot + 1) & (slots_.size() - 1)) {
+        if (states_[slots_[slot]] == state)
+            return slots_[slot];
+    }
+
+    size_t id = states_.size();
+    slots_[slot] = id;
+    states_.push_back(state);
+    slot_of_.push_back(slot);
+    scores_.push_back(score);
+    prevs_.push_back(prev);
+    heap_pos_.push_back(NO_STATE);
+    return id;
+}
+
+void DijkstraStateTable::Rehash(size_t capacity) {
+    slots_.assign(capacity, NO_STATE);
+    for (size_t id = 0; id < states_.size(); ++id) {
+        size_t slot = Slot(states_[id]);
+        while (slots_[slot] != NO_STATE)
+            slot = (slot + 1) & (slots_.size() - 1);
+        slots_[slot] = id;
+        slot_of_[id] = slot;
+    }
+}
+
+void DijkstraStateTable::SiftUp(size_t pos) {
+    size_t id = heap_[pos];
+    while (pos > 0) {
+        size_t parent = (pos - 1) / ARITY;
+        if (!Less(id, heap_[parent]))
+            break;
+        Place(pos, heap_[parent]);
+        pos = parent;
+    }
+    Place(pos, id);
+}
+
+void DijkstraStateTable::SiftDown(size_t pos) {
+    size_t id = heap_[pos];
+    while (true) {
+        size_t first = pos * ARITY + 1;
+        if (first >= heap_.size())
+            break;
+        size_t best = first;
+        for (size_t child = first + 1; child < std::min(first + ARITY, heap_.size()); ++child) {
+            if (Less(heap_[child], heap_[best]))
+                best = child;
+        }
+        if (!Less(heap_[best], id))
+            break;
+        Place(pos, heap_[best]);
+        pos = best;
+    }
+    Place(pos, id);
+}
+
+void DijkstraStateTable::Push(size_t id) {
+    VERIFY(!queued(id));
+    heap_.push_back(id);
+    SiftUp(heap_.size() - 1);
+}
+
+void DijkstraStateTable::Remove(size_t id) {
+    if (!queued(id))
+        return;
+    size_t pos = heap_pos_[id];
+    heap_pos_[id] = NO_STATE;
+    size_t last = heap_.back();
+    heap_.pop_back();
+    if (pos == heap_.size())
+        return;
+    Place(pos, last);
+    SiftUp(pos);
+    SiftDown(heap_pos_[last]);
+}
+
+size_t DijkstraStateTable::PopMin() {
+    VERIFY(!heap_.empty());
+    size_t id = heap_.front();
+    Remove(id);
+    return id;
+}
+
+namespace {
+
+struct ThreadStateTable {
+    DijkstraStateTable table;
+    bool in_use = false;
+};
+
+thread_local ThreadStateTable thread_state_table;
+
+}
+
+std::shared_ptr<DijkstraStateTable> DijkstraGraphSequenceBase::AcquireStateTable() {
+    ThreadStateTable *owner = &thread_state_table;
+    if (owner->in_use)
+        return std::make_shared<DijkstraStateTable>();
+
+    owner->in_use = true;
+    owner->table.Clear();
+    //The aligner may be destroyed by another thread, so the flag of the owning thread is released
+    return std::shared_ptr<DijkstraStateTable>(&owner->table,
+                                               [owner](DijkstraStateTable*) { owner->in_use = false; });
+}
+
+int DijkstraGraphSequenceBase::VisitedScore(const QueueState &state) const {
+    size_t id = states_->Find(state);
+    return id == DijkstraStateTable::NO_STATE ? 0 : states_->score(id);
+}
+
+QueueState DijkstraGraphSequenceBase::PrevState(const QueueState &state) const {
+    size_t id = states_->Find(state);
+    if (id == DijkstraStateTable::NO_STATE || states_->prev(id) == DijkstraStateTable::NO_STATE)
+        return QueueState();
+    return states_->state(states_->prev(id));
+}
+
 bool DijkstraGraphSequenceBase::IsBetter(int seq_ind, int ed) {
     if (seq_ind == (int) ss_.size() ) {
         if (ed <= path_max_length_) {
@@ -31,22 +182,22 @@ bool DijkstraGraphSequenceBase::IsBetter(int seq_ind, int ed) {
 }
 
 void DijkstraGraphSequenceBase::Update(const QueueState &state, const QueueState &prev_state, int score) {
-    if (visited_.count(state) > 0) {
-        if (visited_[state] >= score) {
+    size_t prev_id = prev_state.empty() ? DijkstraStateTable::NO_STATE : states_->Find(prev_state);
+    VERIFY(prev_state.empty() || prev_id != DijkstraStateTable::NO_STATE);
+    size_t id = states_->Find(state);
+    if (id != DijkstraStateTable::NO_STATE) {
+        if (states_->score(id) >= score) {
             ++ updates_;
-            q_.erase(make_pair(visited_[state], state));
+            states_->Remove(id);
             if (IsBetter(state.i, score)) {
-                q_.insert(make_pair(score, state));
-                visited_[state] = score;
-                prev_states_[state] = prev_state;
+                states_->Set(id, score, prev_id);
+                states_->Push(id);
             }
         }
     } else {
         if (IsBetter(state.i, score)) {
             ++ updates_;
-            visited_.insert(make_pair(state, score));
-            prev_states_.insert(make_pair(state, prev_state));
-            q_.insert(make_pair(score, state));
+            states_->Push(states_->Insert(state, score, prev_id));
         }
     }
 }
@@ -92,7 +243,7 @@ void DijkstraGraphSequenceBase::AddNewEdge(const GraphState &gs, const QueueStat
 }
 
 bool DijkstraGraphSequenceBase::QueueLimitsExceeded(size_t iter) {
-    return_code_.queue_limit = q_.size() > queue_limit_;
+    return_code_.queue_limit = states_->queue_size() > queue_limit_;
     return_code_.iter_limit = iter > iter_limit_;
     return return_code_.status;
 }
@@ -102,15 +253,15 @@ bool DijkstraGraphSequenceBase::RunDijkstra() {
     size_t iter = 0;
     QueueState cur_state;
     int ed = 0;
-    while (q_.size() > 0 &&
+    while (states_->queue_size() > 0 &&
             !QueueLimitsExceeded(iter) &&
             ed <= path_max_length_ &&
             updates_ < gap_cfg_.updates_limit) {
-        cur_state = q_.begin()->second;
-        ed = visited_[cur_state];
+        size_t cur_id = states_->PopMin();
+        cur_state = states_->state(cur_id);
+        ed = states_->score(cur_id);
         ++ iter;
-        q_.erase(q_.begin());
-        if (visited_.count(end_qstate_) > 0) {
+        if (states_->Find(end_qstate_) != DijkstraStateTable::NO_STATE) {
             found_path = true;
         }
         if (IsEndPosition(cur_state)) {
@@ -136,13 +287,14 @@ void DijkstraGraphSequenceBase::CloseGap() {
     if (found_path) {
         QueueState state(end_qstate_);
         while (!state.empty()) {
-            min_score_ = visited_[end_qstate_];
-            int start_edge = prev_states_[state].i;
+            min_score_ = VisitedScore(end_qstate_);
+            QueueState prev_state = PrevState(state);
+            int start_edge = prev_state.i;
             int end_edge =  state.i;
             mapping_path_.push_back(state.gs.e,
                                     omnigraph::MappingRange(Range(start_edge, end_edge),
                                             Range(state.gs.start_pos, state.gs.end_pos) ));
-            state = prev_states_[state];
+            state = prev_state;
         }
         mapping_path_.reverse();
     }
@@ -11,6 +11,10 @@
 
 #include "sequence/sequence_tools.hpp"
 #include "utils/perf/perfcounter.hpp"
+#include "utils/verify.hpp"
+
+#include <memory>
+#include <vector>
 
 namespace sensitive_aligner {
 
@@ -149,6 +153,94 @@ struct hash<sensitive_aligner::QueueState> {
 
 namespace sensitive_aligner {
 
+/*
+ * Flat storage of the search states: open addressing index over contiguous arrays of
+ * states, scores and back pointers, plus an indexed 4-ary heap of queued states ordered
+ * by (score, state). The memory is kept between searches, Clear() only resets used entries.
+ */
+class DijkstraStateTable {
+  public:
+    static const size_t NO_STATE = size_t(-1);
+
+    DijkstraStateTable();
+
+    void Clear();
+
+    size_t Find(const QueueState &state) const;
+
+    //Adds the state if it is not present, returns its id
+    size_t Insert(const QueueState &state, int score, size_t prev);
+
+    size_t size() const {
+        return states_.size();
+    }
+
+    const QueueState &state(size_t id) const {
+        return states_[id];
+    }
+
+    int score(size_t id) const {
+        return scores_[id];
+    }
+
+    size_t prev(size_t id) const {
+        return prevs_[id];
+    }
+
+    void Set(size_t id, int score, size_t prev) {
+        VERIFY(!queued(id));
+        scores_[id] = score;
+        prevs_[id] = prev;
+    }
+
+    bool queued(size_t id) const {
+        return heap_pos_[id] != NO_STATE;
+    }
+
+    void Push(size_t id);
+
+    //Removes the state from the queue if it is there
+    void Remove(size_t id);
+
+    size_t PopMin();
+
+    size_t queue_size() const {
+        return heap_.size();
+    }
+
+  private:
+    static const size_t ARITY = 4;
+    static const size_t MIN_CAPACITY = 1024;
+
+    size_t Slot(const QueueState &state) const {
+        return std::hash<QueueState>()(state) & (slots_.size() - 1);
+    }
+
+    void Rehash(size_t capacity);
+
+    bool Less(size_t id1, size_t id2) const {
+        return scores_[id1] < scores_[id2] ||
+               (scores_[id1] == scores_[id2] && states_[id1] < states_[id2]);
+    }
+
+    void Place(size_t pos, size_t id) {
+        heap_[pos] = id;
+        heap_pos_[id] = pos;
+    }
+
+    void SiftUp(size_t pos);
+
+    void SiftDown(size_t pos);
+
+    std::vector<size_t> slots_;
+    std::vector<QueueState> states_;
+    std::vector<size_t> slot_of_;
+    std::vector<int> scores_;
+    std::vector<size_t> prevs_;
+    std::vector<size_t> heap_pos_;
+    std::vector<size_t> heap_;
+};
+
 class DijkstraGraphSequenceBase {
   public:
     DijkstraGraphSequenceBase(const debruijn_graph::Graph &g,
@@ -164,7 +256,8 @@ class DijkstraGraphSequenceBase {
         , min_score_(std::numeric_limits<int>::max())
         , queue_limit_(gap_cfg_.queue_limit)
         , iter_limit_(gap_cfg_.iteration_limit)
-        , updates_(0) {
+        , updates_(0)
+        , states_(AcquireStateTable()) {
         best_ed_.resize(ss_.size(), path_max_length_);
         AddNewEdge(GraphState(start_e_, start_p_, (int) g_.length(start_e_)), QueueState(), 0);
     }
@@ -209,6 +302,12 @@ class DijkstraGraphSequenceBase {
   protected:
     bool IsBetter(int seq_ind, int ed);
 
+    //Score of the visited state, 0 if not visited
+    int VisitedScore(const QueueState &state) const;
+
+    //Previous state on the best path, empty if not visited
+    QueueState PrevState(const QueueState &state) const;
+
     void Update(const QueueState &state, const QueueState &prev_state, int score);
 
     void AddNewEdge(const GraphState &gs, const QueueState &prev_state, int ed);
@@ -240,14 +339,16 @@ class DijkstraGraphSequenceBase {
     static const int SHORT_SEQ_LENGTH = 100;
     static const int ED_DEVIATION = 20;
 
-    std::set<std::pair<int, QueueState>> q_;
-    std::unordered_map<QueueState, int> visited_;
-    std::unordered_map<QueueState, QueueState> prev_states_;
+    //Table of the current thread is reused by consecutive searches, simultaneous ones get their own tables
+    static std::shared_ptr<DijkstraStateTable> AcquireStateTable();
+
     std::vector<int> best_ed_;
 
     const size_t queue_limit_;
     const size_t iter_limit_;
     size_t updates_;
+
+    std::shared_ptr<DijkstraStateTable> states_;
 };
 
 
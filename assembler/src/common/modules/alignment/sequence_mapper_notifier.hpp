@@ -13,7 +13,10 @@
 #include "io/reads/read_stream_vector.hpp"
 #include "pipeline/graph_pack.hpp"
 #include "common/utils/memory_limit.hpp"
+#include "common/utils/perf/timetracer.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
+#include <functional>
 #include <vector>
 #include <cstdlib>
 
@@ -38,7 +41,11 @@ public:
 };
 
 class SequenceMapperNotifier {
+    // Maximum number of reads per thread between buffer merges and a rough estimate
+    // of listener buffer footprint per read (e.g. paired info points)
     static constexpr size_t BUFFER_SIZE = 200000;
+    static constexpr size_t MIN_BUFFER_SIZE = 10000;
+    static constexpr size_t READ_FOOTPRINT = 1024;
 public:
     typedef SequenceMapper<conj_graph_pack::graph_t> SequenceMapperT;
 
@@ -58,9 +65,14 @@ public:
         if (threads_count == 0)
             threads_count = streams.size();
 
+        TIME_TRACE_SCOPE("Read mapping, library #" + std::to_string(lib_index), "mapping");
         streams.reset();
         NotifyStartProcessLibrary(lib_index, threads_count);
         size_t counter = 0, n = 15;
+        auto &governor = utils::MemoryGovernor::instance();
+        size_t buffer_size = governor.ItemCount(READ_FOOTPRINT, BUFFER_SIZE, MIN_BUFFER_SIZE, threads_count);
+        if (buffer_size < BUFFER_SIZE)
+            INFO("Read buffer size reduced to " << buffer_size << " due to memory limit");
 
         #pragma omp parallel for num_threads(threads_count) shared(counter)
         for (size_t i = 0; i < streams.size(); ++i) {
@@ -68,7 +80,9 @@ public:
             ReadType r;
             auto& stream = streams[i];
             while (!stream.eof()) {
-                if (size == BUFFER_SIZE) {
+                // Merge buffers early if we are running out of memory
+                if (size == buffer_size ||
+                    (size % MIN_BUFFER_SIZE == 0 && size && governor.under_pressure())) {
                     #pragma omp critical
                     {
                         counter += size;
@@ -95,6 +109,47 @@ public:
         NotifyStopProcessLibrary(lib_index);
     }
 
+    /**
+     * Maps the library portion by portion in the given order. Portions are opened on demand
+     * and processed in batches of threads_count, all listener buffers are merged after every
+     * batch and then stop(number of portions processed) is asked whether to finish early.
+     * @return number of portions processed
+     */
+    template<class ReadType>
+    size_t ProcessLibraryPortions(const std::function<io::ReadStream<ReadType>(size_t)> &portion,
+                                  const std::vector<size_t> &order,
+                                  size_t lib_index, const SequenceMapperT& mapper, size_t threads_count,
+                                  const std::function<bool(size_t)> &stop) {
+        TIME_TRACE_SCOPE("Read mapping, library #" + std::to_string(lib_index), "mapping");
+        NotifyStartProcessLibrary(lib_index, threads_count);
+        size_t counter = 0, processed = 0;
+        while (processed < order.size()) {
+            size_t batch_end = std::min(order.size(), processed + threads_count);
+
+            #pragma omp parallel for num_threads(threads_count) schedule(dynamic) reduction(+:counter)
+            for (size_t i = processed; i < batch_end; ++i) {
+                size_t thread = omp_get_thread_num();
+                auto stream = portion(order[i]);
+                ReadType r;
+                while (!stream.eof()) {
+                    stream >> r;
+                    ++counter;
+                    NotifyProcessRead(r, mapper, lib_index, thread);
+                }
+            }
+
+            for (size_t i = 0; i < threads_count; ++i)
+                NotifyMergeBuffer(lib_index, i);
+            processed = batch_end;
+            if (stop(processed))
+                break;
+        }
+
+        INFO("Total " << counter << " reads processed");
+        NotifyStopProcessLibrary(lib_index);
+        return processed;
+    }
+
 private:
     template<class ReadType>
     void NotifyProcessRead(const ReadType& r, const SequenceMapperT& mapper, size_t ilib, size_t ithread) const;
@@ -188,18 +188,29 @@ public:
     }
 
     std::vector<const BidirectionalPath*> FindCandidatePaths(const BidirectionalPath &path) const {
-        std::set<const BidirectionalPath*> candidates;
+        return FindCandidatePaths(path, coverage_map_);
+    }
+
+    //CoverageIndex should provide GetCoveringPaths(EdgeId) returning a range of paths
+    //Candidates are sorted by pointer value
+    template<class CoverageIndex>
+    std::vector<const BidirectionalPath*> FindCandidatePaths(const BidirectionalPath &path,
+                                                             const CoverageIndex &index) const {
+        std::vector<const BidirectionalPath*> candidates;
         size_t cum_len = 0;
         for (size_t i = 0; i < path.Size(); ++i) {
             if (cum_len > max_diff_)
                 break;
             EdgeId e = path.At(i);
             if (g_.length(e) >= min_edge_len_) {
-                utils::insert_all(candidates, coverage_map_.GetCoveringPaths(e));
+                auto covering = index.GetCoveringPaths(e);
+                candidates.insert(candidates.end(), covering.begin(), covering.end());
                 cum_len += path.ShiftLength(i);
             }
         }
-        return std::vector<const BidirectionalPath*>(candidates.begin(), candidates.end());
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        return candidates;
     }
 
 private:
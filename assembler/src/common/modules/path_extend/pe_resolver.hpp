@@ -15,24 +15,75 @@
 #pragma once
 
 #include "path_extender.hpp"
+#include "adt/iterator_range.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
 namespace path_extend {
 
 typedef const BidirectionalPath * PathPtr;
-typedef std::unordered_map<PathPtr, std::set<size_t>> SplitsStorage;
+//Split positions are kept sorted and unique
+typedef std::unordered_map<PathPtr, std::vector<size_t>> SplitsStorage;
 
 inline void PopFront(BidirectionalPath * const path, size_t cnt) {
     path->GetConjPath()->PopBack(cnt);
 }
 
+inline void AddSplits(std::vector<size_t> &splits, const std::vector<size_t> &to_add) {
+    splits.insert(splits.end(), to_add.begin(), to_add.end());
+    std::sort(splits.begin(), splits.end());
+    splits.erase(std::unique(splits.begin(), splits.end()), splits.end());
+}
+
+//Read-only flat copy of the coverage map, which can be queried concurrently
+//without copying the path sets.
+class CoverageSnapshot {
+    typedef std::pair<EdgeId, PathPtr> Entry;
+    std::vector<Entry> entries_;
+
+    struct EdgeLess {
+        bool operator()(const Entry &entry, EdgeId e) const { return entry.first < e; }
+        bool operator()(EdgeId e, const Entry &entry) const { return e < entry.first; }
+    };
+
+    struct SecondIterator : public std::vector<Entry>::const_iterator {
+        typedef std::vector<Entry>::const_iterator base;
+        SecondIterator(base it) : base(it) {}
+        PathPtr operator*() const { return base::operator*().second; }
+    };
+
+public:
+    explicit CoverageSnapshot(const GraphCoverageMap &coverage_map) {
+        for (const auto &edge_paths : coverage_map)
+            for (PathPtr path : *edge_paths.second)
+                entries_.emplace_back(edge_paths.first, path);
+        std::sort(entries_.begin(), entries_.end());
+        entries_.erase(std::unique(entries_.begin(), entries_.end()), entries_.end());
+    }
+
+    adt::iterator_range<SecondIterator> GetCoveringPaths(EdgeId e) const {
+        auto range = std::equal_range(entries_.begin(), entries_.end(), e, EdgeLess());
+        return adt::make_range(SecondIterator(range.first), SecondIterator(range.second));
+    }
+};
+
 class OverlapRemover {
     const PathContainer &paths_;
+    const GraphCoverageMap &coverage_map_;
     const OverlapFindingHelper helper_;
     SplitsStorage splits_;
 
+    //Overlap of the path start with other path.
+    //If check_added is set, overlap should be ignored when the region of other path has already been marked.
+    struct StartOverlap {
+        size_t overlap;
+        PathPtr other;
+        Range other_range;
+        bool check_added;
+    };
+
     bool AlreadyAdded(PathPtr ptr, size_t pos) const {
         auto it = splits_.find(ptr);
-        return it != splits_.end() && it->second.count(pos);
+        return it != splits_.end() && std::binary_search(it->second.begin(), it->second.end(), pos);
     }
 
     //TODO if situation start ==0 && end==p.Size is not interesting then code can be simplified
@@ -45,33 +96,29 @@ class OverlapRemover {
     }
 
     //NB! This can only be launched over paths taken from path container!
-    size_t AnalyzeOverlaps(const BidirectionalPath &path, const BidirectionalPath &other,
-                           bool end_start_only, bool retain_one_copy) const {
+    //Does not depend on the splits found so far, so could be launched concurrently
+    StartOverlap AnalyzeOverlaps(const BidirectionalPath &path, const BidirectionalPath &other,
+                                 bool end_start_only, bool retain_one_copy) const {
         VERIFY(!retain_one_copy || !end_start_only);
         auto range_pair = helper_.FindOverlap(path, other, end_start_only);
         size_t overlap = range_pair.first.size();
         auto other_range = range_pair.second;
 
         if (overlap == 0) {
-            return 0;
+            return {0, &other, other_range, false};
         }
 
         //checking if region on the other path has not been already added
         //TODO discuss if the logic is needed/correct. It complicates the procedure and prevents trivial parallelism.
-        if (retain_one_copy &&
-                AlreadyAdded(other,
-                             other_range.start_pos,
-                             other_range.end_pos) &&
+        bool check_added = retain_one_copy &&
                 /*forcing "cut_all" behavior on conjugate paths*/
                 &other != path.GetConjPath() &&
                 /*certain overkill*/
-                &other != &path) {
-            return 0;
-        }
+                &other != &path;
 
         if (&other == &path) {
             if (overlap == path.Size())
-                return 0;
+                return {0, &other, other_range, false};
             overlap = std::min(overlap, other_range.start_pos);
         }
 
@@ -79,36 +126,62 @@ class OverlapRemover {
             overlap = std::min(overlap, other.Size() - other_range.end_pos);
         }
 
-        DEBUG("First " << overlap << " edges of the path will be removed");
-        DEBUG(path.str());
-        DEBUG("Due to overlap with path");
-        DEBUG(other.str());
-        DEBUG("Range " << other_range);
-
-        return overlap;
+        return {overlap, &other, other_range, check_added};
     }
 
-    void MarkStartOverlaps(const BidirectionalPath &path, bool end_start_only, bool retain_one_copy) {
-        std::set<size_t> overlap_poss;
-        for (PathPtr candidate : helper_.FindCandidatePaths(path)) {
-            size_t overlap = AnalyzeOverlaps(path, *candidate,
-                                             end_start_only, retain_one_copy);
-            if (overlap > 0) {
-                overlap_poss.insert(overlap);
+    std::vector<StartOverlap> FindStartOverlaps(const BidirectionalPath &path, const CoverageSnapshot &index,
+                                                bool end_start_only, bool retain_one_copy) const {
+        std::vector<StartOverlap> answer;
+        for (PathPtr candidate : helper_.FindCandidatePaths(path, index)) {
+            StartOverlap overlap = AnalyzeOverlaps(path, *candidate,
+                                                   end_start_only, retain_one_copy);
+            if (overlap.overlap > 0) {
+                answer.push_back(overlap);
             }
         }
+        return answer;
+    }
+
+    void MarkStartOverlaps(const BidirectionalPath &path, const std::vector<StartOverlap> &overlaps) {
+        std::vector<size_t> overlap_poss;
+        for (const auto &overlap : overlaps) {
+            if (overlap.check_added &&
+                AlreadyAdded(*overlap.other, overlap.other_range.start_pos, overlap.other_range.end_pos))
+                continue;
+
+            DEBUG("First " << overlap.overlap << " edges of the path will be removed");
+            DEBUG(path.str());
+            DEBUG("Due to overlap with path");
+            DEBUG(overlap.other->str());
+            DEBUG("Range " << overlap.other_range);
+            overlap_poss.push_back(overlap.overlap);
+        }
         if (!overlap_poss.empty()) {
-            utils::insert_all(splits_[&path], overlap_poss);
+            AddSplits(splits_[&path], overlap_poss);
         }
     }
 
+    //Overlaps are searched in parallel, while marking is performed in the order of the container,
+    //since whether the overlap is retained depends on the splits marked before.
     void InnerMarkOverlaps(bool end_start_only, bool retain_one_copy) {
+        std::vector<PathPtr> to_process;
         for (auto path_pair: paths_) {
             //TODO think if this "optimization" is necessary
             if (path_pair.first->Size() == 0)
                 continue;
-            MarkStartOverlaps(*path_pair.first, end_start_only, retain_one_copy);
-            MarkStartOverlaps(*path_pair.second, end_start_only, retain_one_copy);
+            to_process.push_back(path_pair.first);
+            to_process.push_back(path_pair.second);
+        }
+
+        CoverageSnapshot index(coverage_map_);
+        std::vector<std::vector<StartOverlap>> overlaps(to_process.size());
+        #pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < to_process.size(); ++i) {
+            overlaps[i] = FindStartOverlaps(*to_process[i], index, end_start_only, retain_one_copy);
+        }
+
+        for (size_t i = 0; i < to_process.size(); ++i) {
+            MarkStartOverlaps(*to_process[i], overlaps[i]);
         }
     }
 
@@ -119,6 +192,7 @@ public:
                          size_t min_edge_len,// = 0,
                          size_t max_diff) :// = 0) :
             paths_(paths),
+            coverage_map_(coverage_map),
             helper_(g, coverage_map,
                     min_edge_len, max_diff) {
     }
@@ -148,32 +222,31 @@ class PathSplitter {
     PathContainer &paths_;
     GraphCoverageMap &coverage_map_;
 
-    std::set<size_t> TransformConjSplits(PathPtr p) const {
-        std::set<size_t> path_splits;
+    std::vector<size_t> TransformConjSplits(PathPtr p) const {
+        std::vector<size_t> path_splits;
         size_t path_len = p->Size();
         auto it = splits_.find(p);
         if (it != splits_.end()) {
-//                std::transform(it->second.begin(), it->second.end(),
-//                               std::inserter(path_splits, path_splits.end()),
-//                               [=] (size_t pos) {return path_len - pos;});
             for (size_t pos : it->second) {
-                path_splits.insert(path_len - pos);
+                path_splits.push_back(path_len - pos);
             }
         }
         return path_splits;
     }
 
-    std::set<size_t> GatherAllSplits(const PathPair &pp) const {
+    std::vector<size_t> GatherAllSplits(const PathPair &pp) const {
         VERIFY(pp.first->Size() == pp.second->Size());
-        std::set<size_t> path_splits = TransformConjSplits(pp.second);
+        std::vector<size_t> path_splits = TransformConjSplits(pp.second);
         auto it = splits_.find(pp.first);
         if (it != splits_.end()) {
-            utils::insert_all(path_splits, it->second);
+            path_splits.insert(path_splits.end(), it->second.begin(), it->second.end());
         }
+        std::sort(path_splits.begin(), path_splits.end());
+        path_splits.erase(std::unique(path_splits.begin(), path_splits.end()), path_splits.end());
         return path_splits;
     }
 
-    void SplitPath(BidirectionalPath * const p, const std::set<size_t> &path_splits) {
+    void SplitPath(BidirectionalPath * const p, const std::vector<size_t> &path_splits) {
         size_t start_pos = 0;
         for (size_t split_pos : path_splits) {
             if (split_pos == 0)
@@ -207,21 +280,24 @@ private:
 
 class PathDeduplicator {
     PathContainer &paths_;
+    const GraphCoverageMap &coverage_map_;
     const bool equal_only_;
     const OverlapFindingHelper helper_;
 
-    bool IsRedundant(PathPtr path) const {
+    //Returns all the candidates making the path redundant
+    std::vector<PathPtr> FindCovering(PathPtr path, const CoverageSnapshot &index) const {
         TRACE("Checking if path redundant " << path->GetId());
-        for (auto candidate : helper_.FindCandidatePaths(*path)) {
+        std::vector<PathPtr> answer;
+        for (auto candidate : helper_.FindCandidatePaths(*path, index)) {
             TRACE("Considering candidate " << candidate->GetId());
 //                VERIFY(candidate != path && candidate != path->GetConjPath());
             if (candidate == path || candidate == path->GetConjPath())
                 continue;
             if (equal_only_ ? helper_.IsEqual(*path, *candidate) : helper_.IsSubpath(*path, *candidate)) {
-                return true;
+                answer.push_back(candidate);
             }
         }
-        return false;
+        return answer;
     }
 
 public:
@@ -233,14 +309,25 @@ public:
                      size_t max_diff,
                      bool equal_only) :
             paths_(paths),
+            coverage_map_(coverage_map),
             equal_only_(equal_only),
             helper_(g, coverage_map, min_edge_len, max_diff) {}
 
+    //Covering paths are searched in parallel. Paths are then cleared in the order of the container:
+    //path is redundant if any of its covering paths has not been cleared before.
     //TODO use path container filtering?
     void Deduplicate() {
-        for (auto path_pair : paths_) {
-            auto path = path_pair.first;
-            if (IsRedundant(path)) {
+        CoverageSnapshot index(coverage_map_);
+        std::vector<std::vector<PathPtr>> covering(paths_.size());
+        #pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < paths_.size(); ++i) {
+            covering[i] = FindCovering(paths_.Get(i), index);
+        }
+
+        for (size_t i = 0; i < paths_.size(); ++i) {
+            auto path = paths_.Get(i);
+            if (std::any_of(covering[i].begin(), covering[i].end(),
+                            [](PathPtr p) { return !p->Empty(); })) {
                 TRACE("Clearing path " << path->str());
                 path->Clear();
             }
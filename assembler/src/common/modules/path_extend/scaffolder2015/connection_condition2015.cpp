@@ -232,13 +232,17 @@ AssemblyGraphConnectionCondition::AssemblyGraphConnectionCondition(const debruij
 Connections AssemblyGraphConnectionCondition::ConnectedWith(debruijn_graph::EdgeId e) const {
     VERIFY_MSG(interesting_edge_set_.find(e) != interesting_edge_set_.end(),
                " edge "<< e.int_id() << " not applicable for connection condition");
-    if (stored_distances_.find(e) != stored_distances_.end()) {
-        return stored_distances_[e];
+    {
+        std::lock_guard<std::mutex> lock(stored_distances_mutex_);
+        auto it = stored_distances_.find(e);
+        if (it != stored_distances_.end()) {
+            return it->second;
+        }
     }
-    stored_distances_.emplace(e, Connections());
+    Connections result;
     for (auto connected: g_.OutgoingEdges(g_.EdgeEnd(e))) {
         if (interesting_edge_set_.find(connected) != interesting_edge_set_.end()) {
-            stored_distances_[e].emplace(connected, 1);
+            result.emplace(connected, 1);
         }
     }
     auto dijkstra = DijkstraHelper<debruijn_graph::Graph>::CreateBoundedDijkstra(g_, max_connection_length_);
@@ -246,11 +250,13 @@ Connections AssemblyGraphConnectionCondition::ConnectedWith(debruijn_graph::Edge
     for (auto v: dijkstra.ReachedVertices()) {
         for (auto connected: g_.OutgoingEdges(v)) {
             if (interesting_edge_set_.find(connected) != interesting_edge_set_.end() && dijkstra.GetDistance(v) < max_connection_length_) {
-                stored_distances_[e].emplace(connected, 1);
+                result.emplace(connected, 1);
             }
         }
     }
-    return stored_distances_[e];
+    std::lock_guard<std::mutex> lock(stored_distances_mutex_);
+    stored_distances_.emplace(e, result);
+    return result;
 }
 void AssemblyGraphConnectionCondition::AddInterestingEdges(func::TypedPredicate<typename Graph::EdgeId> edge_condition) {
     for (auto e_iter = g_.ConstEdgeBegin(); !e_iter.IsEnd(); ++e_iter) {
@@ -8,6 +8,7 @@
 #include "assembly_graph/graph_support/basic_edge_conditions.hpp"
 #include <map>
 #include <set>
+#include <mutex>
 
 namespace path_extend {
 
@@ -134,7 +135,9 @@ protected:
 //Maximal gap to the connection.
     size_t max_connection_length_;
     EdgeSet interesting_edge_set_;
+    //ConnectedWith could be called concurrently
     mutable std::map<EdgeId, Connections> stored_distances_;
+    mutable std::mutex stored_distances_mutex_;
 public:
     AssemblyGraphConnectionCondition(const Graph &g, size_t max_connection_length,
                                      const ScaffoldingUniqueEdgeStorage &unique_edges);
@@ -6,6 +6,8 @@
 
 #include "path_polisher.hpp"
 
+#include "utils/parallel/openmp_wrapper.h"
+
 namespace path_extend {
 
 void PathPolisher::InfoAboutGaps(const PathContainer & result){
@@ -21,10 +23,22 @@ void PathPolisher::InfoAboutGaps(const PathContainer & result){
 }
 
 PathContainer PathPolisher::PolishPaths(const PathContainer &paths) {
+    bool parallel = std::all_of(gap_closers_.begin(), gap_closers_.end(),
+                                [](const std::shared_ptr<PathGapCloser> &closer) { return closer->IsThreadSafe(); });
+    DEBUG("Polishing " << paths.size() << " paths" << (parallel ? " in parallel" : ""));
+
+    //Paths are polished independently, results are stored in the original order
+    std::vector<std::unique_ptr<BidirectionalPath>> polished(paths.size());
+    #pragma omp parallel for schedule(dynamic) if(parallel)
+    for (size_t i = 0; i < paths.size(); ++i) {
+        BidirectionalPath path = Polish(*paths.Get(i));
+        polished[i].reset(new BidirectionalPath(Polish(path.Conjugate())));
+    }
+
+    //Resulting paths are created sequentially to keep their ids deterministic
     PathContainer result;
-    for (const auto& path_pair : paths) {
-        BidirectionalPath path = Polish(*path_pair.first);
-        BidirectionalPath *conjugate_path = new BidirectionalPath(Polish(path.Conjugate()));
+    for (const auto &conjugate_polished : polished) {
+        BidirectionalPath *conjugate_path = new BidirectionalPath(*conjugate_polished);
         BidirectionalPath *re_path = new BidirectionalPath(conjugate_path->Conjugate());
         result.AddPair(re_path, conjugate_path);
     }
@@ -70,6 +84,18 @@ BidirectionalPath PathPolisher::Polish(const BidirectionalPath &init_path) {
     return *path;
 }
 
+const std::vector<std::vector<EdgeId>> &PathGapCloser::FindPaths(VertexId start, VertexId end,
+                                                                  int &error_code) const {
+    auto &workspace = workspaces_[omp_get_thread_num()];
+    if (!workspace)
+        workspace.reset(new SearchWorkspace(g_, max_path_len_));
+
+    workspace->paths.Clear();
+    workspace->processor.Reset(start);
+    error_code = workspace->processor.Process(end, 0, max_path_len_, workspace->paths);
+    return workspace->paths.paths();
+}
+
 BidirectionalPath PathGapCloser::CloseGaps(const BidirectionalPath &path) const {
     BidirectionalPath result(g_);
     if (path.Empty())
@@ -93,27 +119,23 @@ BidirectionalPath PathGapCloser::CloseGaps(const BidirectionalPath &path) const
 Gap DijkstraGapCloser::CloseGap(EdgeId target_edge, const Gap &orig_gap, BidirectionalPath &result) const {
     VertexId target_vertex = g_.EdgeStart(target_edge);
 //TODO:: actually we do not need paths, only edges..
-    omnigraph::PathStorageCallback<Graph> path_storage(g_);
-    int process_res = omnigraph::ProcessPaths(g_, 0,
-                            max_path_len_,
-                            g_.EdgeEnd(result.Back()),
-                            target_vertex,
-                            path_storage);
-    if (path_storage.size() == 0 || process_res != 0) {
+    int process_res = 0;
+    const PathsT &paths = FindPaths(g_.EdgeEnd(result.Back()), target_vertex, process_res);
+    if (paths.size() == 0 || process_res != 0) {
 //No paths found or path_processor error(in particular too many vertices in Dijkstra), keeping the gap
         DEBUG("PathProcessor nonzero exit code, gap left unchanged");
         return orig_gap;
-    } else if (path_storage.size() > 1) {
+    } else if (paths.size() > 1) {
 //More than one result, using shortest result for gap length estimation
 //We cannot use both common paths and bridges in one attempt;
-        Gap gap = FillWithMultiplePaths(path_storage.paths(), result);
+        Gap gap = FillWithMultiplePaths(paths, result);
         if (gap == Gap::INVALID())
-            gap = FillWithBridge(orig_gap, path_storage.paths(), result);
+            gap = FillWithBridge(orig_gap, paths, result);
         return gap;
     } else {
 //Closing the gap with the unique shortest result
         DEBUG("Unique path gap closing:");
-        for (EdgeId e : path_storage.paths().front()) {
+        for (EdgeId e : paths.front()) {
             DEBUG(e.int_id());
             result.PushBack(e);
         }
@@ -193,15 +215,26 @@ Gap DijkstraGapCloser::FillWithMultiplePaths(const PathsT& paths,
         return Gap::INVALID();
 }
 
-std::map<EdgeId, size_t> DijkstraGapCloser::CountEdgesQuantity(const PathsT &paths, size_t length_limit) const {
-    std::map<EdgeId, size_t> res;
+std::vector<std::pair<EdgeId, size_t>> DijkstraGapCloser::CountEdgesQuantity(const PathsT &paths,
+                                                                               size_t length_limit) const {
+    std::vector<EdgeId> edges;
     for (const auto& path: paths) {
-        std::set<EdgeId> edge_set(path.begin(), path.end());
-        for (const auto& e: edge_set) {
-            if (g_.length(e) >= length_limit) {
-                res[e] += 1;
-            }
+        size_t path_start = edges.size();
+        for (EdgeId e : path) {
+            if (g_.length(e) >= length_limit)
+                edges.push_back(e);
         }
+        //every path is counted once for an edge
+        std::sort(edges.begin() + path_start, edges.end());
+        edges.erase(std::unique(edges.begin() + path_start, edges.end()), edges.end());
+    }
+    std::sort(edges.begin(), edges.end());
+
+    std::vector<std::pair<EdgeId, size_t>> res;
+    for (EdgeId e : edges) {
+        if (res.empty() || res.back().first != e)
+            res.emplace_back(e, 0);
+        res.back().second += 1;
     }
     return res;
 };
@@ -239,13 +272,13 @@ std::vector<EdgeId> DijkstraGapCloser::LCP(const PathsT& paths) const {
 }
 
 EdgeId MatePairGapCloser::FindNext(const BidirectionalPath& path,
-                                   const std::set<EdgeId> &present_in_paths,
+                                   const std::vector<EdgeId> &present_in_paths,
                                    VertexId last_v, EdgeId target_edge) const {
     auto next_edges = g_.OutgoingEdges(last_v);
     std::map<EdgeId, double> candidates;
 
     for (const auto edge: next_edges)
-        if (present_in_paths.find(edge) != present_in_paths.end())
+        if (std::binary_search(present_in_paths.begin(), present_in_paths.end(), edge))
             candidates.emplace(edge, 0);
 
     if (candidates.size() <= 1) {
@@ -294,20 +327,17 @@ Gap MatePairGapCloser::CloseGap(EdgeId target_edge, const Gap &orig_gap, Bidirec
         VertexId last_v = g_.EdgeEnd(last_e);
         DEBUG("Closing gap with mate pairs between edge " << g_.int_id(last_e)
                   << " and edge " << g_.int_id(target_edge) << " was " << orig_gap);
-        omnigraph::PathStorageCallback<Graph> path_storage(g_);
-        int process_res = omnigraph::ProcessPaths(g_, 0,
-                                max_path_len_,
-                                last_v,
-                                target_vertex,
-                                path_storage);
+        int process_res = 0;
+        const auto &paths = FindPaths(last_v, target_vertex, process_res);
         if (process_res != 0) {
             DEBUG("PathProcessor nonzero exit code, gap left unchanged");
             return orig_gap;
         }
-        std::set<EdgeId> present_in_paths;
-        for (const auto &p: path_storage.paths())
-            for (EdgeId e : p)
-                present_in_paths.insert(e);
+        std::vector<EdgeId> present_in_paths;
+        for (const auto &p: paths)
+            present_in_paths.insert(present_in_paths.end(), p.begin(), p.end());
+        std::sort(present_in_paths.begin(), present_in_paths.end());
+        present_in_paths.erase(std::unique(present_in_paths.begin(), present_in_paths.end()), present_in_paths.end());
 
         size_t total = 0;
         while (last_e != EdgeId()) {
@@ -14,22 +14,43 @@
 #include "modules/path_extend/path_extender.hpp"
 #include "assembly_graph/graph_support/scaff_supplementary.hpp"
 #include "pipeline/graph_pack.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
 namespace path_extend {
 
 class PathGapCloser {
+    //Path search state of a single thread, reused between gaps
+    struct SearchWorkspace {
+        omnigraph::PathProcessor<Graph> processor;
+        omnigraph::PathStorageCallback<Graph> paths;
+
+        SearchWorkspace(const Graph &g, size_t max_path_len):
+                processor(g, max_path_len), paths(g) {}
+    };
+
+    mutable std::vector<std::unique_ptr<SearchWorkspace>> workspaces_;
+
 protected:
     const Graph& g_;
     const size_t max_path_len_;
     const int min_gap_;
 
+    //All paths from start to end not longer than max_path_len_, valid until the next search in the same thread
+    const std::vector<std::vector<EdgeId>> &FindPaths(VertexId start, VertexId end, int &error_code) const;
+
     virtual Gap CloseGap(const BidirectionalPath &original_path, size_t position,
                          BidirectionalPath &path) const = 0;
     DECL_LOGGER("PathGapCloser")
 public:
     BidirectionalPath CloseGaps(const BidirectionalPath &path) const;
 
+    //Whether gaps of different paths could be closed concurrently
+    virtual bool IsThreadSafe() const {
+        return true;
+    }
+
     PathGapCloser(const Graph& g, size_t max_path_len):
+                  workspaces_(omp_get_max_threads()),
                   g_(g),
                   max_path_len_(max_path_len),
                   //TODO:: config
@@ -66,6 +87,11 @@ public:
             TargetEdgeGapCloser(g, max_path_len), extender_(extender) {
         DEBUG("ext added");
     }
+
+    //Extenders are stateful
+    bool IsThreadSafe() const override {
+        return false;
+    }
 };
 
 class MatePairGapCloser: public TargetEdgeGapCloser {
@@ -74,8 +100,9 @@ class MatePairGapCloser: public TargetEdgeGapCloser {
 //TODO: config? somewhere else?
     static constexpr double weight_priority = 5;
 
+    //present_in_paths should be sorted
     EdgeId FindNext(const BidirectionalPath &path,
-                    const std::set<EdgeId> &present_in_paths,
+                    const std::vector<EdgeId> &present_in_paths,
                     VertexId last_v, EdgeId target_edge) const;
 protected:
     Gap CloseGap(EdgeId target_edge, const Gap &gap, BidirectionalPath &path) const override;
@@ -105,7 +132,8 @@ class DijkstraGapCloser: public TargetEdgeGapCloser {
 
     std::vector<EdgeId> LCP(const PathsT& paths) const;
 
-    std::map<EdgeId, size_t> CountEdgesQuantity(const PathsT& paths, size_t length_limit) const;
+    //Returns number of paths containing every long enough edge, sorted by edge
+    std::vector<std::pair<EdgeId, size_t>> CountEdgesQuantity(const PathsT& paths, size_t length_limit) const;
 
 protected:
     Gap CloseGap(EdgeId target_edge, const Gap &gap, BidirectionalPath &path) const override;
@@ -8,32 +8,41 @@ std::atomic<ScaffoldGraph::ScaffoldEdgeIdT> ScaffoldGraph::ScaffoldEdge::scaffol
 
 void ScaffoldGraph::AddEdgeSimple(const ScaffoldGraph::ScaffoldEdge &e) {
     edges_.emplace(e.getId(), e);
-    outgoing_edges_.emplace(e.getStart(), e.getId());
-    incoming_edges_.emplace(e.getEnd(), e.getId());
+    outgoing_edges_[e.getStart()].push_back(e.getId());
+    incoming_edges_[e.getEnd()].push_back(e.getId());
+}
+
+const std::vector<ScaffoldGraph::ScaffoldEdgeIdT> &ScaffoldGraph::AdjacentEdges(const AdjacencyStorage &storage,
+                                                                               ScaffoldGraph::ScaffoldVertex v) const {
+    static const std::vector<ScaffoldEdgeIdT> empty;
+    auto it = storage.find(v);
+    return it == storage.end() ? empty : it->second;
+}
+
+void ScaffoldGraph::DeleteAdjacent(AdjacencyStorage &storage, ScaffoldGraph::ScaffoldVertex v,
+                                   const ScaffoldGraph::ScaffoldEdge &e) {
+    auto it = storage.find(v);
+    if (it == storage.end())
+        return;
+    auto &edge_ids = it->second;
+    edge_ids.erase(std::remove_if(edge_ids.begin(), edge_ids.end(),
+                                  [&](ScaffoldEdgeIdT id) { return edges_.at(id) == e; }),
+                   edge_ids.end());
+    if (edge_ids.empty())
+        storage.erase(it);
 }
 
 void ScaffoldGraph::DeleteOutgoing(const ScaffoldGraph::ScaffoldEdge &e) {
-    auto e_range = outgoing_edges_.equal_range(e.getStart());
-    for (auto edge_id = e_range.first; edge_id != e_range.second; ++edge_id) {
-        if (edges_.at(edge_id->second) == e) {
-            outgoing_edges_.erase(edge_id);
-        }
-    }
+    DeleteAdjacent(outgoing_edges_, e.getStart(), e);
 }
 
 void ScaffoldGraph::DeleteIncoming(const ScaffoldGraph::ScaffoldEdge &e) {
-    auto e_range = incoming_edges_.equal_range(e.getEnd());
-    for (auto edge_id = e_range.first; edge_id != e_range.second; ++edge_id) {
-        if (edges_.at(edge_id->second) == e) {
-            incoming_edges_.erase(edge_id);
-        }
-    }
+    DeleteAdjacent(incoming_edges_, e.getEnd(), e);
 }
 
 void ScaffoldGraph::DeleteAllOutgoingEdgesSimple(ScaffoldGraph::ScaffoldVertex v) {
-    auto e_range = outgoing_edges_.equal_range(v);
-    for (auto edge_id = e_range.first; edge_id != e_range.second; ++edge_id) {
-        DeleteIncoming(edges_.at(edge_id->second));
+    for (ScaffoldEdgeIdT edge_id : AdjacentEdges(outgoing_edges_, v)) {
+        DeleteIncoming(edges_.at(edge_id));
     }
     outgoing_edges_.erase(v);
 }
@@ -44,9 +53,8 @@ void ScaffoldGraph::DeleteEdgeFromStorage(const ScaffoldGraph::ScaffoldEdge &e)
 }
 
 void ScaffoldGraph::DeleteAllIncomingEdgesSimple(ScaffoldGraph::ScaffoldVertex v) {
-    auto e_range = incoming_edges_.equal_range(v);
-    for (auto edge_id = e_range.first; edge_id != e_range.second; ++edge_id) {
-        DeleteOutgoing(edges_.at(edge_id->second));
+    for (ScaffoldEdgeIdT edge_id : AdjacentEdges(incoming_edges_, v)) {
+        DeleteOutgoing(edges_.at(edge_id));
     }
     incoming_edges_.erase(v);
 }
@@ -56,9 +64,8 @@ bool ScaffoldGraph::Exists(ScaffoldGraph::ScaffoldVertex assembly_graph_edge) co
 }
 
 bool ScaffoldGraph::Exists(const ScaffoldGraph::ScaffoldEdge &e) const {
-    auto e_range = outgoing_edges_.equal_range(e.getStart());
-    for (auto edge_id = e_range.first; edge_id != e_range.second; ++edge_id) {
-        if (edges_.at(edge_id->second) == e) {
+    for (ScaffoldEdgeIdT edge_id : AdjacentEdges(outgoing_edges_, e.getStart())) {
+        if (edges_.at(edge_id) == e) {
             return true;
         }
     }
@@ -117,12 +124,12 @@ void ScaffoldGraph::Print(std::ostream &os) const {
 
 ScaffoldGraph::ScaffoldEdge ScaffoldGraph::UniqueIncoming(ScaffoldGraph::ScaffoldVertex assembly_graph_edge) const {
     VERIFY(HasUniqueIncoming(assembly_graph_edge));
-    return edges_.at(incoming_edges_.find(assembly_graph_edge)->second);
+    return edges_.at(AdjacentEdges(incoming_edges_, assembly_graph_edge).front());
 }
 
 ScaffoldGraph::ScaffoldEdge ScaffoldGraph::UniqueOutgoing(ScaffoldGraph::ScaffoldVertex assembly_graph_edge) const {
     VERIFY(HasUniqueOutgoing(assembly_graph_edge));
-    return edges_.at(outgoing_edges_.find(assembly_graph_edge)->second);
+    return edges_.at(AdjacentEdges(outgoing_edges_, assembly_graph_edge).front());
 }
 
 bool ScaffoldGraph::HasUniqueIncoming(ScaffoldGraph::ScaffoldVertex assembly_graph_edge) const {
@@ -134,27 +141,25 @@ bool ScaffoldGraph::HasUniqueOutgoing(ScaffoldGraph::ScaffoldVertex assembly_gra
 }
 
 size_t ScaffoldGraph::IncomingEdgeCount(ScaffoldGraph::ScaffoldVertex assembly_graph_edge) const {
-    return incoming_edges_.count(assembly_graph_edge);
+    return AdjacentEdges(incoming_edges_, assembly_graph_edge).size();
 }
 
 size_t ScaffoldGraph::OutgoingEdgeCount(ScaffoldGraph::ScaffoldVertex assembly_graph_edge) const {
-    return outgoing_edges_.count(assembly_graph_edge);
+    return AdjacentEdges(outgoing_edges_, assembly_graph_edge).size();
 }
 
 std::vector<ScaffoldGraph::ScaffoldEdge> ScaffoldGraph::IncomingEdges(ScaffoldGraph::ScaffoldVertex assembly_graph_edge) const {
     std::vector<ScaffoldEdge> result;
-    auto e_range = incoming_edges_.equal_range(assembly_graph_edge);
-    for (auto edge_id = e_range.first; edge_id != e_range.second; ++edge_id) {
-        result.push_back(edges_.at(edge_id->second));
+    for (ScaffoldEdgeIdT edge_id : AdjacentEdges(incoming_edges_, assembly_graph_edge)) {
+        result.push_back(edges_.at(edge_id));
     }
     return result;
 }
 
 std::vector<ScaffoldGraph::ScaffoldEdge> ScaffoldGraph::OutgoingEdges(ScaffoldGraph::ScaffoldVertex assembly_graph_edge) const {
     std::vector<ScaffoldEdge> result;
-    auto e_range = outgoing_edges_.equal_range(assembly_graph_edge);
-    for (auto edge_id = e_range.first; edge_id != e_range.second; ++edge_id) {
-        result.push_back(edges_.at(edge_id->second));
+    for (ScaffoldEdgeIdT edge_id : AdjacentEdges(outgoing_edges_, assembly_graph_edge)) {
+        result.push_back(edges_.at(edge_id));
     }
     return result;
 }
@@ -212,7 +217,7 @@ adt::iterator_range<ScaffoldGraph::ConstScaffoldEdgeIterator> ScaffoldGraph::edg
 }
 
 bool ScaffoldGraph::IsVertexIsolated(ScaffoldGraph::ScaffoldVertex assembly_graph_edge) const {
-    bool result = incoming_edges_.count(assembly_graph_edge) == 0 && outgoing_edges_.count(assembly_graph_edge) == 0;
+    bool result = IncomingEdgeCount(assembly_graph_edge) == 0 && OutgoingEdgeCount(assembly_graph_edge) == 0;
     return result;
 }
 
@@ -225,10 +230,10 @@ bool ScaffoldGraph::RemoveVertex(ScaffoldGraph::ScaffoldVertex assembly_graph_ed
         DeleteAllOutgoingEdgesSimple(conjugate(assembly_graph_edge));
         DeleteAllIncomingEdgesSimple(conjugate(assembly_graph_edge));
 
-        VERIFY(incoming_edges_.count(assembly_graph_edge) == 0);
-        VERIFY(outgoing_edges_.count(assembly_graph_edge) == 0);
-        VERIFY(incoming_edges_.count(conjugate(assembly_graph_edge)) == 0);
-        VERIFY(outgoing_edges_.count(conjugate(assembly_graph_edge)) == 0);
+        VERIFY(IncomingEdgeCount(assembly_graph_edge) == 0);
+        VERIFY(OutgoingEdgeCount(assembly_graph_edge) == 0);
+        VERIFY(IncomingEdgeCount(conjugate(assembly_graph_edge)) == 0);
+        VERIFY(OutgoingEdgeCount(conjugate(assembly_graph_edge)) == 0);
 
         vertices_.erase(assembly_graph_edge);
         vertices_.erase(conjugate(assembly_graph_edge));
@@ -85,8 +85,8 @@ public:
     typedef std::set<ScaffoldVertex> VertexStorage;
     //Edges are stored in map: Id -> Edge Information
     typedef std::unordered_map<ScaffoldEdgeIdT, ScaffoldEdge> EdgeStorage;
-    //Adjacency list contains vertrx and edge id (instead of whole edge information)
-    typedef std::unordered_multimap<ScaffoldVertex, ScaffoldEdgeIdT> AdjacencyStorage;
+    //Adjacency list contains vertex and ids of its edges (instead of whole edge information), stored contiguously
+    typedef std::unordered_map<ScaffoldVertex, std::vector<ScaffoldEdgeIdT>> AdjacencyStorage;
 
     struct ConstScaffoldEdgeIterator: public boost::iterator_facade<ConstScaffoldEdgeIterator,
                                                                     const ScaffoldEdge,
@@ -128,6 +128,12 @@ private:
 
     void AddEdgeSimple(const ScaffoldEdge &e);
 
+    //Ids of edges adjacent to v, empty if there are none
+    const std::vector<ScaffoldEdgeIdT> &AdjacentEdges(const AdjacencyStorage &storage, ScaffoldVertex v) const;
+
+    //Delete edge from the adjacency list of v without checks
+    void DeleteAdjacent(AdjacencyStorage &storage, ScaffoldVertex v, const ScaffoldEdge &e);
+
     //Delete outgoing edge from adjancecy list without checks
     void DeleteOutgoing(const ScaffoldEdge &e);
 
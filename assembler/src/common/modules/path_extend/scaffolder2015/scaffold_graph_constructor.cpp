@@ -4,6 +4,8 @@
 
 #include "scaffold_graph_constructor.hpp"
 
+#include "utils/parallel/openmp_wrapper.h"
+
 namespace path_extend {
 
 namespace scaffold_graph {
@@ -39,14 +41,27 @@ void BaseScaffoldGraphConstructor::ConstructFromConditions(ConnectionConditions
 
 void BaseScaffoldGraphConstructor::ConstructFromSingleCondition(const std::shared_ptr<ConnectionCondition> condition,
                                                                 bool use_terminal_vertices_only) {
-    for (const auto& v : graph_->vertices()) {
+    std::vector<ScaffoldGraph::ScaffoldVertex> vertices(graph_->vbegin(), graph_->vend());
+
+    //Connections are found in parallel, outgoing edges of a vertex are added only when it is processed,
+    //so the terminal vertex check below gives the same result here
+    std::vector<Connections> connections(vertices.size());
+    #pragma omp parallel for schedule(guided)
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        if (use_terminal_vertices_only && graph_->OutgoingEdgeCount(vertices[i]) > 0)
+            continue;
+        connections[i] = condition->ConnectedWith(vertices[i]);
+    }
+
+    //Edges are added in the order of vertices, since incoming edges check depends on the edges added before
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        auto v = vertices[i];
         TRACE("Vertex " << graph_->int_id(v));
 
         if (use_terminal_vertices_only && graph_->OutgoingEdgeCount(v) > 0)
             continue;
 
-        auto connected_with = condition->ConnectedWith(v);
-        for (const auto& pair : connected_with) {
+        for (const auto& pair : connections[i]) {
             EdgeId connected = pair.first;
             double w = pair.second;
             TRACE("Connected with " << graph_->int_id(connected));
@@ -56,6 +71,7 @@ void BaseScaffoldGraphConstructor::ConstructFromSingleCondition(const std::share
                 graph_->AddEdge(v, connected, condition->GetLibIndex(), w);
             }
         }
+        Connections().swap(connections[i]);
     }
 }
 
@@ -15,6 +15,9 @@
 #include "visualization/visualization.hpp"
 #include "dominated_set_finder.hpp"
 #include "assembly_graph/graph_support/parallel_processing.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+
+#include <parallel_hashmap/phmap.h>
 
 #include <cmath>
 #include <stack>
@@ -25,17 +28,18 @@ namespace omnigraph {
 namespace complex_br {
 
 template<class Graph>
-class LocalizedComponent: public GraphActionHandler<Graph> /*: public GraphComponent<Graph>*/{
-    typedef GraphActionHandler<Graph> base;
+class LocalizedComponent {
     typedef typename Graph::VertexId VertexId;
     typedef typename Graph::EdgeId EdgeId;
 
     const Graph& g_;
     VertexId start_vertex_;
-    std::set<VertexId> end_vertices_;
+    //sorted
+    std::vector<VertexId> end_vertices_;
     //usage of inclusive-inclusive range!!!
-    std::map<VertexId, Range> vertex_depth_;
-    std::multimap<size_t, VertexId> height_2_vertices_;
+    phmap::flat_hash_map<VertexId, Range> vertex_depth_;
+    //sorted by (average height, vertex)
+    std::vector<std::pair<size_t, VertexId>> height_2_vertices_;
 
     bool AllEdgeOut(VertexId v) const {
         for (EdgeId e : g_.OutgoingEdges(v)) {
@@ -57,15 +61,39 @@ class LocalizedComponent: public GraphActionHandler<Graph> /*: public GraphCompo
         return r.start_pos;
     }
 
+    void InsertEndVertex(VertexId v) {
+        auto it = std::lower_bound(end_vertices_.begin(), end_vertices_.end(), v);
+        if (it == end_vertices_.end() || *it != v)
+            end_vertices_.insert(it, v);
+    }
+
+    void EraseEndVertex(VertexId v) {
+        auto it = std::lower_bound(end_vertices_.begin(), end_vertices_.end(), v);
+        if (it != end_vertices_.end() && *it == v)
+            end_vertices_.erase(it);
+    }
+
+    void InsertVertex(VertexId v, Range dist_range) {
+        vertex_depth_.emplace(v, dist_range);
+        auto h_v = std::make_pair(Average(dist_range), v);
+        height_2_vertices_.insert(std::upper_bound(height_2_vertices_.begin(), height_2_vertices_.end(), h_v), h_v);
+    }
+
 public:
 
-//    template <class It>
-    LocalizedComponent(const Graph& g, //It begin, It end,
-            VertexId start_vertex/*, const vector<VertexId>& end_vertices*/) :
-            base(g, "br_component"), g_(g), start_vertex_(start_vertex) {
-        end_vertices_.insert(start_vertex);
-        vertex_depth_.emplace(start_vertex_, Range(0, 0));
-        height_2_vertices_.emplace(0, start_vertex);
+    LocalizedComponent(const Graph& g, VertexId start_vertex) :
+            g_(g) {
+        Reset(start_vertex);
+    }
+
+    //keeps the allocated memory, so the component could be reused for another start vertex
+    void Reset(VertexId start_vertex) {
+        start_vertex_ = start_vertex;
+        end_vertices_.clear();
+        vertex_depth_.clear();
+        height_2_vertices_.clear();
+        end_vertices_.push_back(start_vertex);
+        InsertVertex(start_vertex, Range(0, 0));
     }
 
     const Graph& g() const {
@@ -81,39 +109,20 @@ public:
     }
 
     void AddVertex(VertexId v, Range dist_range) {
-//        VERIFY(CheckCloseNeighbour(v));
-//        Range r = NeighbourDistanceRange(v);
         DEBUG("Adding vertex " << g_.str(v) << " to the component");
-        vertex_depth_.emplace(v, dist_range);
-        height_2_vertices_.emplace(Average(dist_range), v);
+        InsertVertex(v, dist_range);
         DEBUG("Range " << dist_range << " Average height " << Average(dist_range));
         for (EdgeId e : g_.IncomingEdges(v)) {
-            end_vertices_.erase(g_.EdgeStart(e));
+            EraseEndVertex(g_.EdgeStart(e));
         }
         if (IsEndVertex(v)) {
-            end_vertices_.insert(v);
-        }
-    }
-
-    //todo what if path processor will fail inside
-//    size_t TotalPathCount() const {
-//        size_t answer = 0;
-//        size_t max_len = 0;
-//        for (VertexId end_v : end_vertices_) {
-//            max_len = std::max(max_len, vertex_depth_.find(end_v)->second.end_pos);
-//        }
-//        PathProcessor<Graph> processor(g_, start_vertex_, max_len);
-//        for (VertexId end_v : end_vertices_) {
-//            PathStorageCallback<Graph> path_storage(g_);
-//            Range r = vertex_depth_.find(end_v)->second;
-//            processor.Process(end_v, r.start_pos, r.end_pos, path_storage, /*max_edge_cnt*/ -1ul);
-//            answer += path_storage.size();
-//        }
-//        return answer;
-//    }
+            InsertEndVertex(v);
+        }
+    }
 
     bool CheckCompleteness() const {
-        for (VertexId v : utils::key_set(vertex_depth_)) {
+        for (const auto &v_d : vertex_depth_) {
+            VertexId v = v_d.first;
             if (v == start_vertex_)
                 continue;
             if (!AllEdgeIn(v) && !AllEdgeOut(v))
@@ -124,13 +133,12 @@ public:
 
     bool NeedsProjection() const {
         DEBUG("Checking if component needs projection");
-        for (VertexId v : utils::key_set(vertex_depth_)) {
+        for (const auto &v_d : vertex_depth_) {
+            VertexId v = v_d.first;
             if (v == start_vertex_)
                 continue;
-            std::vector<EdgeId> filtered_incoming;
-            std::copy_if(g_.in_begin(v), g_.in_end(v), std::back_inserter(filtered_incoming),
-                        [&] (EdgeId e) {return contains(g_.EdgeStart(e));});
-            VERIFY_MSG(filtered_incoming.size() == g_.IncomingEdgeCount(v), "Strange component");
+            VERIFY_MSG(std::all_of(g_.in_begin(v), g_.in_end(v),
+                                   [&] (EdgeId e) {return contains(g_.EdgeStart(e));}), "Strange component");
             if (g_.IncomingEdgeCount(v) > 1) {
                 DEBUG("Needs projection");
                 return true;
@@ -158,10 +166,12 @@ public:
         return Average(vertex_depth_.find(v)->second);
     }
 
-    std::set<size_t> avg_distances() const {
-        std::set<size_t> distances;
-        for (VertexId v : utils::key_set(vertex_depth_)) {
-            distances.insert(avg_distance(v));
+    //sorted and unique
+    std::vector<size_t> avg_distances() const {
+        std::vector<size_t> distances;
+        for (const auto &h_v : height_2_vertices_) {
+            if (distances.empty() || distances.back() != h_v.first)
+                distances.push_back(h_v.first);
         }
         return distances;
     }
@@ -174,10 +184,14 @@ public:
         return start_vertex_;
     }
 
-    const std::set<VertexId> &end_vertices() const {
+    const std::vector<VertexId> &end_vertices() const {
         return end_vertices_;
     }
 
+    bool is_end_vertex(VertexId v) const {
+        return std::binary_search(end_vertices_.begin(), end_vertices_.end(), v);
+    }
+
     bool CheckCloseNeighbour(VertexId v) const {
         DEBUG("Check if vertex " << g_.str(v) << " can be processed");
         for (EdgeId e : g_.IncomingEdges(v)) {
@@ -197,48 +211,27 @@ public:
     }
 
     bool ContainsConjugateVertices() const {
-        std::set<VertexId> conjugate_vertices;
-        for (VertexId v : utils::key_set(vertex_depth_)) {
-            if (conjugate_vertices.count(v) == 0) {
-                conjugate_vertices.insert(g_.conjugate(v));
-            } else {
+        for (const auto &v_d : vertex_depth_) {
+            VertexId v = v_d.first;
+            if (v != g_.conjugate(v) && contains(g_.conjugate(v)))
                 return true;
-            }
         }
         return false;
     }
 
-    virtual void HandleDelete(VertexId v) {
-        VERIFY(end_vertices_.count(v) == 0);
+    void HandleDelete(VertexId v) {
+        VERIFY(!is_end_vertex(v));
         if (contains(v)) {
             DEBUG("Deleting vertex " << g_.str(v) << " from the component");
-            size_t depth = avg_distance(v);
+            auto h_v = std::make_pair(avg_distance(v), v);
             vertex_depth_.erase(v);
-            for (auto it = height_2_vertices_.lower_bound(depth);
-                    it != height_2_vertices_.upper_bound(depth); ++it) {
-                if (it->second == v) {
-                    height_2_vertices_.erase(it);
-                    return;
-                }
-            }
-            VERIFY(false);
+            auto it = std::lower_bound(height_2_vertices_.begin(), height_2_vertices_.end(), h_v);
+            VERIFY(it != height_2_vertices_.end() && *it == h_v);
+            height_2_vertices_.erase(it);
         }
-
-    }
-
-    virtual void HandleDelete(EdgeId /*e*/) {
-        //empty for now
-    }
-
-    virtual void HandleMerge(const std::vector<EdgeId> & /*old_edges*/, EdgeId /*new_edge*/) {
-        VERIFY(false);
-    }
-
-    virtual void HandleGlue(EdgeId /*new_edge*/, EdgeId /*edge1*/, EdgeId /*edge2*/) {
-        //empty for now
     }
 
-    virtual void HandleSplit(EdgeId old_edge, EdgeId new_edge_1, EdgeId /*new_edge_2*/) {
+    void HandleSplit(EdgeId old_edge, EdgeId new_edge_1, EdgeId /*new_edge_2*/) {
         VERIFY(old_edge != g_.conjugate(old_edge));
         VertexId start = g_.EdgeStart(old_edge);
         VertexId end = g_.EdgeEnd(old_edge);
@@ -253,20 +246,21 @@ public:
 //                            * g_.length(new_edge_1) / g_.length(old_edge);
             DEBUG(
                     "Inserting vertex " << g_.str(new_vertex) << " to component during split");
-            vertex_depth_.emplace(new_vertex, new_vertex_depth);
-            height_2_vertices_.emplace(Average(new_vertex_depth), new_vertex);
+            InsertVertex(new_vertex, new_vertex_depth);
         }
     }
 
-    const std::multimap<size_t, VertexId> &height_2_vertices() const {
+    const std::vector<std::pair<size_t, VertexId>> &height_2_vertices() const {
         return height_2_vertices_;
     }
 
-    const std::set<VertexId> vertices_on_height(size_t height) const {
-        std::set<VertexId> answer;
-        for (auto it = height_2_vertices_.lower_bound(height);
-                it != height_2_vertices_.upper_bound(height); ++it) {
-            answer.insert(it->second);
+    //sorted
+    std::vector<VertexId> vertices_on_height(size_t height) const {
+        std::vector<VertexId> answer;
+        auto it = std::lower_bound(height_2_vertices_.begin(), height_2_vertices_.end(),
+                                   std::make_pair(height, VertexId()));
+        for (; it != height_2_vertices_.end() && it->first == height; ++it) {
+            answer.push_back(it->second);
         }
         return answer;
     }
@@ -276,55 +270,48 @@ private:
 };
 
 template<class Graph>
-class SkeletonTree: public GraphActionHandler<Graph> {
-    typedef GraphActionHandler<Graph> base;
+class SkeletonTree {
     typedef typename Graph::VertexId VertexId;
     typedef typename Graph::EdgeId EdgeId;
 
 public:
+    typedef phmap::flat_hash_set<EdgeId> EdgeSet;
 
-    const std::set<EdgeId> &edges() const {
+    const EdgeSet &edges() const {
         return edges_;
     }
 
-    const std::set<VertexId> &vertices() const {
+    const phmap::flat_hash_set<VertexId> &vertices() const {
         return vertices_;
     }
 
     bool Contains(EdgeId e) const {
-//        VertexId start = br_comp_.g().EdgeStart(e);
-//        if (next_edges_.count(start) > 0) {
-//            const vector<EdgeId> edges = next_edges_.find(start)->second;
-//            return find(e, next_edges_.lower_bound(start), next_edges_.upper_bound(start)) != edges.end();
-//        }
-//        return false;
         return edges_.count(e) > 0;
     }
 
     bool Contains(VertexId v) const {
-//        return next_edges_.count(v) > 0;
         return vertices_.count(v) > 0;
     }
 
-    void HandleDelete(VertexId v) override {
+    void HandleDelete(VertexId v) {
         //verify v not in the tree
         VERIFY(!Contains(v));
     }
 
-    void HandleDelete(EdgeId e) override {
+    void HandleDelete(EdgeId e) {
         //verify e not in the tree
         DEBUG("Trying to delete " << br_comp_.g().str(e));
         VERIFY(!Contains(e));
     }
 
-    void HandleMerge(const std::vector<EdgeId> &old_edges, EdgeId /*new_edge*/) override {
+    void HandleMerge(const std::vector<EdgeId> &old_edges, EdgeId /*new_edge*/) {
         //verify false
         for (EdgeId e : old_edges) {
             VERIFY(!Contains(e));
         }
     }
 
-    void HandleGlue(EdgeId new_edge, EdgeId edge1, EdgeId edge2) override {
+    void HandleGlue(EdgeId new_edge, EdgeId edge1, EdgeId edge2) {
 //         verify edge2 in tree
 //         put new_edge instead of edge2
         DEBUG("Glueing " << br_comp_.g().str(new_edge) << " " << br_comp_.g().str(edge1) << " " << br_comp_.g().str(edge2));
@@ -337,7 +324,7 @@ public:
     }
 
     void HandleSplit(EdgeId old_edge, EdgeId new_edge_1,
-            EdgeId new_edge_2) override {
+            EdgeId new_edge_2) {
         VERIFY(old_edge != br_comp_.g().conjugate(old_edge));
         if (Contains(old_edge)) {
             edges_.erase(old_edge);
@@ -348,8 +335,8 @@ public:
     }
 
     SkeletonTree(const LocalizedComponent<Graph> &br_comp,
-                 const std::set<EdgeId> &edges) :
-            base(br_comp.g(), "br_tree"), br_comp_(br_comp), edges_(edges) {
+                 const EdgeSet &edges) :
+            br_comp_(br_comp), edges_(edges) {
         DEBUG("Tree edges " << br_comp.g().str(edges));
         for (EdgeId e : edges_) {
             vertices_.insert(br_comp_.g().EdgeStart(e));
@@ -359,8 +346,8 @@ public:
 
 private:
     const LocalizedComponent<Graph>& br_comp_;
-    std::set<EdgeId> edges_;
-    std::set<VertexId> vertices_;
+    EdgeSet edges_;
+    phmap::flat_hash_set<VertexId> vertices_;
 
 private:
     DECL_LOGGER("SkeletonTree");
@@ -371,8 +358,7 @@ typedef mask mixed_color_t;
 typedef unsigned primitive_color_t;
 
 template<class Graph>
-class ComponentColoring: public GraphActionHandler<Graph> {
-    typedef GraphActionHandler<Graph> base;
+class ComponentColoring {
     typedef typename Graph::VertexId VertexId;
     typedef typename Graph::EdgeId EdgeId;
 
@@ -408,7 +394,7 @@ private:
 
     const LocalizedComponent<Graph>& comp_;
     const size_t color_cnt_;
-    std::map<VertexId, mixed_color_t> vertex_colors_;
+    phmap::flat_hash_map<VertexId, mixed_color_t> vertex_colors_;
 
     mixed_color_t CountVertexColor(VertexId v) const {
         mixed_color_t answer = mixed_color_t(0);
@@ -444,7 +430,7 @@ private:
 public:
 
     ComponentColoring(const LocalizedComponent<Graph>& comp) :
-            base(comp.g(), "br_comp_coloring"), comp_(comp), color_cnt_(
+            comp_(comp), color_cnt_(
                     comp_.end_vertices().size()) {
         VERIFY(comp.end_vertices().size() <= sizeof(size_t) * 8);
         ColorComponent();
@@ -465,22 +451,18 @@ public:
         return color(comp_.g().EdgeEnd(e));
     }
 
-    virtual void HandleDelete(VertexId v) {
+    void HandleDelete(VertexId v) {
         vertex_colors_.erase(v);
     }
 
-    virtual void HandleMerge(const std::vector<EdgeId> & /*old_edges*/, EdgeId /*new_edge*/) {
-        VERIFY(false);
-    }
-
-    virtual void HandleGlue(EdgeId /*new_edge*/, EdgeId edge1, EdgeId edge2) {
+    void HandleGlue(EdgeId /*new_edge*/, EdgeId edge1, EdgeId edge2) {
         if (comp_.contains(edge1)) {
             VERIFY(comp_.contains(edge2));
             VERIFY(IsSubset(color(edge2), color(edge1)));
         }
     }
 
-    virtual void HandleSplit(EdgeId old_edge, EdgeId new_edge_1,
+    void HandleSplit(EdgeId old_edge, EdgeId new_edge_1,
             EdgeId /*new_edge_2*/) {
         VERIFY(old_edge != comp_.g().conjugate(old_edge));
         if (comp_.contains(old_edge)) {
@@ -507,10 +489,10 @@ class SkeletonTreeFinder {
     int current_level_;
     color_partition_ds_t current_color_partition_;
 
-    std::set<VertexId> good_vertices_;
-    std::set<EdgeId> good_edges_;
-    std::map<VertexId, std::vector<EdgeId>> next_edges_;
-    std::map<VertexId, size_t> subtree_coverage_;
+    phmap::flat_hash_set<VertexId> good_vertices_;
+    phmap::flat_hash_set<EdgeId> good_edges_;
+    phmap::flat_hash_map<VertexId, std::vector<EdgeId>> next_edges_;
+    phmap::flat_hash_map<VertexId, size_t> subtree_coverage_;
 
     bool ConsistentWithPartition(mixed_color_t color) const {
         return current_color_partition_.set_size(
@@ -551,17 +533,13 @@ class SkeletonTreeFinder {
     std::vector<EdgeId> GoodOutgoingEdges(const std::vector<VertexId> &vertices) const {
         std::vector<EdgeId> answer;
         for (VertexId v : vertices) {
-            if (component_.end_vertices().count(v) == 0) {
+            if (!component_.is_end_vertex(v)) {
                 utils::push_back_all(answer, GoodOutgoingEdges(v));
             }
         }
         return answer;
     }
 
-    std::set<EdgeId> VectorAsSet(const std::vector<EdgeId> &edges) const {
-        return std::set<EdgeId>(edges.begin(), edges.end());
-    }
-
     template<class T>
     std::vector<T> SetAsVector(const std::set<T> &edges) const {
         return std::vector<T>(edges.begin(), edges.end());
@@ -637,15 +615,15 @@ public:
             const ComponentColoring<Graph>& coloring) :
         component_(component),
         coloring_(coloring),
-        level_heights_(SetAsVector<size_t>(component_.avg_distances())),
+        level_heights_(component_.avg_distances()),
         current_level_((int) level_heights_.size() - 1),
         current_color_partition_(component_.end_vertices().size()) {
 
         Init();
     }
 
-    const std::set<EdgeId> GetTreeEdges() const {
-        std::set<EdgeId> answer;
+    typename SkeletonTree<Graph>::EdgeSet GetTreeEdges() const {
+        typename SkeletonTree<Graph>::EdgeSet answer;
         std::queue<VertexId> vertex_queue;
         vertex_queue.push(component_.start_vertex());
         while (!vertex_queue.empty()) {
@@ -661,7 +639,7 @@ public:
         return answer;
     }
 
-    const std::map<VertexId, std::vector<EdgeId>> &GetTree() const {
+    const phmap::flat_hash_map<VertexId, std::vector<EdgeId>> &GetTree() const {
         return next_edges_;
     }
 
@@ -670,18 +648,18 @@ public:
         while (current_level_ >= 0) {
             size_t height = level_heights_[current_level_];
             DEBUG("Processing level " << current_level_ << " on height " << height);
-            std::set<VertexId> level_vertices = component_.vertices_on_height(height);
+            std::vector<VertexId> level_vertices = component_.vertices_on_height(height);
             VERIFY(!level_vertices.empty());
 
             //looking for good edges
-            utils::insert_all(good_edges_,
-                              GoodOutgoingEdges(std::vector<VertexId>(level_vertices.begin(), level_vertices.end())));
+            for (EdgeId e : GoodOutgoingEdges(level_vertices))
+                good_edges_.insert(e);
 
 
 
             //counting colors and color partitions
             for (VertexId v : level_vertices) {
-                if (component_.end_vertices().count(v) == 0) {
+                if (!component_.is_end_vertex(v)) {
                     UpdateColorPartitionWithVertex(v);
                     if (IsGoodVertex(v)) {
                         DEBUG("Vertex " << component_.g().str(v) << " is classified as good");
@@ -712,7 +690,7 @@ template<class Graph>
 void PrintComponent(const LocalizedComponent<Graph> &component,
                     const SkeletonTree<Graph> &tree, const std::string &file_name) {
     typedef typename Graph::EdgeId EdgeId;
-    const std::set<EdgeId> &tree_edges = tree.edges();
+    const auto &tree_edges = tree.edges();
     std::shared_ptr<visualization::graph_colorer::ElementColorer<typename Graph::EdgeId>> edge_colorer =
             std::make_shared<visualization::graph_colorer::MapColorer<EdgeId>>(
             tree_edges.begin(), tree_edges.end(),"green", ""
@@ -734,17 +712,56 @@ class ComponentProjector {
     typedef typename Graph::EdgeId EdgeId;
     typedef typename Graph::VertexId VertexId;
 
+    //Keeps the component, its coloring and the tree in sync with the graph while projecting
+    class ProjectionTracker : public GraphActionHandler<Graph> {
+        LocalizedComponent<Graph>& component_;
+        ComponentColoring<Graph>& coloring_;
+        SkeletonTree<Graph>& tree_;
+
+    public:
+        ProjectionTracker(LocalizedComponent<Graph>& component,
+                          ComponentColoring<Graph>& coloring,
+                          SkeletonTree<Graph>& tree) :
+                GraphActionHandler<Graph>(component.g(), "br_projection"),
+                component_(component), coloring_(coloring), tree_(tree) {}
+
+        void HandleDelete(VertexId v) override {
+            component_.HandleDelete(v);
+            coloring_.HandleDelete(v);
+            tree_.HandleDelete(v);
+        }
+
+        void HandleDelete(EdgeId e) override {
+            tree_.HandleDelete(e);
+        }
+
+        void HandleMerge(const std::vector<EdgeId> & /*old_edges*/, EdgeId /*new_edge*/) override {
+            VERIFY(false);
+        }
+
+        void HandleGlue(EdgeId new_edge, EdgeId edge1, EdgeId edge2) override {
+            coloring_.HandleGlue(new_edge, edge1, edge2);
+            tree_.HandleGlue(new_edge, edge1, edge2);
+        }
+
+        void HandleSplit(EdgeId old_edge, EdgeId new_edge_1, EdgeId new_edge_2) override {
+            component_.HandleSplit(old_edge, new_edge_1, new_edge_2);
+            coloring_.HandleSplit(old_edge, new_edge_1, new_edge_2);
+            tree_.HandleSplit(old_edge, new_edge_1, new_edge_2);
+        }
+    };
+
     Graph& g_;
-    const LocalizedComponent<Graph>& component_;
-    const ComponentColoring<Graph>& coloring_;
-    const SkeletonTree<Graph>& tree_;
+    LocalizedComponent<Graph>& component_;
+    ComponentColoring<Graph>& coloring_;
+    SkeletonTree<Graph>& tree_;
 
 //    DEBUG("Result: edges " << g_.str(split_res.first) << " " << g_.str(split_res.second));
 //    DEBUG("New vertex" << g_.str(inner_v) << " ");
 
     bool SplitComponent() {
         DEBUG("Splitting component");
-        std::set<size_t> level_heights(component_.avg_distances());
+        std::vector<size_t> level_heights(component_.avg_distances());
         DEBUG("Level heights " << utils::ContainerToString(level_heights));
 
         GraphComponent<Graph> gc = component_.AsGraphComponent();
@@ -755,8 +772,8 @@ class ComponentProjector {
             size_t start_dist = component_.avg_distance(start_v);
             size_t end_dist = component_.avg_distance(end_v);
             DEBUG("Processing edge " << g_.str(*it) << " avg_start " << start_dist << " avg_end " << end_dist);
-            std::set<size_t> dist_to_split(level_heights.lower_bound(start_dist),
-                                           level_heights.upper_bound(end_dist));
+            std::vector<size_t> dist_to_split(std::lower_bound(level_heights.begin(), level_heights.end(), start_dist),
+                                              std::upper_bound(level_heights.begin(), level_heights.end(), end_dist));
             DEBUG("Distances to split " << utils::ContainerToString(dist_to_split));
 
             size_t offset = start_dist;
@@ -793,7 +810,7 @@ class ComponentProjector {
         size_t end_height = component_.avg_distance(g_.EdgeEnd(e));
         DEBUG("Done");
         for (VertexId v : component_.vertices_on_height(start_height)) {
-            if (component_.end_vertices().count(v) == 0) {
+            if (!component_.is_end_vertex(v)) {
                 for (EdgeId e : g_.OutgoingEdges(v)) {
                     VERIFY(component_.avg_distance(g_.EdgeEnd(e)) == end_height);
                     if (tree_.Contains(e)
@@ -810,6 +827,7 @@ class ComponentProjector {
 public:
 
     bool ProjectComponent() {
+        ProjectionTracker tracker(component_, coloring_, tree_);
         if (!SplitComponent()) {
             DEBUG("Component can't be split");
             return false;
@@ -834,9 +852,9 @@ public:
         return true;
     }
 
-    ComponentProjector(Graph& g, const LocalizedComponent<Graph>& component,
-            const ComponentColoring<Graph>& coloring,
-            const SkeletonTree<Graph>& tree) :
+    ComponentProjector(Graph& g, LocalizedComponent<Graph>& component,
+            ComponentColoring<Graph>& coloring,
+            SkeletonTree<Graph>& tree) :
             g_(g), component_(component), coloring_(coloring), tree_(tree) {
 
     }
@@ -859,8 +877,9 @@ class LocalizedComponentFinder {
 
     LocalizedComponent<Graph> comp_;
 
-    std::map<VertexId, Range> dominated_;
-    std::set<VertexId> interfering_;
+    DominatedSetFinder<Graph> dominated_set_finder_;
+    //sorted
+    std::vector<VertexId> interfering_;
 
     std::string ToString(EdgeId e) const {
         std::stringstream ss;
@@ -880,6 +899,22 @@ class LocalizedComponentFinder {
         return false;
     }
 
+    void AddInterfering(VertexId v) {
+        auto it = std::lower_bound(interfering_.begin(), interfering_.end(), v);
+        if (it == interfering_.end() || *it != v)
+            interfering_.insert(it, v);
+    }
+
+    void RemoveInterfering(VertexId v) {
+        auto it = std::lower_bound(interfering_.begin(), interfering_.end(), v);
+        if (it != interfering_.end() && *it == v)
+            interfering_.erase(it);
+    }
+
+    bool IsDominated(VertexId v) const {
+        return dominated().count(v) > 0;
+    }
+
     //false if new interfering vertex is not dominated
     //can be slightly modified in new algorithm
     bool ProcessLocality(VertexId processing_v) {
@@ -894,8 +929,8 @@ class LocalizedComponentFinder {
         }
         if (!processed_neighb.empty()) {
             for (VertexId v : unprocessed_neighb) {
-                if (dominated_.count(v) > 0) {
-                    interfering_.insert(v);
+                if (IsDominated(v)) {
+                    AddInterfering(v);
                 } else {
                     return false;
                 }
@@ -915,8 +950,8 @@ class LocalizedComponentFinder {
                 return false;
             }
             if (!comp_.contains(next_v)) {
-                VERIFY(dominated_.count(v) > 0);
-                comp_.AddVertex(next_v, dominated_.find(next_v)->second);
+                VERIFY(IsDominated(v));
+                comp_.AddVertex(next_v, dominated().find(next_v)->second);
                 for (EdgeId e : g_.IncomingEdges(next_v)) {
                     q.push(g_.EdgeStart(e));
                 }
@@ -925,21 +960,24 @@ class LocalizedComponentFinder {
         return true;
     }
 
-    //todo optimize
+    //closest by distance, the smallest one among equally close
     boost::optional<VertexId> ClosestNeigbour() const {
         size_t min_dist = inf;
         boost::optional<VertexId> answer = boost::none;
-        for (auto it = dominated_.begin(); it != dominated_.end(); ++it) {
-            if (!comp_.contains(it->first) && it->second.start_pos < min_dist) {
-                min_dist = it->second.start_pos;
-                answer = boost::optional<VertexId>(it->first);
+        for (const auto &v_r : dominated()) {
+            if (comp_.contains(v_r.first))
+                continue;
+            size_t dist = v_r.second.start_pos;
+            if (dist < min_dist || (answer && dist == min_dist && v_r.first < *answer)) {
+                min_dist = dist;
+                answer = boost::optional<VertexId>(v_r.first);
             }
         }
         return answer;
     }
 
     bool ProcessInterferingVertex(VertexId v) {
-        interfering_.erase(v);
+        RemoveInterfering(v);
         return AddVertexWithBackwardPaths(v);
     }
 
@@ -969,7 +1007,7 @@ class LocalizedComponentFinder {
 
     bool CloseComponent() {
         while (!interfering_.empty()) {
-            VertexId v = *interfering_.begin();
+            VertexId v = interfering_.front();
             DEBUG("Processing interfering vertex " << g_.str(v));
             if (!ProcessInterferingVertex(v)) {
                 DEBUG("Vertex processing failed");
@@ -983,12 +1021,19 @@ public:
     LocalizedComponentFinder(const Graph& g, size_t max_length,
             size_t length_diff_threshold, VertexId start_v) :
             g_(g), max_length_(max_length), length_diff_threshold_(
-                    length_diff_threshold), comp_(g, start_v) {
+                    length_diff_threshold), comp_(g, start_v),
+            //todo introduce reasonable vertex bound
+            dominated_set_finder_(g, start_v, max_length/*, 1000*/) {
+        Reset(start_v);
+    }
+
+    //restarts the search from another vertex reusing all the allocated memory
+    void Reset(VertexId start_v) {
+        comp_.Reset(start_v);
+        interfering_.clear();
+        dominated_set_finder_.Reset(start_v);
+        dominated_set_finder_.FillDominated();
         DEBUG("Component finder from vertex " << g_.str(comp_.start_vertex()) << " created");
-        //todo introduce reasonable vertex bound
-        DominatedSetFinder<Graph> dominated_set_finder(g_, start_v, max_length/*, 1000*/);
-        dominated_set_finder.FillDominated();
-        dominated_ = dominated_set_finder.dominated();
     }
 
     bool ProceedFurther() {
@@ -1000,7 +1045,7 @@ public:
 
             if (next_v) {
                 DEBUG("Vertex " << g_.str(*next_v) << " was chosen as closest neighbour");
-                interfering_.insert(*next_v);
+                AddInterfering(*next_v);
                 DEBUG("Trying to construct closure");
                 if (!CloseComponent()) {
                     DEBUG("Failed to close component");
@@ -1035,124 +1080,138 @@ public:
         return true;
     }
 
-    const LocalizedComponent<Graph>& component() {
+    const LocalizedComponent<Graph>& component() const {
         return comp_;
     }
 
+    const phmap::flat_hash_map<VertexId, Range> &dominated() const {
+        return dominated_set_finder_.dominated();
+    }
+
 private:
     DECL_LOGGER("LocalizedComponentFinder");
 };
 
-template<class Graph>
-class CandidateFinder : public VertexCondition<Graph> {
-    typedef typename Graph::VertexId VertexId;
-    size_t max_length_;
-    size_t length_diff_;
-
-public:
-    CandidateFinder(const Graph& g, size_t max_length, size_t length_diff) :
-        VertexCondition<Graph>(g), max_length_(max_length), length_diff_(length_diff) {
-    }
-
-    bool Check(VertexId v) const override {
-        const Graph& g = this->g();
-        LocalizedComponentFinder<Graph> comp_finder(g, max_length_,
-                                                    length_diff_, v);
-        while (comp_finder.ProceedFurther()) {
-            DEBUG("Found component candidate start_v " << g.str(v));
-            LocalizedComponent<Graph> component = comp_finder.component();
-            //todo introduce reasonable size bound
-            //if (component.size() > 1000) {
-            //    return false;
-            //}
-            ComponentColoring<Graph> coloring(component);
-            SkeletonTreeFinder<Graph> tree_finder(component, coloring);
-            DEBUG("Looking for a tree");
-            if (tree_finder.FindTree()) {
-                return true;
-            }
-        }
-        return false;
-    }
-private:
-    DECL_LOGGER("CBRCandidateFinder");
-};
 
 template<class Graph>
-class ComplexBulgeRemover : public PersistentProcessingAlgorithm<Graph, typename Graph::VertexId> {
+class ComplexBulgeRemover : public PersistentAlgorithmBase<Graph> {
     typedef typename Graph::VertexId VertexId;
     typedef typename Graph::EdgeId EdgeId;
-    typedef PersistentProcessingAlgorithm<Graph, VertexId> base;
+    typedef PersistentAlgorithmBase<Graph> base;
     typedef SmartEdgeSet<std::unordered_set<EdgeId>, Graph> RestrictedEdgeSet;
+    typedef LocalizedComponentFinder<Graph> ComponentFinder;
+
+    //Result of the read-only search from a single start vertex
+    struct Candidate {
+        VertexId start_v;
+        //component to be projected, empty if nothing was found
+        std::unique_ptr<LocalizedComponent<Graph>> component;
+        typename SkeletonTree<Graph>::EdgeSet tree_edges;
+        size_t candidate_cnt = 0;
+        //vertices the search result depends on
+        std::vector<VertexId> region;
+    };
 
     size_t max_length_;
     size_t length_diff_;
     const RestrictedEdgeSet *protected_edges_ = nullptr;
+    size_t chunk_cnt_;
     std::string pics_folder_;
 
-    bool ProcessComponent(LocalizedComponent<Graph>& component,
-            size_t candidate_cnt) {
-        DEBUG("Processing component");
-        ComponentColoring<Graph> coloring(component);
-        SkeletonTreeFinder<Graph> tree_finder(component, coloring);
-        DEBUG("Looking for a tree");
-        if (tree_finder.FindTree()) {
-            DEBUG("Tree found");
-            SkeletonTree<Graph> tree(component, tree_finder.GetTreeEdges());
-
-            if (protected_edges_) {
-                auto tree_edges = tree_finder.GetTreeEdges();
-                for (auto edge : tree_edges) {
-                    if (protected_edges_->count(edge) > 0) {
-                        DEBUG("Trying to project a-domain edges");
-                        return false;
-                    }
+    bool HasProtectedEdges(const typename SkeletonTree<Graph>::EdgeSet &tree_edges) const {
+        if (!protected_edges_)
+            return false;
+        for (EdgeId e : tree_edges) {
+            if (protected_edges_->count(e) > 0)
+                return true;
+        }
+        return false;
+    }
+
+    //Does not modify the graph. The finder is a per-thread workspace reused between the searches.
+    //First skip candidates are ignored (they have already been tried and failed to be projected)
+    void Search(VertexId v, std::unique_ptr<ComponentFinder> &finder, Candidate &candidate,
+                size_t skip = 0) const {
+        const Graph &g = this->g();
+        if (finder)
+            finder->Reset(v);
+        else
+            finder.reset(new ComponentFinder(g, max_length_, length_diff_, v));
+
+        candidate.start_v = v;
+        size_t candidate_cnt = 0;
+        while (finder->ProceedFurther()) {
+            candidate_cnt++;
+            if (candidate_cnt <= skip)
+                continue;
+            DEBUG("Found component candidate " << candidate_cnt << " start_v " << g.str(v));
+            const LocalizedComponent<Graph> &component = finder->component();
+            ComponentColoring<Graph> coloring(component);
+            SkeletonTreeFinder<Graph> tree_finder(component, coloring);
+            DEBUG("Looking for a tree");
+            if (!tree_finder.FindTree()) {
+                DEBUG("Failed to find skeleton tree for candidate " << candidate_cnt << " start_v " << g.str(v));
+                if (!pics_folder_.empty()) {
+                    //todo check if we rewrite all of the previous pics!
+                    PrintComponent(component,
+                            pics_folder_ + "fail/"
+                                    + std::to_string(g.int_id(v)) //+ "_" + std::to_string(candidate_cnt)
+                                    + ".dot");
                 }
+                continue;
             }
-
-            if (!pics_folder_.empty()) {
-                PrintComponent(component, tree,
-                        pics_folder_ + "success/"
-                                + std::to_string(this->g().int_id(component.start_vertex()))
-                                + "_" + std::to_string(candidate_cnt) + ".dot");
+            DEBUG("Tree found");
+            auto tree_edges = tree_finder.GetTreeEdges();
+            if (HasProtectedEdges(tree_edges)) {
+                DEBUG("Trying to project a-domain edges");
+                continue;
             }
+            candidate.component.reset(new LocalizedComponent<Graph>(component));
+            candidate.tree_edges = std::move(tree_edges);
+            candidate.candidate_cnt = candidate_cnt;
+            break;
+        }
 
-            ComponentProjector<Graph> projector(this->g(), component, coloring, tree);
-            if (!projector.ProjectComponent()) {
-                //todo think of stopping the whole process
-                DEBUG("Component can't be projected");
-                return false;
-            }
-            DEBUG("Successfully processed component candidate " << candidate_cnt << " start_v " << this->g().str(component.start_vertex()));
-            return true;
-        } else {
-            DEBUG("Failed to find skeleton tree for candidate " << candidate_cnt << " start_v " << this->g().str(component.start_vertex()));
-            if (!pics_folder_.empty()) {
-                //todo check if we rewrite all of the previous pics!
-                PrintComponent(component,
-                        pics_folder_ + "fail/"
-                                + std::to_string(this->g().int_id(component.start_vertex())) //+ "_" + std::to_string(candidate_cnt)
-                                + ".dot");
+        for (const auto &v_r : finder->dominated()) {
+            candidate.region.push_back(v_r.first);
+            for (EdgeId e : g.IncidentEdges(v_r.first)) {
+                candidate.region.push_back(g.EdgeStart(e));
+                candidate.region.push_back(g.EdgeEnd(e));
             }
-            return false;
         }
     }
 
-    bool InnerProcess(VertexId v, std::vector<VertexId>& vertices_to_post_process) {
-        size_t candidate_cnt = 0;
-        LocalizedComponentFinder<Graph> comp_finder(this->g(), max_length_,
-                                                    length_diff_, v);
-        while (comp_finder.ProceedFurther()) {
-            candidate_cnt++;
-            DEBUG("Found component candidate " << candidate_cnt << " start_v " << this->g().str(v));
-            LocalizedComponent<Graph> component = comp_finder.component();
-            if (ProcessComponent(component, candidate_cnt)) {
-                GraphComponent<Graph> gc = component.AsGraphComponent();
-                std::copy(gc.v_begin(), gc.v_end(), std::back_inserter(vertices_to_post_process));
-                return true;
+    //Candidates with components to project from every vertex of the graph
+    std::vector<Candidate> SearchAll(std::vector<std::unique_ptr<ComponentFinder>> &workspaces) const {
+        auto chunks = IterationHelper<Graph, VertexId>(this->g()).Chunks(chunk_cnt_);
+        std::vector<std::vector<Candidate>> found(chunks.size() - 1);
+
+        #pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < chunks.size() - 1; ++i) {
+            auto &finder = workspaces[omp_get_thread_num()];
+            for (auto it = chunks[i], end = chunks[i + 1]; it != end; ++it) {
+                Candidate candidate;
+                Search(*it, finder, candidate);
+                if (candidate.component)
+                    found[i].push_back(std::move(candidate));
             }
         }
-        return false;
+
+        std::vector<Candidate> answer;
+        for (auto &chunk : found)
+            std::move(chunk.begin(), chunk.end(), std::back_inserter(answer));
+        return answer;
+    }
+
+    std::vector<Candidate> Search(const std::vector<VertexId> &vertices,
+                                  std::vector<std::unique_ptr<ComponentFinder>> &workspaces) const {
+        std::vector<Candidate> answer(vertices.size());
+
+        #pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            Search(vertices[i], workspaces[omp_get_thread_num()], answer[i]);
+        }
+        return answer;
     }
 
     //todo shrink this set if needed
@@ -1165,17 +1224,66 @@ class ComplexBulgeRemover : public PersistentProcessingAlgorithm<Graph, typename
         return answer;
     }
 
+    void MarkModified(VertexId v, phmap::flat_hash_set<VertexId> &modified) const {
+        modified.insert(v);
+        modified.insert(this->g().conjugate(v));
+    }
+
+    bool IsOutdated(const Candidate &candidate, const phmap::flat_hash_set<VertexId> &modified) const {
+        for (VertexId v : candidate.region) {
+            if (modified.count(v))
+                return true;
+        }
+        return false;
+    }
+
+    bool ProcessComponent(Candidate &candidate, std::vector<VertexId> &vertices_to_reconsider) {
+        LocalizedComponent<Graph> &component = *candidate.component;
+        DEBUG("Processing component");
+        ComponentColoring<Graph> coloring(component);
+        SkeletonTree<Graph> tree(component, candidate.tree_edges);
+
+        if (!pics_folder_.empty()) {
+            PrintComponent(component, tree,
+                    pics_folder_ + "success/"
+                            + std::to_string(this->g().int_id(component.start_vertex()))
+                            + "_" + std::to_string(candidate.candidate_cnt) + ".dot");
+        }
+
+        //a bit of hacking (look further)
+        SmartSetIterator<Graph, VertexId> added_vertices(this->g(), true);
+        ComponentProjector<Graph> projector(this->g(), component, coloring, tree);
+        if (!projector.ProjectComponent()) {
+            //todo think of stopping the whole process
+            DEBUG("Component can't be projected");
+            //a bit of hacking:
+            //reverting changes resulting from potentially attempted, but failed split
+            Compressor<Graph> compressor(this->g());
+            for (; !added_vertices.IsEnd(); ++added_vertices) {
+                compressor.CompressVertex(*added_vertices);
+            }
+            return false;
+        }
+        DEBUG("Successfully processed component candidate " << candidate.candidate_cnt << " start_v " << this->g().str(component.start_vertex()));
+
+        GraphComponent<Graph> gc = component.AsGraphComponent();
+        for (VertexId p_p : gc.vertices()) {
+            //Neighbours(p_p) includes p_p
+            utils::push_back_all(vertices_to_reconsider, Neighbours(p_p));
+            this->g().CompressVertex(p_p);
+        }
+        return true;
+    }
+
 public:
 
-    //track_changes=false leads to every iteration run from scratch
     ComplexBulgeRemover(Graph& g, size_t max_length, size_t length_diff, const RestrictedEdgeSet *protected_edges,
                         size_t chunk_cnt, const std::string& pics_folder = "") :
-            base(g, std::make_shared<omnigraph::ParallelInterestingElementFinder<Graph, VertexId>>(
-                CandidateFinder<Graph>(g, max_length, length_diff), chunk_cnt),
-                false, std::less<VertexId>(), /*track changes*/false),
+            base(g),
             max_length_(max_length),
             length_diff_(length_diff),
             protected_edges_(protected_edges),
+            chunk_cnt_(chunk_cnt),
             pics_folder_(pics_folder) {
         if (!pics_folder_.empty()) {
 //            remove_dir(pics_folder_);
@@ -1186,30 +1294,59 @@ public:
 
     }
 
-    bool Process(VertexId v) override {
-        DEBUG("Processing vertex " << this->g().str(v));
-        std::vector<VertexId> vertices_to_post_process;
-        //a bit of hacking (look further)
-        SmartSetIterator<Graph, VertexId> added_vertices(this->g(), true);
-
-        if (InnerProcess(v, vertices_to_post_process)) {
-            for (VertexId p_p : vertices_to_post_process) {
-                //Neighbours(p_p) includes p_p
-                for (VertexId n : Neighbours(p_p)) {
-                    this->ReturnForConsideration(n);
+    /**
+     * Every run starts from scratch. Components are searched from all the vertices in parallel
+     * without touching the graph, then the found ones are projected one by one in the order of
+     * start vertices. A candidate whose search region was affected by the projections made
+     * earlier in the same round is searched again in the next round together with the
+     * neighbourhoods of the projected components. If a component fails to be projected, the
+     * search from its start vertex is resumed right away to try the larger components.
+     */
+    size_t Run(bool /*force_primary_launch*/ = false,
+               double /*iter_run_progress*/ = 1.) override {
+        std::vector<std::unique_ptr<ComponentFinder>> workspaces(omp_get_max_threads());
+        std::vector<Candidate> candidates = SearchAll(workspaces);
+
+        size_t triggered = 0;
+        while (!candidates.empty()) {
+            std::sort(candidates.begin(), candidates.end(),
+                      [](const Candidate &a, const Candidate &b) { return a.start_v < b.start_v; });
+            DEBUG("Processing " << candidates.size() << " candidates");
+
+            phmap::flat_hash_set<VertexId> modified;
+            std::vector<VertexId> to_reconsider;
+            for (Candidate &candidate : candidates) {
+                if (IsOutdated(candidate, modified)) {
+                    to_reconsider.push_back(candidate.start_v);
+                    continue;
+                }
+                while (candidate.component) {
+                    for (const auto &h_v : candidate.component->height_2_vertices()) {
+                        for (VertexId n : Neighbours(h_v.second))
+                            MarkModified(n, modified);
+                    }
+                    if (ProcessComponent(candidate, to_reconsider)) {
+                        triggered++;
+                        break;
+                    }
+                    //failed split was reverted, proceed to the larger components from the same vertex
+                    if (!this->g().contains(candidate.start_v))
+                        break;
+                    Candidate next;
+                    Search(candidate.start_v, workspaces[omp_get_thread_num()], next, candidate.candidate_cnt);
+                    candidate = std::move(next);
                 }
-                this->g().CompressVertex(p_p);
-            }
-            return true;
-        } else {
-            //a bit of hacking:
-            //reverting changes resulting from potentially attempted, but failed split
-            Compressor<Graph> compressor(this->g());
-            for (; !added_vertices.IsEnd(); ++added_vertices) {
-                compressor.CompressVertex(*added_vertices);
             }
-            return false;
+
+            std::sort(to_reconsider.begin(), to_reconsider.end());
+            to_reconsider.erase(std::unique(to_reconsider.begin(), to_reconsider.end()), to_reconsider.end());
+            //some of the vertices might have been removed by compression
+            to_reconsider.erase(std::remove_if(to_reconsider.begin(), to_reconsider.end(),
+                                               [&](VertexId v) { return !this->g().contains(v); }),
+                                to_reconsider.end());
+            candidates = Search(to_reconsider, workspaces);
         }
+        return triggered;
     }
 
 private:
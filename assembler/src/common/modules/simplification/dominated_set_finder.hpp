@@ -1,5 +1,7 @@
 #pragma once
 
+#include <parallel_hashmap/phmap.h>
+
 #include <queue>
 
 namespace omnigraph {
@@ -14,7 +16,7 @@ class DominatedSetFinder {
     size_t max_count_;
 
     size_t cnt_;
-    std::map<VertexId, Range> dominated_;
+    phmap::flat_hash_map<VertexId, Range> dominated_;
 
     bool CheckCanBeProcessed(VertexId v) const {
         DEBUG("Check if vertex " << g_.str(v) << " is dominated close neighbour");
@@ -84,6 +86,13 @@ public:
 
     }
 
+    //clears the dominated set keeping the allocated memory, so the finder could be reused
+    void Reset(VertexId v) {
+        start_vertex_ = v;
+        cnt_ = 0;
+        dominated_.clear();
+    }
+
     //true if no thresholds exceeded
     bool FillDominated() {
         DEBUG("Adding starting vertex " << g_.str(start_vertex_) << " to dominated set");
@@ -111,7 +120,7 @@ public:
         return true;
     }
 
-    const std::map<VertexId, Range> &dominated() const {
+    const phmap::flat_hash_map<VertexId, Range> &dominated() const {
         return dominated_;
     }
 
@@ -12,6 +12,7 @@
 #include "assembly_graph/core/basic_graph_stats.hpp"
 #include "assembly_graph/core/graph.hpp"
 #include "assembly_graph/paths/path_processor.hpp"
+#include "assembly_graph/paths/reachable_lengths.hpp"
 
 #include "paired_info/pair_info_bounds.hpp"
 #include "paired_info.hpp"
@@ -12,23 +12,83 @@
 #include "paired_info/insert_size_refiner.hpp"
 #include "modules/alignment/sequence_mapper_notifier.hpp"
 
+#include <cmath>
+#include <memory>
+
 namespace debruijn_graph {
 
 using namespace omnigraph;
 
+/**
+ * @brief Collects insert size histogram of read pairs mapped to the same long edge.
+ *        Reasonable insert sizes are counted in dense per-thread arrays, the rest
+ *        (negative or extremely large ones) go to sparse maps.
+ */
 class InsertSizeCounter: public SequenceMapperListener {
+    static constexpr int MAX_DENSE_IS = 1 << 16;
+
+    struct IsHist {
+        std::vector<size_t> dense;
+        HistType sparse;
+        size_t count = 0;
+
+        void add(int is, size_t count) {
+            this->count += count;
+            if (is < 0 || is >= MAX_DENSE_IS) {
+                sparse[is] += count;
+                return;
+            }
+            if (size_t(is) >= dense.size())
+                dense.resize(is + 1, 0);
+            dense[is] += count;
+        }
+
+        void merge(IsHist &other) {
+            if (other.dense.size() > dense.size())
+                dense.resize(other.dense.size(), 0);
+            for (size_t i = 0; i < other.dense.size(); ++i)
+                dense[i] += other.dense[i];
+            for (const auto &kv : other.sparse)
+                sparse[kv.first] += kv.second;
+            count += other.count;
+
+            std::fill(other.dense.begin(), other.dense.end(), 0);
+            other.sparse.clear();
+            other.count = 0;
+        }
+
+        void clear() {
+            dense.clear();
+            sparse.clear();
+            count = 0;
+        }
+
+        HistType ToMap() const {
+            HistType res(sparse);
+            for (size_t i = 0; i < dense.size(); ++i) {
+                if (dense[i])
+                    res[int(i)] = dense[i];
+            }
+            return res;
+        }
+    };
+
+    struct IsStats {
+        double mean = 0., delta = 0.;
+        std::map<size_t, size_t> percentiles;
+    };
 
 public:
 
     InsertSizeCounter(const conj_graph_pack& gp,
             size_t edge_length_threshold,
             bool ignore_negative = false)
-        : gp_(gp), 
+        : gp_(gp),
           edge_length_threshold_(edge_length_threshold),
           ignore_negative_(ignore_negative) {
     }
 
-    HistType hist() { return hist_; }
+    HistType hist() const { return hist_.ToMap(); }
     size_t total() const { return total_.total_; }
     size_t mapped() const { return counted_.total_; }
     size_t negative() const { return negative_.total_; }
@@ -36,7 +96,8 @@ public:
 
     void StartProcessLibrary(size_t threads_count) override {
         hist_.clear();
-        tmp_hists_ = std::vector<HistType>(threads_count);
+        last_stats_.reset();
+        tmp_hists_ = std::vector<IsHist>(threads_count);
 
         total_ = count_data(threads_count);
         counted_ = count_data(threads_count);
@@ -67,18 +128,45 @@ public:
     }
 
     void MergeBuffer(size_t thread_index) override {
-        for (const auto& kv: tmp_hists_[thread_index])
-            hist_[kv.first] += kv.second;
-
-        tmp_hists_[thread_index].clear();
+        hist_.merge(tmp_hists_[thread_index]);
     }
 
     void FindMean(double& mean, double& delta, std::map<size_t, size_t>& percentiles) const {
-        find_mean(hist_, mean, delta, percentiles);
+        find_mean(hist(), mean, delta, percentiles);
     }
 
     void FindMedian(double& median, double& mad, HistType& histogram) const {
-        find_median(hist_, median, mad, histogram);
+        find_median(hist(), median, mad, histogram);
+    }
+
+    /**
+     * Compares mean, deviation and percentiles of the merged histogram with the ones obtained
+     * on the previous call. Returns true if none of them moved by more than tolerance
+     * (relative to the mean for the mean and deviation) and at least min_count pairs were counted.
+     */
+    bool Converged(double tolerance, size_t min_count) {
+        if (hist_.count < min_count)
+            return false;
+
+        IsStats stats;
+        FindMean(stats.mean, stats.delta, stats.percentiles);
+
+        bool converged = false;
+        if (last_stats_) {
+            const IsStats &last = *last_stats_;
+            double eps = tolerance * stats.mean;
+            converged = std::abs(stats.mean - last.mean) <= eps &&
+                        std::abs(stats.delta - last.delta) <= eps &&
+                        stats.percentiles.size() == last.percentiles.size();
+            for (const auto &p : stats.percentiles) {
+                auto it = last.percentiles.find(p.first);
+                converged &= it != last.percentiles.end() &&
+                             std::abs(double(p.second) - double(it->second)) <= tolerance * double(p.second);
+            }
+        }
+
+        last_stats_.reset(new IsStats(std::move(stats)));
+        return converged;
     }
 
 private:
@@ -104,7 +192,7 @@ private:
             TRACE("IS: " << read2_start << " - " <<  read1_start << " + " << (int) is_delta << " = " << is);
 
             if (is > 0 || ignore_negative_) {
-                tmp_hists_[thread_index][is] += 1;
+                tmp_hists_[thread_index].add(is, 1);
                 ++counted_.arr_[thread_index];
             } else {
                 ++negative_.arr_[thread_index];
@@ -133,8 +221,9 @@ private:
 private:
     const conj_graph_pack &gp_;
 
-    HistType hist_;
-    std::vector<HistType> tmp_hists_;
+    IsHist hist_;
+    std::vector<IsHist> tmp_hists_;
+    std::unique_ptr<IsStats> last_stats_;
 
     count_data total_;
     count_data counted_;
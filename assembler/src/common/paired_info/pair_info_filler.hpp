@@ -8,7 +8,7 @@
 #ifndef PAIR_INFO_FILLER_HPP_
 #define PAIR_INFO_FILLER_HPP_
 
-#include "paired_info/concurrent_pair_info_buffer.hpp"
+#include "paired_info/thread_local_pair_info_buffer.hpp"
 #include "modules/alignment/sequence_mapper_notifier.hpp"
 
 namespace debruijn_graph {
@@ -17,6 +17,8 @@ namespace debruijn_graph {
  * As for now it ignores sophisticated case of repeated consecutive
  * occurrence of edge in path due to gaps in mapping
  *
+ * Points are collected into per-thread buffers without locking and merged into the
+ * index at the end of the library. If workdir is given, large buffers are spilled there.
  */
 class LatePairedIndexFiller : public SequenceMapperListener {
     typedef std::pair<EdgeId, EdgeId> EdgePair;
@@ -25,42 +27,47 @@ public:
 
     LatePairedIndexFiller(const Graph &graph, WeightF weight_f,
                           unsigned round_distance,
-                          omnigraph::de::UnclusteredPairedInfoIndexT<Graph>& paired_index)
+                          omnigraph::de::UnclusteredPairedInfoIndexT<Graph>& paired_index,
+                          fs::TmpDir workdir = nullptr)
             : weight_f_(std::move(weight_f)),
               paired_index_(paired_index),
-              buffer_pi_(graph),
+              buffer_pi_(graph, workdir),
               round_distance_(round_distance) {}
 
-    void StartProcessLibrary(size_t) override {
+    void StartProcessLibrary(size_t threads_count) override {
         DEBUG("Start processing: start");
-        buffer_pi_.clear();
+        buffer_pi_.Init(threads_count);
         DEBUG("Start processing: end");
     }
 
     void StopProcessLibrary() override {
-        // paired_index_.Merge(buffer_pi_);
-        paired_index_.MoveAssign(buffer_pi_);
-        buffer_pi_.clear();
+        paired_index_.clear();
+        buffer_pi_.MergeInto(paired_index_);
     }
-    
-    void ProcessPairedRead(size_t,
+
+    void MergeBuffer(size_t thread_index) override {
+        buffer_pi_.Flush(thread_index);
+    }
+
+    void ProcessPairedRead(size_t thread_index,
                            const io::PairedRead& r,
                            const MappingPath<EdgeId>& read1,
                            const MappingPath<EdgeId>& read2) override {
-        ProcessPairedRead(read1, read2, r.distance());
+        ProcessPairedRead(thread_index, read1, read2, r.distance());
     }
 
-    void ProcessPairedRead(size_t,
+    void ProcessPairedRead(size_t thread_index,
                            const io::PairedReadSeq& r,
                            const MappingPath<EdgeId>& read1,
                            const MappingPath<EdgeId>& read2) override {
-        ProcessPairedRead(read1, read2, r.distance());
+        ProcessPairedRead(thread_index, read1, read2, r.distance());
     }
 
     virtual ~LatePairedIndexFiller() {}
 
 private:
-    void ProcessPairedRead(const MappingPath<EdgeId>& path1,
+    void ProcessPairedRead(size_t thread_index,
+                           const MappingPath<EdgeId>& path1,
                            const MappingPath<EdgeId>& path2, size_t read_distance) {
         for (size_t i = 0; i < path1.size(); ++i) {
             std::pair<EdgeId, MappingRange> mapping_edge_1 = path1[i];
@@ -84,7 +91,7 @@ private:
                     if (round_distance_ > 1)
                         edge_distance = int(std::round(edge_distance / double(round_distance_))) * round_distance_;
 
-                    buffer_pi_.Add(mapping_edge_1.first, mapping_edge_2.first,
+                    buffer_pi_.Add(thread_index, mapping_edge_1.first, mapping_edge_2.first,
                                    omnigraph::de::RawPoint(edge_distance, weight));
 
                 }
@@ -95,7 +102,7 @@ private:
 private:
     WeightF weight_f_;
     omnigraph::de::UnclusteredPairedInfoIndexT<Graph>& paired_index_;
-    omnigraph::de::ConcurrentPairedInfoBuffer<Graph> buffer_pi_;
+    omnigraph::de::ThreadLocalPairedBuffer<Graph> buffer_pi_;
     unsigned round_distance_;
 
     DECL_LOGGER("LatePairedIndexFiller");
@@ -11,9 +11,14 @@
 #include "split_path_constructor.hpp"
 #include "paired_info/paired_info_helpers.hpp"
 #include "assembly_graph/paths/path_utils.hpp"
+#include "assembly_graph/paths/path_processor.hpp"
 #include <math.h>
 #include <io/reads/read_processor.hpp>
 
+#include <algorithm>
+#include <map>
+#include <tuple>
+
 namespace debruijn_graph {
 
 inline bool ClustersIntersect(omnigraph::de::Point p1, omnigraph::de::Point p2) {
@@ -103,15 +108,25 @@ class PairInfoImprover {
              << "; contradictional = " << extra_paired_info_count);
     }
 
+    /**
+     * @brief Collects the points inconsistent with the other points of the same base edge into
+     *        per-thread flat vectors. Only points at positive distances d1 <= d2 could contradict
+     *        each other, so the points of the base edge are sorted by distance and every point is
+     *        swept against the ones that are not closer. Path queries stop on the first path found
+ *        and are memoized per base edge.
+     */
     class ContradictionalRemover {
+        typedef std::tuple<EdgeId, EdgeId, size_t, size_t> PathQuery;
+        typedef std::map<PathQuery, bool> PathCache;
+
       public:
-        ContradictionalRemover(omnigraph::de::PairedInfoIndicesT<Graph> &to_remove,
+        ContradictionalRemover(std::vector<PairInfos> &to_remove,
                                const Graph &g,
                                omnigraph::de::PairedInfoIndexT<Graph>& index, size_t max_repeat_length)
                 : to_remove_(to_remove), graph_(g), index_(index), max_repeat_length_(max_repeat_length) {}
 
         bool operator()(std::unique_ptr<EdgeId> e) {
-            omnigraph::de::PairedInfoIndexT<Graph> &to_remove = to_remove_[omp_get_thread_num()];
+            PairInfos &to_remove = to_remove_[omp_get_thread_num()];
 
             if (graph_.length(*e)>= max_repeat_length_ && index_.contains(*e))
                 FindInconsistent(*e, to_remove);
@@ -120,8 +135,22 @@ class PairInfoImprover {
         }
 
       private:
+        bool HasPath(EdgeId e1, EdgeId e2, size_t min_dist, size_t max_dist, PathCache &cache) const {
+            PathQuery query(e1, e2, min_dist, max_dist);
+            auto it = cache.find(query);
+            if (it != cache.end())
+                return it->second;
+
+            omnigraph::PathExistenceCallback<Graph> callback;
+            omnigraph::ProcessPaths(graph_, min_dist, max_dist,
+                                    graph_.EdgeEnd(e1), graph_.EdgeStart(e2), callback);
+            cache.emplace(query, callback.found());
+            return callback.found();
+        }
+
         bool IsConsistent(EdgeId /*e*/, EdgeId e1, EdgeId e2,
-                          const omnigraph::de::Point& p1, const omnigraph::de::Point& p2) const {
+                          const omnigraph::de::Point& p1, const omnigraph::de::Point& p2,
+                          PathCache &cache) const {
             if (math::le(p1.d, 0.f) || math::le(p2.d, 0.f) || math::gr(p1.d, p2.d))
                 return true;
 
@@ -137,14 +166,12 @@ class PairInfoImprover {
                 if (graph_.EdgeEnd(e1) == graph_.EdgeStart(e2))
                     return true;
 
-                auto paths = GetAllPathsBetweenEdges(graph_, e1, e2, 0, (size_t) ceil(pi_dist - first_length + var));
-                return (paths.size() > 0);
+                return HasPath(e1, e2, 0, (size_t) ceil(pi_dist - first_length + var), cache);
             } else {
                 if (math::gr(p2.d, p1.d + omnigraph::de::DEDistance(first_length))) {
-                    auto paths = GetAllPathsBetweenEdges(graph_, e1, e2,
-                                                         (size_t) floor(pi_dist - first_length - var),
-                                                         (size_t)  ceil(pi_dist - first_length + var));
-                    return (paths.size() > 0);
+                    return HasPath(e1, e2,
+                                   (size_t) floor(pi_dist - first_length - var),
+                                   (size_t)  ceil(pi_dist - first_length + var), cache);
                 }
                 return false;
             }
@@ -152,28 +179,37 @@ class PairInfoImprover {
 
         // Checking the consistency of two edge pairs (e, e_1) and (e, e_2) for all pairs (base_edge, <some_edge>)
         void FindInconsistent(EdgeId base_edge,
-                              Index& pi) const {
-            for (auto i1 : index_.Get(base_edge)) {
-                auto e1 = i1.first;
-                for (auto i2 : index_.Get(base_edge)) {
-                    auto e2 = i2.first;
-                    if (e1 == e2)
+                              PairInfos& to_remove) const {
+            PairInfos points;
+            for (auto i : index_.Get(base_edge)) {
+                for (auto p : i.second) {
+                    if (math::gr(p.d, 0.f))
+                        points.emplace_back(base_edge, i.first, p);
+                }
+            }
+            std::sort(points.begin(), points.end(),
+                      [](const auto &a, const auto &b) {
+                          return float(a.point.d) < float(b.point.d);
+                      });
+
+            PathCache cache;
+            size_t start = 0;
+            for (const auto &pi1 : points) {
+                // Points farther than pi1 (up to the floating point tolerance) form a suffix
+                while (math::gr(pi1.point.d, points[start].point.d))
+                    ++start;
+
+                for (size_t j = start; j < points.size(); ++j) {
+                    const auto &pi2 = points[j];
+                    if (pi1.second == pi2.second)
                         continue;
-                    for (auto p1 : i1.second) {
-                        for (auto p2 : i2.second) {
-                            if (!IsConsistent(base_edge, e1, e2, p1, p2)) {
-                                if (p1.lt(p2))
-                                    pi.Add(base_edge, e1, p1);
-                                else
-                                    pi.Add(base_edge, e2, p2);
-                            }
-                        }
-                    }
+                    if (!IsConsistent(base_edge, pi1.second, pi2.second, pi1.point, pi2.point, cache))
+                        to_remove.push_back(pi1.point.lt(pi2.point) ? pi1 : pi2);
                 }
             }
         }
 
-        omnigraph::de::PairedInfoIndicesT<Graph> &to_remove_;
+        std::vector<PairInfos> &to_remove_;
         const Graph &graph_;
         Index& index_;
         size_t max_repeat_length_;
@@ -182,7 +218,7 @@ class PairInfoImprover {
     size_t RemoveContradictional(unsigned nthreads) {
         size_t cnt = 0;
 
-        omnigraph::de::PairedInfoIndicesT<Graph> to_remove(graph_, nthreads);
+        std::vector<PairInfos> to_remove(nthreads);
 
         // FIXME: Replace with lambda
         ContradictionalRemover remover(to_remove, graph_, index_, max_repeat_length_);
@@ -190,19 +226,30 @@ class PairInfoImprover {
 
         DEBUG("ParallelRemoveContraditional: Threads finished");
 
-        DEBUG("Merging maps");
+        DEBUG("Merging removal lists");
         for (size_t i = 1; i < nthreads; ++i) {
-            to_remove[0].Merge(to_remove[i]);
-            to_remove[i].clear();
+            to_remove[0].insert(to_remove[0].end(), to_remove[i].begin(), to_remove[i].end());
+            PairInfos().swap(to_remove[i]);
         }
-        DEBUG("Resulting size " << to_remove[0].size());
+        PairInfos &infos = to_remove[0];
+        std::sort(infos.begin(), infos.end(),
+                  [](const auto &a, const auto &b) {
+                      return std::make_tuple(a.first, a.second, float(a.point.d)) <
+                             std::make_tuple(b.first, b.second, float(b.point.d));
+                  });
+        infos.erase(std::unique(infos.begin(), infos.end(),
+                                [](const auto &a, const auto &b) {
+                                    return a.first == b.first && a.second == b.second &&
+                                           float(a.point.d) == float(b.point.d);
+                                }),
+                    infos.end());
+        DEBUG("Resulting size " << infos.size());
 
         DEBUG("Deleting paired infos, liable to removing");
-        for (auto I = omnigraph::de::half_pair_begin(to_remove[0]);
-            I != omnigraph::de::half_pair_end(to_remove[0]); ++I) {
-            cnt += DeleteIfExist(I.first(), I.second(), *I);
-        }
-        to_remove[0].clear();
+        // Both the point and its conjugate are removed at once, so the repeated removal is a no-op
+        for (const auto &info : infos)
+            cnt += index_.Remove(info.first, info.second, info.point);
+        PairInfos().swap(infos);
 
         DEBUG("Size of index " << index_.size());
         DEBUG("ParallelRemoveContraditional: Clean finished");
@@ -260,16 +307,6 @@ class PairInfoImprover {
     }
 
   private:
-    size_t DeleteIfExist(EdgeId e1, EdgeId e2, const typename Index::HistProxy& infos) {
-        size_t cnt = 0;
-        for (auto point : infos) {
-            cnt += index_.Remove(e1, e2, point);
-            TRACE("cnt += " << cnt);
-        }
-
-        return cnt;
-    }
-
     const Graph& graph_;
     Index& index_;
     const io::SequencingLibrary<config::LibraryData>& lib_;
@@ -307,6 +307,15 @@ public:
         VERIFY(this->size() >= index_to_add.size());
     }
 
+    /**
+     * @brief Merges a histogram of inner (gapped) points between two edges into the index
+     *        together with its conjugate. Used for bulk loading of presorted buffers.
+     */
+    template<class OtherHist>
+    void MergeInner(EdgeId e1, EdgeId e2, const OtherHist &h) {
+        base::Merge(e1, e2, h);
+    }
+
     template<class Buffer>
     typename std::enable_if<std::is_convertible<typename Buffer::InnerMap, InnerMap>::value,
         void>::type MoveAssign(Buffer& from) {
@@ -0,0 +1,219 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "paired_info.hpp"
+
+#include "utils/filesystem/temporary.hpp"
+#include "utils/memory_limit.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/verify.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace omnigraph {
+
+namespace de {
+
+/**
+ * @brief Lock-free filling buffer for unclustered paired info.
+ *        Every thread appends raw (e1, e2, gap, weight) records into its own append-only buffer.
+ *        Buffers exceeding the memory budget are spilled to disk partitioned by the first edge
+ *        (if a working directory was provided). At the end records are sorted partition by
+ *        partition in parallel, collapsed into histograms and merged into the index in a single pass.
+ */
+template<class Graph>
+class ThreadLocalPairedBuffer {
+    typedef typename Graph::EdgeId EdgeId;
+    typedef std::pair<EdgeId, EdgeId> EdgePair;
+    typedef RawPointTraits::Gapped InnerPoint;
+    typedef Histogram<InnerPoint> InnerHistogram;
+
+    // Only the canonical edge pair of every conjugate pair is stored. Gap is invariant under conjugation.
+    struct Record {
+        uint64_t e1, e2;
+        InnerPoint p;
+
+        bool operator<(const Record &other) const {
+            return std::tie(e1, e2, p.d) < std::tie(other.e1, other.e2, other.p.d);
+        }
+    };
+
+    typedef std::vector<Record> RecordBuffer;
+
+    static constexpr size_t PARTITIONS = 64;
+    static constexpr size_t MIN_BUFFER_RECORDS = 1 << 16;
+    static constexpr size_t MAX_BUFFER_RECORDS = 1 << 24;
+
+public:
+    ThreadLocalPairedBuffer(const Graph &g, fs::TmpDir workdir = nullptr)
+            : graph_(g), workdir_(workdir), buffer_limit_(MAX_BUFFER_RECORDS),
+              spilled_(0), partition_locks_(PARTITIONS) {}
+
+    /**
+     * @brief Prepares per-thread buffers. Discards any records added so far.
+     */
+    void Init(size_t nthreads) {
+        clear();
+        buffers_.resize(nthreads);
+        // Final sort requires roughly the same amount of memory as buffers themselves
+        buffer_limit_ = utils::MemoryGovernor::instance().ItemCount(sizeof(Record), MAX_BUFFER_RECORDS,
+                                                                    MIN_BUFFER_RECORDS, 2 * nthreads);
+        DEBUG("Using paired info buffers of " << buffer_limit_ << " records");
+    }
+
+    void clear() {
+        buffers_.clear();
+        spills_.clear();
+        spilled_ = 0;
+    }
+
+    /**
+     * @brief Adds a point between two edges. Only the buffer of the given thread is touched.
+     */
+    void Add(size_t thread_id, EdgeId e1, EdgeId e2, RawPoint p) {
+        InnerPoint sp = RawPointTraits::Shrink(p, (DEDistance)graph_.length(e1));
+        EdgePair ep(e1, e2), conj(graph_.conjugate(e2), graph_.conjugate(e1));
+        if (conj < ep)
+            ep = conj;
+        buffers_[thread_id].push_back({ ep.first.int_id(), ep.second.int_id(), sp });
+    }
+
+    /**
+     * @brief Spills the buffer of the given thread to disk if it exceeds the memory budget.
+     *        Could be called concurrently for different threads.
+     */
+    void Flush(size_t thread_id) {
+        RecordBuffer &buffer = buffers_[thread_id];
+        if (!workdir_ || buffer.size() < buffer_limit_)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(spills_mutex_);
+            if (spills_.empty()) {
+                for (size_t i = 0; i < PARTITIONS; ++i)
+                    spills_.push_back(workdir_->tmp_file("paired_info"));
+            }
+        }
+
+        std::vector<size_t> offsets = Partition(buffer);
+        for (size_t i = 0; i < PARTITIONS; ++i) {
+            if (offsets[i] == offsets[i + 1])
+                continue;
+
+            std::lock_guard<std::mutex> lock(partition_locks_[i]);
+            std::ofstream os(spills_[i]->file(), std::ios::binary | std::ios::app);
+            os.write(reinterpret_cast<const char*>(buffer.data() + offsets[i]),
+                     (offsets[i + 1] - offsets[i]) * sizeof(Record));
+            VERIFY_MSG(os, "Failed to spill paired info into " << spills_[i]->file());
+        }
+
+#       pragma omp atomic
+        spilled_ += buffer.size();
+
+        RecordBuffer().swap(buffer);
+    }
+
+    /**
+     * @brief Sorts all the records and merges them into the index. Buffers are emptied.
+     */
+    template<class Index>
+    void MergeInto(Index &index) {
+        size_t records = spilled_;
+        std::vector<std::vector<size_t>> offsets(buffers_.size());
+#       pragma omp parallel for schedule(dynamic, 1) reduction(+:records)
+        for (size_t j = 0; j < buffers_.size(); ++j) {
+            offsets[j] = Partition(buffers_[j]);
+            records += buffers_[j].size();
+        }
+        INFO("Merging " << records << " paired info records (" << spilled_ << " spilled to disk)");
+
+        std::mutex index_lock;
+#       pragma omp parallel for schedule(dynamic, 1)
+        for (size_t i = 0; i < PARTITIONS; ++i) {
+            RecordBuffer partition = LoadSpilled(i);
+            for (size_t j = 0; j < buffers_.size(); ++j)
+                partition.insert(partition.end(),
+                                 buffers_[j].begin() + offsets[j][i], buffers_[j].begin() + offsets[j][i + 1]);
+            std::sort(partition.begin(), partition.end());
+
+            std::vector<std::pair<EdgePair, InnerHistogram>> hists;
+            for (auto it = partition.begin(); it != partition.end(); ) {
+                InnerHistogram hist;
+                auto next = it;
+                for (; next != partition.end() && next->e1 == it->e1 && next->e2 == it->e2; ++next)
+                    hist.merge_point(next->p);
+                hists.emplace_back(EdgePair(EdgeId(it->e1), EdgeId(it->e2)), std::move(hist));
+                it = next;
+            }
+            RecordBuffer().swap(partition);
+
+            // Index is not thread-safe, only histogram construction is done in parallel
+            std::lock_guard<std::mutex> lock(index_lock);
+            for (const auto &entry : hists)
+                index.MergeInner(entry.first.first, entry.first.second, entry.second);
+        }
+
+        clear();
+    }
+
+private:
+    static size_t PartitionOf(const Record &r) {
+        return r.e1 % PARTITIONS;
+    }
+
+    // Stable counting sort of buffer by partition. Returns the partition boundaries.
+    std::vector<size_t> Partition(RecordBuffer &buffer) const {
+        std::vector<size_t> offsets(PARTITIONS + 1, 0);
+        for (const auto &r : buffer)
+            offsets[PartitionOf(r) + 1] += 1;
+        for (size_t i = 0; i < PARTITIONS; ++i)
+            offsets[i + 1] += offsets[i];
+
+        RecordBuffer sorted(buffer.size());
+        std::vector<size_t> pos(offsets.begin(), offsets.end() - 1);
+        for (const auto &r : buffer)
+            sorted[pos[PartitionOf(r)]++] = r;
+        buffer.swap(sorted);
+
+        return offsets;
+    }
+
+    RecordBuffer LoadSpilled(size_t partition) const {
+        RecordBuffer res;
+        if (spills_.empty())
+            return res;
+
+        const std::string &fname = spills_[partition]->file();
+        std::ifstream is(fname, std::ios::binary | std::ios::ate);
+        if (!is)
+            return res;
+        res.resize(size_t(is.tellg()) / sizeof(Record));
+        is.seekg(0);
+        is.read(reinterpret_cast<char*>(res.data()), res.size() * sizeof(Record));
+        VERIFY_MSG(is, "Failed to read spilled paired info from " << fname);
+        return res;
+    }
+
+    const Graph &graph_;
+    fs::TmpDir workdir_;
+    size_t buffer_limit_;
+    std::vector<RecordBuffer> buffers_;
+    std::vector<fs::TmpFile> spills_;
+    size_t spilled_;
+    std::mutex spills_mutex_;
+    std::vector<std::mutex> partition_locks_;
+
+    DECL_LOGGER("ThreadLocalPairedBuffer");
+};
+
+} // namespace de
+
+} // namespace omnigraph
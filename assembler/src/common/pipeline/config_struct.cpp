@@ -739,6 +739,7 @@ void load_cfg(debruijn_config &cfg, boost::property_tree::ptree const &pt,
     load(cfg.use_intermediate_contigs, pt, "use_intermediate_contigs", complete);
     load(cfg.single_reads_rr, pt, "single_reads_rr", complete);
     load(cfg.min_edge_length_for_is_count, pt, "min_edge_length_for_is_count", complete);
+    load(cfg.is_count_tolerance, pt, "is_count_tolerance", false);
 
 
     load(cfg.preserve_raw_paired_index, pt, "preserve_raw_paired_index", complete);
@@ -472,6 +472,9 @@ struct debruijn_config {
     bool two_step_rr;
     bool use_intermediate_contigs;
     size_t min_edge_length_for_is_count;
+    // Insert size estimation stops once mean, deviation and percentiles change by less
+    // than this fraction between sampling rounds, 0 to use all reads
+    double is_count_tolerance;
 
     std::string hmm_set;
 
@@ -526,6 +529,7 @@ struct debruijn_config {
     bool need_mapping;
 
     debruijn_config() :
+            is_count_tolerance(0.005),
             use_single_reads(false) {
 
     }
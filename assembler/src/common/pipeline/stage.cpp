@@ -11,6 +11,7 @@
 #include "pipeline/stage.hpp"
 
 #include "utils/logger/log_writers.hpp"
+#include "utils/perf/timetracer.hpp"
 
 #include <algorithm>
 #include <cstring>
@@ -23,6 +24,7 @@ void AssemblyStage::load(debruijn_graph::conj_graph_pack& gp,
     if (!prefix) prefix = id_;
     auto dir = fs::append_path(load_from, prefix);
     INFO("Loading current state from " << dir);
+    TIME_TRACE_SCOPE(std::string("Load: ") + prefix, "checkpoint");
 
     io::ConvertIfNeeded(cfg::get_writable().ds.reads,
                         cfg::get().max_threads);
@@ -38,6 +40,7 @@ void AssemblyStage::save(const debruijn_graph::conj_graph_pack& gp,
     if (!prefix) prefix = id_;
     auto dir = fs::append_path(save_to, prefix);
     INFO("Saving current state to " << dir);
+    TIME_TRACE_SCOPE(std::string("Save: ") + prefix, "checkpoint");
     fs::remove_if_exists(dir);
     fs::make_dir(dir);
 
@@ -111,7 +114,10 @@ void CompositeStageBase::run(debruijn_graph::conj_graph_pack& gp,
         PhaseBase *phase = start_phase->get();
 
         INFO("PROCEDURE == " << phase->name());
-        phase->run(gp, started_from);
+        {
+            TIME_TRACE_SCOPE(phase->name(), "phase");
+            phase->run(gp, started_from);
+        }
 
         if (parent_->saves_policy().EnabledCheckpoints() != SavesPolicy::Checkpoints::None) {
             std::string composite_id(id());
@@ -164,8 +170,11 @@ void StageManager::run(debruijn_graph::conj_graph_pack& g,
         AssemblyStage *stage = start_stage->get();
 
         INFO("STAGE == " << stage->name());
-        stage->prepare(g, start_from);
-        stage->run(g, start_from);
+        {
+            TIME_TRACE_SCOPE(stage->name(), "stage");
+            stage->prepare(g, start_from);
+            stage->run(g, start_from);
+        }
         if (saves_policy_.EnabledCheckpoints() != SavesPolicy::Checkpoints::None) {
             auto prev_saves = saves_policy_.GetLastCheckpoint();
             stage->save(g, saves_policy_.SavesPath());
@@ -9,6 +9,7 @@
 #define NUCL_HPP_
 
 #include "utils/verify.hpp"
+#include "nucl_kernels.hpp"
 
 /**
  * 0123 -> true
@@ -37,23 +38,7 @@ static const char INVALID_NUCL = char(-1);
  * @return true if c is 'A/a/0', 'C/c/1', 'G/g/2', 'T/t/3'.
  */
 inline bool is_nucl(char c) {
-    switch (c) {
-        case 0:
-        case 'a':
-        case 'A':
-        case 1:
-        case 'c':
-        case 'C':
-        case 2:
-        case 'g':
-        case 'G':
-        case 3:
-        case 't':
-        case 'T':
-            return true;
-        default:
-            return false;
-    }
+    return nucl_kernels::code(c) != nucl_kernels::INVALID_CODE;
 }
 
 /**
@@ -132,27 +117,9 @@ inline char nucl(char c) {
  * @return A => 0, C => 1, G => 2, T => 3
  */
 inline char dignucl(char c) {
-    switch (c) {
-        case 0:
-        case 'a':
-        case 'A':
-            return 0;
-        case 1:
-        case 'c':
-        case 'C':
-            return 1;
-        case 2:
-        case 'g':
-        case 'G':
-            return 2;
-        case 3:
-        case 't':
-        case 'T':
-            return 3;
-        default:
-            VERIFY_DEV(false);
-            return INVALID_NUCL;
-    }
+    char res = char(nucl_kernels::code(c));
+    VERIFY_DEV(res != INVALID_NUCL);
+    return res;
 }
 
 #endif /* NUCL_HPP_ */
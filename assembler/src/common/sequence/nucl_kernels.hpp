@@ -0,0 +1,157 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "utils/verify.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Bulk routines for 2-bit packed nucleotides shared by Seq, RuntimeSeq and Sequence.
+ * Nucleotide i is stored in bits [2 * (i % TNucl), 2 * (i % TNucl) + 2) of word i / TNucl,
+ * TNucl = 4 * sizeof(T). Character conversion is table driven and branch free, reverse
+ * complement works on whole words.
+ */
+namespace nucl_kernels {
+
+static const uint8_t INVALID_CODE = 0xFF;
+
+struct CodeTable {
+    uint8_t codes[256];
+
+    constexpr CodeTable()
+            : codes() {
+        for (unsigned i = 0; i < 256; ++i)
+            codes[i] = INVALID_CODE;
+        const char *upper = "ACGT", *lower = "acgt";
+        for (uint8_t i = 0; i < 4; ++i) {
+            codes[i] = i;
+            codes[(unsigned char) upper[i]] = i;
+            codes[(unsigned char) lower[i]] = i;
+        }
+    }
+};
+
+static constexpr CodeTable CODE_TABLE{};
+
+/**
+ * ACGTacgt0123 -> 0123, anything else -> INVALID_CODE
+ */
+inline uint8_t code(char c) {
+    return CODE_TABLE.codes[(unsigned char) c];
+}
+
+/**
+ * @return true if all n symbols starting from s are 'A/a/0', 'C/c/1', 'G/g/2' or 'T/t/3'
+ */
+inline bool AllNucls(const char *s, size_t n) {
+    // Valid codes fit into two bits, so a single invalid symbol spoils the accumulator
+    uint8_t acc = 0;
+    for (size_t i = 0; i < n; ++i)
+        acc = uint8_t(acc | code(s[i]));
+    return acc < 4;
+}
+
+/**
+ * Packs n symbols (ACGT or 0123) of s starting from offset into ceil(n / TNucl) words of out.
+ * Unused high bits of the last word are zeroed. Symbols are not validated (except for the expensive
+ * checks build), invalid ones are packed as 'T', use AllNucls to check the input beforehand.
+ */
+template<typename T, typename S>
+void Pack(const S &s, size_t offset, size_t n, T *out) {
+    const size_t TNucl = sizeof(T) << 2;
+    size_t w = 0;
+    for (size_t i = 0; i < n; i += TNucl, ++w) {
+        size_t len = n - i < TNucl ? n - i : TNucl;
+        T data = 0;
+        for (size_t j = 0; j < len; ++j) {
+            uint8_t c = code(char(s[offset + i + j]));
+            VERIFY_DEV(c != INVALID_CODE);
+            data = T(data | (T(c & 3) << (j << 1)));
+        }
+        out[w] = data;
+    }
+}
+
+/**
+ * Same as Pack, but stores the reverse complement of the symbols.
+ */
+template<typename T, typename S>
+void PackRC(const S &s, size_t offset, size_t n, T *out) {
+    const size_t TNucl = sizeof(T) << 2;
+    size_t w = 0;
+    for (size_t i = 0; i < n; i += TNucl, ++w) {
+        size_t len = n - i < TNucl ? n - i : TNucl;
+        T data = 0;
+        for (size_t j = 0; j < len; ++j) {
+            uint8_t c = code(char(s[offset + n - 1 - i - j]));
+            VERIFY_DEV(c != INVALID_CODE);
+            data = T(data | (T((c & 3) ^ 3) << (j << 1)));
+        }
+        out[w] = data;
+    }
+}
+
+/**
+ * Reverse complement of a fully filled word
+ */
+inline uint64_t ReverseComplementWord(uint64_t w) {
+    w = ~w;
+    w = ((w >> 2) & 0x3333333333333333ull) | ((w & 0x3333333333333333ull) << 2);
+    w = ((w >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((w & 0x0F0F0F0F0F0F0F0Full) << 4);
+    return __builtin_bswap64(w);
+}
+
+inline uint32_t ReverseComplementWord(uint32_t w) {
+    w = ~w;
+    w = ((w >> 2) & 0x33333333u) | ((w & 0x33333333u) << 2);
+    w = ((w >> 4) & 0x0F0F0F0Fu) | ((w & 0x0F0F0F0Fu) << 4);
+    return __builtin_bswap32(w);
+}
+
+template<typename T>
+T ReverseComplementWord(T w) {
+    const size_t TNucl = sizeof(T) << 2;
+    T res = 0;
+    for (size_t j = 0; j < TNucl; ++j)
+        res = T(res | (T(((w >> (j << 1)) & 3) ^ 3) << ((TNucl - 1 - j) << 1)));
+    return res;
+}
+
+/**
+ * Writes the reverse complement of n packed nucleotides from src into ceil(n / TNucl) words of dst.
+ * Unused high bits of the last word are zeroed. src and dst should not overlap.
+ */
+template<typename T>
+void ReverseComplement(const T *src, size_t n, T *dst) {
+    const size_t TNucl = sizeof(T) << 2, TBits = sizeof(T) << 3;
+    size_t words = (n + TNucl - 1) / TNucl;
+    for (size_t i = 0; i < words; ++i)
+        dst[i] = ReverseComplementWord(src[words - 1 - i]);
+
+    // Padding 'A's of the last source word became leading 'T's, shift them out
+    size_t pad = ((words * TNucl - n) << 1);
+    if (pad == 0)
+        return;
+    for (size_t i = 0; i + 1 < words; ++i)
+        dst[i] = T((dst[i] >> pad) | (dst[i + 1] << (TBits - pad)));
+    dst[words - 1] = T(dst[words - 1] >> pad);
+}
+
+/**
+ * Writes n nucleotides starting from position from of packed src as ACGT characters
+ */
+template<typename T>
+void Unpack(const T *src, size_t from, size_t n, char *out) {
+    const size_t TNucl = sizeof(T) << 2;
+    static const char NUCLS[] = "ACGT";
+    for (size_t i = 0, pos = from; i < n; ++i, ++pos)
+        out[i] = NUCLS[(src[pos / TNucl] >> ((pos % TNucl) << 1)) & 3];
+}
+
+}
@@ -49,65 +49,9 @@ public:
      */
     const static size_t TNuclBits = log_<TNucl, 2>::value;
 
-    const static size_t Iterations = log_<TBits, 2>::value;
-
-    static const std::array<T, Iterations> ConstructLeftMasks() {
-        std::array<T, Iterations> result;
-        for (size_t i = 0; i < Iterations; i++) {
-            size_t shift = 1 << i;
-            T mask = T(T(1) << shift) - T(1);
-            result[i] = T(mask << shift);
-            for (size_t j = 0; j < i; j++) {
-                result[j] += T(result[j] << shift);
-            }
-        }
-        return result;
-    }
-
-    static const std::array<T, Iterations> ConstructRightMasks() {
-        std::array<T, Iterations> result(ConstructLeftMasks());
-        for (size_t i = 0; i < Iterations; i++) {
-            result[i] = T(~result[i]);
-        }
-        return result;
-    }
-
-
     RuntimeSeq<max_size_, T> FastRC() const {
-        const static std::array<T, Iterations> LeftMasks(ConstructLeftMasks());
-        const static std::array<T, Iterations> RightMasks(ConstructRightMasks());
-        const static size_t LogTSize = log_<sizeof(T), 2>::value + 3;
-
         RuntimeSeq<max_size_, T> res(this->size());
-
-        const size_t bit_size = size_ << 1;
-        const size_t extra = bit_size & ((1 << LogTSize) - 1);
-        const size_t to_extra = TBits - extra;
-        const size_t filled = bit_size >> LogTSize;
-        size_t real_length = filled;
-        if (extra == 0) {
-            for (size_t i = 0, j = filled - 1; i < filled; i++, j--) {
-                res.data_[i] = data_[j];
-            }
-        } else {
-            for (size_t i = 0, j = filled; i < filled && j > 0; i++, j--) {
-                res.data_[i] = (data_[j] << to_extra) + (data_[j - 1] >> extra);
-            }
-            res.data_[filled] = (data_[0] << to_extra);
-            real_length++;
-        }
-
-        for (size_t i = 0; i < real_length; i++) {
-            res.data_[i] = res.data_[i] ^ T(-1);
-            for (size_t it = 1; it < Iterations; it++) {
-                size_t shift = 1 << it;
-                res.data_[i] = T((res.data_[i] & LeftMasks[it]) >> shift) ^ T((res.data_[i] & RightMasks[it]) << shift);
-            }
-        }
-
-        if (extra != 0) {
-            res.data_[real_length - 1] = (res.data_[real_length - 1] & ((T(1) << extra) - 1));
-        }
+        nucl_kernels::ReverseComplement(data_.data(), size_, res.data_.data());
         return res;
     }
 
@@ -161,27 +105,10 @@ private:
      * @param s C-string (ACGT chars only), strlen(s) = size_
      */
     void init(const char *s) {
-        T data = 0;
-        size_t cnt = 0;
-        size_t cur = 0;
-        for (size_t pos = 0; pos < size_; ++pos, ++s) { // unsafe!
-            // VERIFY(is_nucl(*s)); // for performance
-            data = data | ((T) dignucl(*s) << cnt);
-            cnt += 2;
-            if (cnt == TBits) {
-                this->data_[cur++] = data;
-                cnt = 0;
-                data = 0;
-            }
-        }
-        if (cnt != 0) {
-            this->data_[cur++] = data;
-        }
-
-        for (; cur < DataSize; ++cur)
-            this->data_[cur] = 0;
-
-        VERIFY(*s == 0); // C-string always ends on 0
+        // VERIFY(is_nucl(*s)); // for performance
+        std::fill(data_.begin(), data_.end(), 0);
+        nucl_kernels::Pack(s, 0, size_, data_.data());
+        VERIFY(s[size_] == 0); // C-string always ends on 0
     }
 
     /**
@@ -290,40 +217,9 @@ public:
         VERIFY(size_ == 0 || is_dignucl(s[0]) || is_nucl(s[0]));
         VERIFY(offset + size_ <= this->size(s));
 
-        // which symbols does our string contain : 0123 or ACGT?
-        bool digit_str = size_ == 0 || is_dignucl(s[0]);
-
-        // we fill everything with zeros (As) by default.
+        // 0123 and ACGT strings are handled alike, everything beyond size_ is filled with As
         std::fill(data_.begin(), data_.end(), 0);
-
-        // data -- one temporary variable corresponding to the i-th array element
-        // and some counters
-        T data = 0;
-        size_t cnt = 0;
-        size_t cur = 0;
-
-        for (size_t i = 0; i < size_; ++i) {
-            //VERIFY(is_dignucl(s[i]) || is_nucl(s[i]));
-
-            // we fill everything with zeros (As) by default.
-            char c = (char) (digit_str ? s[offset + i] : dignucl(s[offset + i]));
-
-            data = data | (T(c) << cnt);
-            cnt += 2;
-
-            if (cnt == TBits) {
-                this->data_[cur++] = data;
-                cnt = 0;
-                data = 0;
-            }
-        }
-
-        if (cnt != 0) {
-            this->data_[cur++] = data;
-        }
-
-        for (; cur < DataSize; ++cur)
-            this->data_[cur] = 0;
+        nucl_kernels::Pack(s, offset, size_, data_.data());
     }
 
     RuntimeSeq start(size_t K) const {
@@ -109,23 +109,9 @@ private:
      * @param s C-string (ACGT chars only), strlen(s) = size_
      */
     void init(const char *s) {
-        T data = 0;
-        size_t cnt = 0;
-        int cur = 0;
-        for (size_t pos = 0; pos != size_; ++pos, ++s) { // unsafe!
-            // VERIFY(is_nucl(*s)); // for performance
-            data = data | (T) ((T) dignucl(*s) << cnt);
-            cnt += 2;
-            if (cnt == TBits) {
-                this->data_[cur++] = data;
-                cnt = 0;
-                data = 0;
-            }
-        }
-        if (cnt != 0) {
-            this->data_[cur++] = data;
-        }
-        VERIFY(*s == 0); // C-string always ends on 0
+        // VERIFY(is_nucl(*s)); // for performance
+        nucl_kernels::Pack(s, 0, size_, data_.data());
+        VERIFY(s[size_] == 0); // C-string always ends on 0
     }
 
     // Template voodoo to calculate the length of the string regardless whether it is std::string or const char*
@@ -183,34 +169,9 @@ public:
         if (!raw)
             VERIFY(offset + number_to_read <= this->size(s));
 
-        // which symbols does our string contain : 0123 or ACGT?
-        bool digit_str = is_dignucl(s[offset]);
-
-        // data -- one temporary variable corresponding to the i-th array element
-        // and some counters
-        T data = 0;
-        size_t cnt = 0;
-        size_t cur = 0;
-
-        for (size_t i = 0; i < number_to_read; ++i) {
-            //VERIFY(is_dignucl(s[i]) || is_nucl(s[i]));
-
-            // we fill everything with zeros (As) by default.
-            char c = digit_str ? s[offset + i] : (char) dignucl(s[offset + i]);
-
-            data = data | (T(c) << cnt);
-            cnt += 2;
-
-            if (cnt == TBits) {
-                this->data_[cur++] = data;
-                cnt = 0;
-                data = 0;
-            }
-        }
-
-        if (cnt != 0) {
-            this->data_[cur++] = data;
-        }
+        // 0123 and ACGT strings are handled alike, everything beyond number_to_read is filled with As
+        size_t cur = (number_to_read + TNucl - 1) >> TNuclBits;
+        nucl_kernels::Pack(s, offset, number_to_read, data_.data());
 
         for (; cur != DataSize; ++cur)
             this->data_[cur] = 0;
@@ -234,16 +195,7 @@ public:
      */
     Seq<size_, T> operator!() const {
         Seq<size_, T> res(*this);
-        for (size_t i = 0; i < (size_ >> 1); ++i) {
-            T front = complement(res[i]);
-            T end = complement(res[size_ - 1 - i]);
-            res.set(i, (char) end);
-            res.set(size_ - 1 - i, (char) front);
-        }
-        if ((size_ & 1) == 1) {
-            res.set(size_ >> 1, complement(res[size_ >> 1]));
-        }
-        // can be made without complement calls, but with xor on all bytes afterwards.
+        nucl_kernels::ReverseComplement(data_.data(), size_, res.data_.data());
         return res;
     }
 
@@ -71,49 +71,13 @@ class Sequence {
 
         VERIFY(is_dignucl(s[0]) || is_nucl(s[0]));
 
-        // Which symbols does our string contain : 0123 or ACGT?
-        bool digit_str = is_dignucl(s[0]);
-
-        // data -- one temporary variable corresponding to the i-th array element
-        // and some counters
-        ST data = 0;
-        size_t cnt = 0;
-        size_t cur = 0;
-
-        if (rc) {
-            for (int i = (int) size_ - 1; i >= 0; --i) {
-                //VERIFY(is_dignucl(s[i]) || is_nucl(s[i]));
-                char c = complement(digit_str ? s[(unsigned) i] : dignucl(s[(unsigned) i]));
-
-                data = data | (ST(c) << cnt);
-                cnt += 2;
-
-                if (cnt == STBits) {
-                    bytes[cur++] = data;
-                    cnt = 0;
-                    data = 0;
-                }
-            }
-        } else {
-            for (size_t i = 0; i < size_; ++i) {
-                //VERIFY(is_dignucl(s[i]) || is_nucl(s[i]));
-                char c = digit_str ? s[i] : dignucl(s[i]);
-
-                data = data | (ST(c) << cnt);
-                cnt += 2;
-
-                if (cnt == STBits) {
-                    bytes[cur++] = data;
-                    cnt = 0;
-                    data = 0;
-                }
-            }
-        }
-
-        if (cnt != 0)
-            bytes[cur++] = data;
+        // 0123 and ACGT strings are handled alike
+        if (rc)
+            nucl_kernels::PackRC(s, 0, size_, bytes);
+        else
+            nucl_kernels::Pack(s, 0, size_, bytes);
 
-        for (; cur < bytes_size; ++cur)
+        for (size_t cur = DataSize(size_); cur < bytes_size; ++cur)
             bytes[cur] = 0;
     }
 
@@ -372,6 +336,10 @@ Sequence Sequence::operator+(const Sequence &s) const {
 
 std::string Sequence::str() const {
     std::string res(size_, '-');
+    if (!rtl_) {
+        nucl_kernels::Unpack(data_->data(), from_, size_, &res[0]);
+        return res;
+    }
     for (size_t i = 0; i < size_; ++i) {
         res[i] = nucl(this->operator[](i));
     }
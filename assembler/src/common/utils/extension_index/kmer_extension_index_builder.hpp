@@ -7,6 +7,7 @@
 #pragma once
 
 #include "kmer_extension_index.hpp"
+#include "kpomer_kmer_counter.hpp"
 
 #include "utils/kmer_mph/kmer_index_builder.hpp"
 #include "utils/kmer_mph/kmer_splitters.hpp"
@@ -44,10 +45,16 @@ public:
     template<class Index>
     void FillExtensionsFromIndex(const std::string &KPlusOneMersFilename,
                                  Index &index) const {
+        typename Index::kmer_iterator it(KPlusOneMersFilename,
+                                         RtSeq::GetDataSize(index.k() + 1));
+        FillExtensionsFromIndex(it, index);
+    }
+
+    template<class Index>
+    void FillExtensionsFromIndex(typename Index::kmer_iterator &it,
+                                 Index &index) const {
         unsigned KPlusOne = index.k() + 1;
 
-        typename Index::kmer_iterator it(KPlusOneMersFilename,
-                                         RtSeq::GetDataSize(KPlusOne));
         for (; it.good(); ++it) {
             RtSeq kpomer(KPlusOne, *it);
 
@@ -86,20 +93,28 @@ public:
         VERIFY(counter.k() == index.k() + 1);
 
         // Now, count unique k-mers from k+1-mers
-        DeBruijnKMerKMerSplitter<StoringTypeFilter<typename Index::storing_type> >
-                splitter(workdir, index.k(),
-                         index.k() + 1, Index::storing_type::IsInvertable(), read_buffer_size);
+        std::vector<std::string> kpomer_files;
         for (unsigned i = 0; i < counter.num_buckets(); ++i)
-            splitter.AddKMers(counter.GetMergedKMersFname(i));
-        KMerDiskCounter<RtSeq> counter2(workdir, splitter);
+            kpomer_files.push_back(counter.GetMergedKMersFname(i));
+        KPOMerKMerCounter<StoringTypeFilter<typename Index::storing_type>>
+                counter2(workdir, index.k(), kpomer_files,
+                         Index::storing_type::IsInvertable(), read_buffer_size);
 
         BuildIndex(index, counter2, 16, nthreads);
 
-        // Build the kmer extensions
+        // Build the kmer extensions. Buckets are split into chunks to balance the load
         INFO("Building k-mer extensions from k+1-mers");
-#       pragma omp parallel for num_threads(nthreads)
-        for (unsigned i = 0; i < nthreads; ++i)
-            FillExtensionsFromIndex(counter.GetMergedKMersFname(i), index);
+        std::vector<std::pair<size_t, std::pair<size_t, size_t>>> chunks;
+        for (size_t i = 0; i < kpomer_files.size(); ++i) {
+            for (const auto &chunk : io::kmer_file_chunks<RtSeq>(kpomer_files[i], index.k() + 1, 4 * nthreads))
+                chunks.emplace_back(i, chunk);
+        }
+#       pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            typename Index::kmer_iterator it = io::make_kmer_iterator<RtSeq>(kpomer_files[chunks[i].first],
+                                                                             index.k() + 1, chunks[i].second);
+            FillExtensionsFromIndex(it, index);
+        }
         INFO("Building k-mer extensions from k+1-mers finished.");
     }
 
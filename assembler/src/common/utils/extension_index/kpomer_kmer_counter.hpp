@@ -0,0 +1,214 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "utils/kmer_mph/kmer_index_builder.hpp"
+#include "io/kmers/kmer_iterator.hpp"
+#include "utils/memory_limit.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+
+#include <mutex>
+
+namespace utils {
+
+/**
+ * @brief Counts k-mers of the set of sorted (k+1)-mer buckets.
+ *        (k+1)-mer buckets are split into chunks processed with work stealing. Every thread
+ *        collects k-mers (filtered the same way as DeBruijnKMerKMerSplitter does) into its own
+ *        per-bucket buffers and dumps them as sorted unique runs on its own, without waiting
+ *        for the rest of threads. Runs of every bucket are then merged directly into the final
+ *        bucket file, so there is no intermediate per-thread unique k-mer files to concatenate.
+ */
+template<class KmerFilter>
+class KPOMerKMerCounter : public KMerCounter<RtSeq> {
+    typedef KMerCounter<RtSeq> __super;
+    typedef typename __super::RawKMerStorage BucketStorage;
+    typedef adt::KMerVector<RtSeq> KMerBuffer;
+    typedef io::raw_kmer_iterator<RtSeq> kpomer_iterator;
+
+    static constexpr size_t MIN_CELL_SIZE = 16384;
+    static constexpr size_t MAX_CELL_SIZE = 1 << 22;
+    static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+public:
+    KPOMerKMerCounter(fs::TmpDir work_dir, unsigned k,
+                      std::vector<std::string> kpomer_files,
+                      bool add_rc, size_t buffer_size = 0)
+            : work_dir_(work_dir), k_(k),
+              kpomer_files_(std::move(kpomer_files)), add_rc_(add_rc),
+              buffer_size_(buffer_size) {
+        kmer_prefix_ = work_dir_->tmp_file("kmers");
+    }
+
+    unsigned k() const { return k_; }
+
+    size_t kmer_size() const override {
+        return RtSeq::GetDataSize(k_) * sizeof(RtSeq::DataType);
+    }
+
+    std::unique_ptr<BucketStorage> GetBucket(size_t idx, bool unlink = true) override {
+        VERIFY_MSG(this->counted_, "k-mers were not counted yet");
+        return std::unique_ptr<BucketStorage>(new BucketStorage(GetMergedKMersFname((unsigned)idx),
+                                                                RtSeq::GetDataSize(k_), unlink));
+    }
+
+    size_t Count(unsigned num_buckets, unsigned num_threads) override {
+        this->num_buckets_ = num_buckets;
+
+        INFO("Splitting k+1-mers from " << kpomer_files_.size() << " files into "
+             << num_buckets << " k-mer buckets using " << num_threads << " threads");
+        std::vector<std::vector<size_t>> runs = Split(num_buckets, num_threads);
+
+        INFO("Merging k-mer runs");
+        size_t kmers = 0;
+#       pragma omp parallel for num_threads(num_threads) schedule(dynamic) reduction(+:kmers)
+        for (unsigned i = 0; i < num_buckets; ++i) {
+            std::string ofname = GetMergedKMersFname(i);
+            // Make sure the bucket exists even if nothing was dumped there
+            std::ofstream(ofname, std::ios::out | std::ios::binary);
+            if (runs[i].empty())
+                continue;
+
+            MMappedRecordArrayReader<RtSeq::DataType> ins(GetRawKMersFname(i), RtSeq::GetDataSize(k_), /* unlink */ true);
+            kmers += MergeKMerRuns<RtSeq>(ins, runs[i], k_, ofname);
+        }
+        INFO("K-mer counting done. There are " << kmers << " kmers in total. ");
+        if (!kmers) {
+            FATAL_ERROR("No kmers were extracted from k+1-mers. Check the read lengths and k-mer length settings");
+            exit(-1);
+        }
+
+        this->kmers_ = kmers;
+        this->counted_ = true;
+
+        return kmers;
+    }
+
+    void MergeBuckets() override {
+        INFO("Merging final buckets.");
+
+        final_kmers_ = work_dir_->tmp_file("final_kmers");
+        std::ofstream ofs(*final_kmers_, std::ios::out | std::ios::binary);
+        for (unsigned j = 0; j < this->num_buckets_; ++j) {
+            auto bucket = GetBucket(j, /* unlink */ true);
+            ofs.write((const char*)bucket->data(), bucket->data_size());
+        }
+        ofs.close();
+    }
+
+    size_t CountAll(unsigned num_buckets, unsigned num_threads, bool merge = true) override {
+        size_t kmers = Count(num_buckets, num_threads);
+        if (merge)
+            MergeBuckets();
+
+        return kmers;
+    }
+
+    std::string GetMergedKMersFname(unsigned suffix) const {
+        return kmer_prefix_->file() + ".merged." + std::to_string(suffix);
+    }
+
+    fs::TmpFile final_kmers_file() {
+        VERIFY_MSG(this->final_kmers_, "k-mers were not counted yet");
+        return final_kmers_;
+    }
+
+private:
+    std::string GetRawKMersFname(unsigned suffix) const {
+        return kmer_prefix_->file() + ".raw." + std::to_string(suffix);
+    }
+
+    // Returns sizes of sorted runs dumped into every raw bucket file
+    std::vector<std::vector<size_t>> Split(unsigned num_buckets, unsigned num_threads) {
+        // Chunks are listed up front, but opened only when processed
+        std::vector<std::pair<size_t, std::pair<size_t, size_t>>> chunks;
+        for (size_t i = 0; i < kpomer_files_.size(); ++i) {
+            for (const auto &chunk : io::kmer_file_chunks<RtSeq>(kpomer_files_[i], k_ + 1,
+                                                                 num_threads * CHUNKS_PER_THREAD))
+                chunks.emplace_back(i, chunk);
+        }
+
+        size_t cell_size = buffer_size_ ?
+                           std::max(MIN_CELL_SIZE, buffer_size_ / (num_buckets * kmer_size())) :
+                           utils::MemoryGovernor::instance().ItemCount(kmer_size(), MAX_CELL_SIZE, MIN_CELL_SIZE,
+                                                                       2 * num_threads * num_buckets);
+        DEBUG("Using cell size of " << cell_size);
+
+        std::vector<std::vector<size_t>> runs(num_buckets);
+        std::vector<std::mutex> locks(num_buckets);
+        std::vector<std::vector<KMerBuffer>> buffers(num_threads,
+                                                     std::vector<KMerBuffer>(num_buckets, KMerBuffer(k_, cell_size)));
+        auto dump = [&](unsigned bucket, KMerBuffer &buffer) {
+            libcxx::sort(buffer.begin(), buffer.end(), KMerBuffer::less2_fast());
+            size_t cnt = std::unique(buffer.begin(), buffer.end(), KMerBuffer::equal_to()) - buffer.begin();
+
+            std::lock_guard<std::mutex> lock(locks[bucket]);
+            std::string fname = GetRawKMersFname(bucket);
+            FILE *f = fopen(fname.c_str(), "ab");
+            if (!f)
+                FATAL_ERROR("Cannot open temporary file " << fname << " for writing");
+            size_t res = fwrite(buffer.data(), buffer.el_data_size(), cnt, f);
+            if (res != cnt)
+                FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
+            fclose(f);
+            runs[bucket].push_back(cnt);
+
+            buffer.clear();
+        };
+
+        KmerFilter filter;
+        RtSeq::hash hasher;
+        size_t processed = 0;
+#       pragma omp parallel for num_threads(num_threads) schedule(dynamic) reduction(+:processed)
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            auto &local = buffers[omp_get_thread_num()];
+            auto push = [&](const RtSeq &kmer) {
+                if (!filter.filter(kmer))
+                    return;
+                unsigned bucket = unsigned(hasher(kmer) % num_buckets);
+                KMerBuffer &buffer = local[bucket];
+                buffer.push_back(kmer);
+                if (buffer.size() >= cell_size)
+                    dump(bucket, buffer);
+            };
+
+            kpomer_iterator it = io::make_kmer_iterator<RtSeq>(kpomer_files_[chunks[c].first], k_ + 1,
+                                                               chunks[c].second);
+            for (; it.good(); ++it) {
+                RtSeq kpomer(k_ + 1, *it);
+                RtSeq prefix(k_, kpomer), suffix(k_, kpomer << 0);
+                push(prefix);
+                push(suffix);
+                if (add_rc_) {
+                    push(!prefix);
+                    push(!suffix);
+                }
+                processed += 1;
+            }
+        }
+
+#       pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+        for (size_t i = 0; i < size_t(num_threads) * num_buckets; ++i) {
+            KMerBuffer &buffer = buffers[i / num_buckets][i % num_buckets];
+            if (buffer.size())
+                dump(unsigned(i % num_buckets), buffer);
+        }
+        INFO("Used " << processed << " k+1-mers");
+
+        return runs;
+    }
+
+    fs::TmpDir work_dir_;
+    unsigned k_;
+    std::vector<std::string> kpomer_files_;
+    bool add_rc_;
+    size_t buffer_size_;
+    fs::TmpFile kmer_prefix_;
+    fs::TmpFile final_kmers_;
+};
+
+}
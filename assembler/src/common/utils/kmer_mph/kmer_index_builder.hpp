@@ -18,6 +18,7 @@
 #include "utils/filesystem/path_helper.hpp"
 
 #include "utils/memory_limit.hpp"
+#include "utils/perf/timetracer.hpp"
 #include "utils/filesystem/file_limit.hpp"
 
 #include "adt/iterator_range.hpp"
@@ -80,6 +81,74 @@ public:
   DECL_LOGGER("K-mer Counting");
 };
 
+// Merges sorted runs of k-mers stored one after another in ins (run sizes are given in runs),
+// appends unique k-mers to ofname. Returns the number of unique k-mers.
+template<class Seq>
+size_t MergeKMerRuns(MMappedRecordArrayReader<typename Seq::DataType> &ins,
+                     const std::vector<size_t> &runs,
+                     unsigned k, const std::string &ofname) {
+  // Prepare runs
+  std::vector<adt::iterator_range<decltype(ins.begin())>> ranges;
+  auto beg = ins.begin();
+  for (size_t sz : runs) {
+    auto end = std::next(beg, sz);
+    ranges.push_back(adt::make_range(beg, end));
+    VERIFY(std::is_sorted(beg, end, adt::array_less<typename Seq::DataType>()));
+    beg = end;
+  }
+
+  // Construct tree on top entries of runs
+  adt::loser_tree<decltype(beg),
+          adt::array_less<typename Seq::DataType>> tree(ranges);
+
+  if (tree.empty()) {
+    FILE *g = fopen(ofname.c_str(), "ab");
+    if (!g)
+      FATAL_ERROR("Cannot open temporary file " << ofname << " for writing");
+    fclose(g);
+    return 0;
+  }
+
+  // Write it down!
+  adt::KMerVector<Seq> buf(k, 1024*1024);
+  auto pval = tree.pop();
+  size_t total = 0;
+  while (!tree.empty()) {
+      buf.clear();
+      for (size_t cnt = 0; cnt < buf.capacity() && !tree.empty(); ) {
+          auto cval = tree.pop();
+          if (!adt::array_equal_to<typename Seq::DataType>()(pval, cval)) {
+              buf.push_back(pval);
+              pval = cval;
+              cnt += 1;
+          }
+      }
+      total += buf.size();
+
+      FILE *g = fopen(ofname.c_str(), "ab");
+      if (!g)
+        FATAL_ERROR("Cannot open temporary file " << ofname << " for writing");
+      size_t res = fwrite(buf.data(), buf.el_data_size(), buf.size(), g);
+      if (res != buf.size())
+        FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
+      fclose(g);
+  }
+
+  // Handle very last value
+  {
+    FILE *g = fopen(ofname.c_str(), "ab");
+    if (!g)
+      FATAL_ERROR("Cannot open temporary file " << ofname << " for writing");
+    size_t res = fwrite(pval.data(), pval.data_size(), 1, g);
+    if (res != 1)
+      FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
+    fclose(g);
+    total += 1;
+  }
+
+  return total;
+}
+
 template<class Seq, class traits = kmer_index_traits<Seq> >
 class KMerDiskCounter : public KMerCounter<Seq> {
   typedef KMerCounter<Seq, traits> __super;
@@ -115,9 +184,13 @@ public:
 
     // Split k-mers into buckets.
     INFO("Splitting kmer instances into " << num_files << " files using " << num_threads << " threads. This might take a while.");
-    auto raw_kmers = splitter_.Split(num_files, num_threads);
+    auto raw_kmers = [&] {
+      TIME_TRACE_SCOPE("K-mer splitting", "kmers");
+      return splitter_.Split(num_files, num_threads);
+    }();
 
     INFO("Starting k-mer counting.");
+    TIME_TRACE_SCOPE("K-mer counting", "kmers");
     size_t kmers = 0;
 #   pragma omp parallel for shared(raw_kmers) num_threads(num_threads) schedule(dynamic) reduction(+:kmers)
     for (unsigned i = 0; i < raw_kmers.size(); ++i) {
@@ -193,69 +266,9 @@ private:
     if (FILE *f = fopen(IdxFileName.c_str(), "rb")) {
       fclose(f);
       MMappedRecordReader<size_t> index(ifname + ".idx", true, -1ULL);
+      std::vector<size_t> runs(index.begin(), index.end());
 
-      // INFO("Total runs: " << index.size());
-
-      // Prepare runs
-      std::vector<adt::iterator_range<decltype(ins.begin())>> ranges;
-      auto beg = ins.begin();
-      for (size_t sz : index) {
-        auto end = std::next(beg, sz);
-        ranges.push_back(adt::make_range(beg, end));
-        VERIFY(std::is_sorted(beg, end, adt::array_less<typename Seq::DataType>()));
-        beg = end;
-      }
-
-      // Construct tree on top entries of runs
-      adt::loser_tree<decltype(beg),
-              adt::array_less<typename Seq::DataType>> tree(ranges);
-
-      if (tree.empty()) {
-        FILE *g = fopen(ofname.c_str(), "ab");
-        if (!g)
-          FATAL_ERROR("Cannot open temporary file " << ofname << " for writing");
-        fclose(g);
-        return 0;
-      }
-
-      // Write it down!
-      adt::KMerVector<Seq> buf(k_, 1024*1024);
-      auto pval = tree.pop();
-      size_t total = 0;
-      while (!tree.empty()) {
-          buf.clear();
-          for (size_t cnt = 0; cnt < buf.capacity() && !tree.empty(); ) {
-              auto cval = tree.pop();
-              if (!adt::array_equal_to<typename Seq::DataType>()(pval, cval)) {
-                  buf.push_back(pval);
-                  pval = cval;
-                  cnt += 1;
-              }
-          }
-          total += buf.size();
-
-          FILE *g = fopen(ofname.c_str(), "ab");
-          if (!g)
-            FATAL_ERROR("Cannot open temporary file " << ofname << " for writing");
-          size_t res = fwrite(buf.data(), buf.el_data_size(), buf.size(), g);
-          if (res != buf.size())
-            FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
-          fclose(g);
-      }
-
-      // Handle very last value
-      {
-        FILE *g = fopen(ofname.c_str(), "ab");
-        if (!g)
-          FATAL_ERROR("Cannot open temporary file " << ofname << " for writing");
-        size_t res = fwrite(pval.data(), pval.data_size(), 1, g);
-        if (res != 1)
-          FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
-        fclose(g);
-        total += 1;
-      }
-
-      return total;
+      return MergeKMerRuns<Seq>(ins, runs, k_, ofname);
     } else {
       // Sort the stuff
       libcxx::sort(ins.begin(), ins.end(), adt::array_less<typename Seq::DataType>());
@@ -312,6 +325,7 @@ size_t KMerIndexBuilder<Index>::BuildIndex(Index &index, KMerCounter<Seq> &count
   index.index_ = new typename KMerIndex<kmer_index_traits>::KMerDataIndex[buckets];
 
   INFO("Building perfect hash indices");
+  TIME_TRACE_SCOPE("MPHF construction", "kmers");
 
 # pragma omp parallel for shared(index) num_threads(num_threads_)
   for (unsigned i = 0; i < buckets; ++i) {
@@ -12,6 +12,7 @@
 #include "utils/filesystem/file_limit.hpp"
 #include "utils/filesystem/temporary.hpp"
 #include "utils/memory_limit.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
 #include <libcxx/sort.hpp>
 
@@ -54,18 +55,22 @@ public:
     using typename KMerSplitter<Seq>::RawKMers;
 
     KMerSortingSplitter(const std::string &work_dir, unsigned K, uint32_t seed = 0)
-            : KMerSplitter<Seq>(work_dir, K, seed), cell_size_(0), num_files_(0) {}
+            : KMerSplitter<Seq>(work_dir, K, seed), cell_size_(0), num_files_(0), sort_memory_(0) {}
 
     KMerSortingSplitter(fs::TmpDir work_dir, unsigned K, uint32_t seed = 0)
-            : KMerSplitter<Seq>(work_dir, K, seed), cell_size_(0), num_files_(0) {}
+            : KMerSplitter<Seq>(work_dir, K, seed), cell_size_(0), num_files_(0), sort_memory_(0) {}
 
 protected:
     using SeqKMerVector = adt::KMerVector<Seq>;
+    static constexpr size_t MIN_CELL_SIZE = 16384;
     using KMerBuffer = std::vector<SeqKMerVector>;
 
     std::vector<KMerBuffer> kmer_buffers_;
     size_t cell_size_;
     size_t num_files_;
+    utils::MemoryReservation buffers_memory_;
+    // Part of buffers_memory_ kept for the sort buffers
+    size_t sort_memory_;
 
     RawKMers PrepareBuffers(size_t num_files, unsigned nthreads, size_t reads_buffer_size) {
         num_files_ = num_files;
@@ -84,15 +89,17 @@ protected:
         }
 
         if (reads_buffer_size == 0) {
-            reads_buffer_size = 536870912ull;
-            size_t mem_limit =  (size_t)((double)(utils::get_free_memory()) / (nthreads * 3));
-            INFO("Memory available for splitting buffers: " << (double)mem_limit / 1024.0 / 1024.0 / 1024.0 << " Gb");
-            reads_buffer_size = std::min(reads_buffer_size, mem_limit);
+            // Per-thread buffers are accompanied by a sort buffer of the same size during dump,
+            // keep some room for the rest
+            buffers_memory_ = utils::MemoryGovernor::instance().Reserve(536870912ull * nthreads * 3);
+            reads_buffer_size = buffers_memory_.size() / (nthreads * 3);
+            sort_memory_ = buffers_memory_.size() - reads_buffer_size * nthreads;
+            INFO("Memory available for splitting buffers: " << (double)reads_buffer_size / 1024.0 / 1024.0 / 1024.0 << " Gb");
         }
         cell_size_ = reads_buffer_size / (num_files_ * this->kmer_size());
         // Set sane minimum cell size
-        if (cell_size_ < 16384)
-            cell_size_ = 16384;
+        if (cell_size_ < MIN_CELL_SIZE)
+            cell_size_ = MIN_CELL_SIZE;
 
         INFO("Using cell size of " << cell_size_);
         kmer_buffers_.resize(nthreads);
@@ -109,13 +116,32 @@ protected:
 
         size_t idx = this->GetFileNumForSeq(seq, (unsigned)num_files_);
         entry[idx].push_back(seq);
-        return entry[idx].size() > cell_size_;
+        size_t size = entry[idx].size();
+        // Spill early if we are running out of memory
+        return size > cell_size_ ||
+               (size % MIN_CELL_SIZE == 0 && utils::MemoryGovernor::instance().under_pressure());
     }
 
     void DumpBuffers(const RawKMers &ostreams) {
         VERIFY(ostreams.size() == num_files_ && kmer_buffers_[0].size() == num_files_);
 
-#   pragma omp parallel for
+        // Every file is sorted in a separate buffer collected from all the threads
+        size_t sort_buffer_size = 0;
+        for (unsigned k = 0; k < num_files_; ++k) {
+            size_t sz = 0;
+            for (const auto &entry : kmer_buffers_)
+                sz += entry[k].size();
+            sort_buffer_size = std::max(sort_buffer_size, sz * this->kmer_size());
+        }
+        // Filled k-mer buffers are already counted both as used and as reserved memory, so the
+        // sort buffers are sized from the part of the reservation kept for them instead
+        unsigned nthreads = (unsigned)omp_get_max_threads();
+        if (sort_buffer_size) {
+            size_t budget = sort_memory_ + utils::MemoryGovernor::instance().available();
+            nthreads = (unsigned)std::max<size_t>(1, std::min<size_t>(nthreads, budget / sort_buffer_size));
+        }
+
+#   pragma omp parallel for num_threads(nthreads)
         for (unsigned k = 0; k < num_files_; ++k) {
             // Below k is thread id!
 
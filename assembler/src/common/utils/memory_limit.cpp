@@ -6,6 +6,7 @@
 
 #include "memory_limit.hpp"
 
+#include "utils/perf/memory.hpp"
 #include "utils/logger/logger.hpp"
 #include "utils/verify.hpp"
 
@@ -27,6 +28,10 @@
 
 #include <common/utils/logger/logger.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <unistd.h>
+
 namespace utils {
 
 void limit_memory(size_t limit) {
@@ -101,12 +106,104 @@ size_t get_used_memory() {
         return cmem;
     }
 #else
-    return get_max_rss();
+    // ru_maxrss is in kilobytes
+    return get_max_rss() * 1024;
 #endif
 }
 
 size_t get_free_memory() {
-    return get_memory_limit() - get_used_memory();
+    size_t limit = get_memory_limit(), used = get_used_memory();
+    return limit > used ? limit - used : 0;
+}
+
+MemoryReservation &MemoryReservation::operator=(MemoryReservation &&other) {
+    if (this != &other) {
+        reset();
+        std::swap(size_, other.size_);
+    }
+    return *this;
+}
+
+void MemoryReservation::reset() {
+    if (size_)
+        MemoryGovernor::instance().Release(size_);
+    size_ = 0;
+}
+
+MemoryGovernor &MemoryGovernor::instance() {
+    static MemoryGovernor governor;
+    return governor;
+}
+
+size_t MemoryGovernor::limit() const {
+    size_t limit = get_memory_limit();
+    long pages = sysconf(_SC_PHYS_PAGES), page_size = sysconf(_SC_PAGE_SIZE);
+    if (pages > 0 && page_size > 0)
+        limit = std::min(limit, size_t(pages) * size_t(page_size));
+    return limit;
+}
+
+size_t MemoryGovernor::used() const {
+#ifdef SPADES_USE_JEMALLOC
+    return get_used_memory();
+#else
+    unsigned long vm;
+    long rss;
+    process_mem_usage(vm, rss);
+    return rss > 0 ? size_t(rss) * 1024 : get_used_memory();
+#endif
+}
+
+size_t MemoryGovernor::available() const {
+    size_t limit = this->limit(), used = this->used() + reserved_;
+    return limit > used ? limit - used : 0;
+}
+
+bool MemoryGovernor::under_pressure() const {
+    uint64_t now = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    uint64_t last = last_check_ms_;
+    if (now - last >= PRESSURE_CHECK_INTERVAL_MS &&
+        last_check_ms_.compare_exchange_strong(last, now)) {
+        bool pressure = (double)used() >= PRESSURE_THRESHOLD * (double)limit();
+        if (pressure && !pressure_)
+            INFO("Memory usage is approaching the limit, buffers will be shrunk");
+        pressure_ = pressure;
+    }
+    return pressure_;
+}
+
+MemoryReservation MemoryGovernor::Reserve(size_t desired, size_t minimum) {
+    size_t limit = this->limit(), used = this->used();
+    size_t reserved = reserved_, granted;
+    // Check the headroom and claim it at once, so concurrent callers could not be granted the same memory
+    do {
+        size_t taken = used + reserved;
+        granted = std::max(minimum, std::min(desired, limit > taken ? limit - taken : 0));
+    } while (!reserved_.compare_exchange_weak(reserved, reserved + granted));
+    if (granted < desired)
+        DEBUG("Requested " << desired << " bytes, granted " << granted << " bytes");
+    return MemoryReservation(granted);
+}
+
+size_t MemoryGovernor::ItemCount(size_t item_size, size_t desired, size_t minimum, size_t ways) const {
+    VERIFY(item_size && ways);
+    size_t items = available() / ways / item_size;
+    return std::max(minimum, std::min(desired, items));
+}
+
+unsigned MemoryGovernor::ThreadCount(size_t per_thread, unsigned max_threads) const {
+    if (!per_thread)
+        return std::max(max_threads, 1u);
+    size_t threads = available() / per_thread;
+    return (unsigned)std::max<size_t>(1, std::min<size_t>(max_threads, threads));
+}
+
+unsigned MemoryGovernor::BucketCount(size_t total, unsigned nthreads,
+                                     unsigned min_buckets, unsigned max_buckets) const {
+    size_t budget = std::max<size_t>(available(), 1);
+    size_t buckets = (total * std::max(nthreads, 1u) + budget - 1) / budget;
+    return (unsigned)std::max<size_t>(min_buckets, std::min<size_t>(max_buckets, buckets));
 }
 
 }
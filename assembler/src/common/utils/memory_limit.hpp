@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
 
 namespace utils {
@@ -17,4 +19,74 @@ size_t get_max_rss();
 size_t get_used_memory();
 size_t get_free_memory();
 
+class MemoryGovernor;
+
+/**
+ * @brief  A chunk of the memory budget granted by MemoryGovernor. Returned back on destruction.
+ */
+class MemoryReservation {
+public:
+    MemoryReservation() : size_(0) {}
+    MemoryReservation(MemoryReservation &&other) : size_(other.size_) { other.size_ = 0; }
+    MemoryReservation &operator=(MemoryReservation &&other);
+    MemoryReservation(const MemoryReservation &) = delete;
+    MemoryReservation &operator=(const MemoryReservation &) = delete;
+    ~MemoryReservation() { reset(); }
+
+    size_t size() const { return size_; }
+    void reset();
+
+private:
+    friend class MemoryGovernor;
+    explicit MemoryReservation(size_t size) : size_(size) {}
+
+    size_t size_;
+};
+
+/**
+ * @brief  Process-wide memory budget. The limit is the one set via limit_memory()
+ *         (capped by physical memory). Memory-hungry phases size their buffers,
+ *         bucket and thread counts from reservations instead of fixed constants,
+ *         and poll under_pressure() to spill / flush early instead of hitting the limit.
+ */
+class MemoryGovernor {
+public:
+    static MemoryGovernor &instance();
+
+    size_t limit() const;
+    size_t used() const;
+    size_t reserved() const { return reserved_; }
+    // Memory which is neither used nor promised to someone else
+    size_t available() const;
+
+    // Cheap enough to be polled from hot loops: memory usage is sampled at most once per
+    // PRESSURE_CHECK_INTERVAL_MS milliseconds
+    bool under_pressure() const;
+
+    /**
+     * @brief  Reserves up to desired bytes, but not less than minimum even if the budget
+     *         is exhausted (the caller is expected to work in smaller portions then).
+     */
+    MemoryReservation Reserve(size_t desired, size_t minimum = 0);
+
+    // Number of items of item_size bytes fitting into 1/ways of the available memory, clamped to [minimum, desired]
+    size_t ItemCount(size_t item_size, size_t desired, size_t minimum, size_t ways = 1) const;
+    // Number of threads (up to max_threads, at least one) whose working sets of per_thread bytes fit into the available memory
+    unsigned ThreadCount(size_t per_thread, unsigned max_threads) const;
+    // Number of buckets so that nthreads buckets processed simultaneously fit into the available memory
+    unsigned BucketCount(size_t total, unsigned nthreads, unsigned min_buckets, unsigned max_buckets) const;
+
+    static constexpr double PRESSURE_THRESHOLD = 0.9;
+    static constexpr unsigned PRESSURE_CHECK_INTERVAL_MS = 50;
+
+private:
+    friend class MemoryReservation;
+    MemoryGovernor() : reserved_(0), last_check_ms_(0), pressure_(false) {}
+    void Release(size_t size) { reserved_ -= size; }
+
+    std::atomic<size_t> reserved_;
+    mutable std::atomic<uint64_t> last_check_ms_;
+    mutable std::atomic<bool> pressure_;
+};
+
 }
@@ -23,6 +23,8 @@
 # define omp_destroy_lock(x)     ((void)(x))
 # define omp_set_lock(x)         ((void)(x))
 # define omp_unset_lock(x)       ((void)(x))
+# define omp_get_max_active_levels() 1
+# define omp_set_max_active_levels(x) ((void)(x))
 #endif
 
 static inline unsigned spades_set_omp_threads(unsigned max_threads) {
@@ -0,0 +1,200 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "timetracer.hpp"
+
+#include "utils/perf/memory.hpp"
+#include "utils/memory_limit.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/logger/logger.hpp"
+
+#include <cppformat/format.h>
+
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+
+namespace utils {
+
+namespace {
+
+double wall_clock() {
+    typedef std::chrono::steady_clock clock;
+    static const clock::time_point epoch = clock::now();
+    return std::chrono::duration<double>(clock::now() - epoch).count();
+}
+
+// Make sure the epoch is set at startup, not at the first traced scope
+const double trace_epoch = wall_clock();
+
+double to_seconds(const timeval &tv) {
+    return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+void read_proc_io(size_t &read_bytes, size_t &write_bytes) {
+    read_bytes = write_bytes = 0;
+    std::ifstream is("/proc/self/io");
+    std::string key;
+    size_t value;
+    while (is >> key >> value) {
+        if (key == "read_bytes:")
+            read_bytes = value;
+        else if (key == "write_bytes:")
+            write_bytes = value;
+    }
+}
+
+unsigned thread_index() {
+    static std::atomic<unsigned> next_tid{0};
+    thread_local unsigned tid = next_tid++;
+    return tid;
+}
+
+thread_local unsigned scope_depth = 0;
+
+std::string escape(const std::string &s) {
+    std::string res;
+    res.reserve(s.size());
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            res.push_back('\\');
+        res.push_back(c);
+    }
+    return res;
+}
+
+}
+
+resource_usage resource_usage::current() {
+    resource_usage res;
+    res.wall = wall_clock();
+
+    rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        res.user = to_seconds(ru.ru_utime);
+        res.sys = to_seconds(ru.ru_stime);
+    }
+
+    unsigned long vm;
+    long rss;
+    process_mem_usage(vm, rss);
+    res.rss = rss > 0 ? size_t(rss) : 0;
+    res.max_rss = get_max_rss();
+    read_proc_io(res.read_bytes, res.write_bytes);
+
+    return res;
+}
+
+TimeTracer &TimeTracer::instance() {
+    static TimeTracer tracer;
+    return tracer;
+}
+
+void TimeTracer::record(Event event) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.push_back(std::move(event));
+}
+
+std::vector<TimeTracer::Event> TimeTracer::events() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return events_;
+}
+
+void TimeTracer::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.clear();
+}
+
+void TimeTracer::dump_chrome_trace(const std::string &filename) const {
+    auto events = this->events();
+    std::ofstream os(filename);
+    if (!os) {
+        WARN("Cannot open " << filename << " to write time trace");
+        return;
+    }
+
+    long pid = (long)getpid();
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto &e : events) {
+        if (!first)
+            os << ",\n";
+        first = false;
+        os << fmt::format("{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"pid\":{},\"tid\":{},"
+                          "\"ts\":{:.0f},\"dur\":{:.0f},\"args\":{{"
+                          "\"user_s\":{:.3f},\"sys_s\":{:.3f},\"utilization\":{:.3f},\"threads\":{},"
+                          "\"rss_start_kb\":{},\"rss_end_kb\":{},\"rss_delta_kb\":{},\"peak_rss_kb\":{},"
+                          "\"read_bytes\":{},\"write_bytes\":{}}}}}",
+                          escape(e.name), escape(e.category), pid, e.tid,
+                          e.start.wall * 1e6, e.wall() * 1e6,
+                          e.end.user - e.start.user, e.end.sys - e.start.sys, e.utilization(), e.threads,
+                          e.start.rss, e.end.rss, (long long)e.end.rss - (long long)e.start.rss, e.peak_rss,
+                          e.end.read_bytes - e.start.read_bytes, e.end.write_bytes - e.start.write_bytes);
+        // Memory counter track, sampled at scope boundaries
+        for (const auto *u : { &e.start, &e.end })
+            os << fmt::format(",\n{{\"name\":\"RSS\",\"ph\":\"C\",\"pid\":{},\"ts\":{:.0f},\"args\":{{\"rss_mb\":{}}}}}",
+                              pid, u->wall * 1e6, u->rss / 1024);
+    }
+    os << "\n]}\n";
+}
+
+void TimeTracer::dump_summary(const std::string &filename) const {
+    auto events = this->events();
+    std::ofstream os(filename);
+    if (!os) {
+        WARN("Cannot open " << filename << " to write time trace summary");
+        return;
+    }
+
+    os << "[\n";
+    bool first = true;
+    for (const auto &e : events) {
+        if (!first)
+            os << ",\n";
+        first = false;
+        os << fmt::format("  {{\"name\":\"{}\",\"category\":\"{}\",\"depth\":{},\"tid\":{},"
+                          "\"start_s\":{:.3f},\"wall_s\":{:.3f},\"user_s\":{:.3f},\"sys_s\":{:.3f},"
+                          "\"utilization\":{:.3f},\"peak_rss_kb\":{},\"rss_delta_kb\":{},"
+                          "\"read_bytes\":{},\"write_bytes\":{}}}",
+                          escape(e.name), escape(e.category), e.depth, e.tid,
+                          e.start.wall, e.wall(), e.end.user - e.start.user, e.end.sys - e.start.sys,
+                          e.utilization(), e.peak_rss, (long long)e.end.rss - (long long)e.start.rss,
+                          e.end.read_bytes - e.start.read_bytes, e.end.write_bytes - e.start.write_bytes);
+    }
+    os << "\n]\n";
+}
+
+TimeTraceScope::TimeTraceScope(std::string name, std::string category)
+        : active_(TimeTracer::instance().enabled()) {
+    if (!active_)
+        return;
+
+    event_.name = std::move(name);
+    event_.category = std::move(category);
+    event_.tid = thread_index();
+    event_.depth = scope_depth++;
+    event_.threads = (unsigned)omp_get_max_threads();
+    event_.start = resource_usage::current();
+}
+
+TimeTraceScope::~TimeTraceScope() {
+    if (!active_)
+        return;
+
+    scope_depth -= 1;
+    event_.end = resource_usage::current();
+    // ru_maxrss is a process-lifetime high-water mark. If it moved, the scope
+    // itself set the new peak, otherwise the best we know are the boundaries.
+    event_.peak_rss = (event_.end.max_rss > event_.start.max_rss ?
+                       event_.end.max_rss : std::max(event_.start.rss, event_.end.rss));
+    TimeTracer::instance().record(std::move(event_));
+}
+
+}
@@ -0,0 +1,96 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+namespace utils {
+
+// Snapshot of process-wide resource counters. Times are in seconds, memory in
+// KiB, I/O in bytes (as reported by /proc/self/io, zero if unavailable).
+struct resource_usage {
+    double wall = 0;
+    double user = 0;
+    double sys = 0;
+    size_t rss = 0;
+    size_t max_rss = 0;
+    size_t read_bytes = 0;
+    size_t write_bytes = 0;
+
+    static resource_usage current();
+};
+
+// Collects a timeline of (possibly nested) scopes together with the resources
+// consumed inside them. The timeline could be written out in Chrome trace
+// event format (load via chrome://tracing or https://ui.perfetto.dev) and as a
+// flat per-scope summary.
+class TimeTracer {
+  public:
+    struct Event {
+        std::string name;
+        std::string category;
+        unsigned tid;
+        unsigned depth;
+        resource_usage start;
+        resource_usage end;
+        size_t peak_rss;
+        unsigned threads;
+
+        double wall() const { return end.wall - start.wall; }
+        double cpu() const { return (end.user - start.user) + (end.sys - start.sys); }
+        double utilization() const {
+            double w = wall();
+            return (w > 0 && threads) ? cpu() / (w * threads) : 0;
+        }
+    };
+
+    static TimeTracer &instance();
+
+    void enable(bool enabled = true) { enabled_ = enabled; }
+    bool enabled() const { return enabled_; }
+
+    void record(Event event);
+    std::vector<Event> events() const;
+    void clear();
+
+    void dump_chrome_trace(const std::string &filename) const;
+    void dump_summary(const std::string &filename) const;
+
+  private:
+    TimeTracer() = default;
+
+    bool enabled_ = true;
+    mutable std::mutex mutex_;
+    std::vector<Event> events_;
+};
+
+// RAII scope registering itself in the global tracer on destruction. Intended
+// for coarse-grained regions (stages, phases, whole loops over reads or
+// buckets), not for per-item work: each scope samples /proc on entry and exit.
+class TimeTraceScope {
+  public:
+    TimeTraceScope(std::string name, std::string category = "scope");
+    ~TimeTraceScope();
+
+    TimeTraceScope(const TimeTraceScope&) = delete;
+    TimeTraceScope &operator=(const TimeTraceScope&) = delete;
+
+  private:
+    bool active_;
+    TimeTracer::Event event_;
+};
+
+}
+
+#define TIME_TRACE_CONCAT_IMPL(a, b) a##b
+#define TIME_TRACE_CONCAT(a, b) TIME_TRACE_CONCAT_IMPL(a, b)
+#define TIME_TRACE_SCOPE(...) \
+    utils::TimeTraceScope TIME_TRACE_CONCAT(time_trace_scope_, __LINE__)(__VA_ARGS__)
@@ -9,6 +9,8 @@
 
 #include "adt/concurrent_dsu.hpp"
 #include "io/kmers/mmapped_reader.hpp"
+#include "utils/memory_limit.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 #include "parallel_radix_sort.hpp"
 
 #include "config_struct_hammer.hpp"
@@ -88,29 +90,149 @@ static bool canMerge(const ConcurrentDSU &uf, size_t x, size_t y) {
 #endif
 
 
+// Hamming distance of two packed k-mers: every mismatching nucleotide leaves at least
+// one of the two bits of its XOR set
+static unsigned hamdistPacked(const hammer::KMer &x, const hammer::KMer &y) {
+  typedef hammer::KMer::DataType DataType;
+  const DataType EVEN = DataType(0x5555555555555555ull);
+  const size_t TAIL = (2 * hammer::K) % (8 * sizeof(DataType));
+
+  unsigned dist = 0;
+  for (size_t i = 0; i < hammer::KMer::DataSize; ++i) {
+    DataType d = x.data()[i] ^ y.data()[i];
+    if (TAIL && i + 1 == hammer::KMer::DataSize)
+      d &= (DataType(1) << TAIL) - 1;
+    dist += (unsigned)__builtin_popcountll((d | (d >> 1)) & EVEN);
+  }
+  return dist;
+}
+
 static void processBlockQuadratic(dsu::ConcurrentDSU  &uf,
                                   const std::vector<size_t>::iterator &block,
                                   size_t block_size,
                                   const KMerData &data,
                                   unsigned tau) {
+  // Unpack the k-mers once, pairs are compared with a couple of word operations
+  std::vector<hammer::KMer> kmers;
+  kmers.reserve(block_size);
+  for (size_t i = 0; i < block_size; ++i)
+    kmers.push_back(data.kmer(block[i]));
+
   for (size_t i = 0; i < block_size; ++i) {
     size_t x = block[i];
-    hammer::KMer kmerx = data.kmer(x);
     for (size_t j = i + 1; j < block_size; j++) {
       size_t y = block[j];
-      hammer::KMer kmery = data.kmer(y);
-      if (!uf.same(x, y) &&
-          canMerge(uf, x, y) &&
-          hamdistKMer(kmerx, kmery, tau) <= tau) {
+      if (hamdistPacked(kmers[i], kmers[j]) <= tau &&
+          !uf.same(x, y) &&
+          canMerge(uf, x, y)) {
         uf.unite(x, y);
       }
     }
   }
 }
 
+using SubKMerPairSort = parallel_radix_sort::PairSort<SubKMer, size_t, SubKMer, EncoderKMer>;
+
+// Sorts the indices by their sub-k-mers, returns the boundaries of the blocks of equal sub-k-mers
+static std::vector<size_t> sortBlocks(std::vector<SubKMer> &keys, std::vector<size_t>::iterator idx,
+                                      int nthreads) {
+  SubKMerPairSort::InitAndSort(keys.data(), &*idx, keys.size(), nthreads);
+
+  std::vector<size_t> starts;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (i == 0 || SubKMerComparator()(keys[i - 1], keys[i]))
+      starts.push_back(i);
+  }
+  starts.push_back(keys.size());
+
+  return starts;
+}
+
+bool KMerHamClusterer::clusterInMemory(const KMerData &data, dsu::ConcurrentDSU &uf) {
+  size_t n = data.size();
+  if (n == 0)
+    return true;
+
+  // Sub-k-mers and indices, plus the same amount for radix sort buffers
+  size_t required = 2 * n * (sizeof(SubKMer) + sizeof(size_t));
+  if (utils::MemoryGovernor::instance().available() < required) {
+    INFO("Not enough memory to split sub-kmers in memory, falling back to disk-based splitting");
+    return false;
+  }
+  auto reservation = utils::MemoryGovernor::instance().Reserve(required);
+
+  unsigned nthreads = cfg::get().general_max_nthreads;
+  unsigned block_thr = cfg::get().hamming_blocksize_quadratic_threshold;
+
+  std::vector<SubKMer> keys(n);
+  std::vector<size_t> idx(n);
+  size_t nblocks = 0, big_blocks1 = 0, nblocks2 = 0, big_blocks2 = 0;
+  for (unsigned i = 0; i < tau_ + 1; ++i) {
+    size_t from = (*Globals::subKMerPositions)[i];
+    size_t to = (*Globals::subKMerPositions)[i+1];
+    SubKMerPartSerializer serializer(from, to);
+
+    INFO("Splitting sub-kmers: [" << from << ", " << to << ")");
+#   pragma omp parallel for num_threads(nthreads)
+    for (size_t j = 0; j < n; ++j) {
+      keys[j] = serializer.serialize(data.kmer(j));
+      idx[j] = j;
+    }
+    std::vector<size_t> starts = sortBlocks(keys, idx.begin(), nthreads);
+    size_t blocks = starts.size() - 1;
+
+    // Merge small blocks
+#   pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1024)
+    for (size_t b = 0; b < blocks; ++b) {
+      size_t sz = starts[b + 1] - starts[b];
+      if (sz < block_thr)
+        processBlockQuadratic(uf, idx.begin() + starts[b], sz, data, tau_);
+    }
+
+    // Split big blocks once again by the strided sub-k-mers, every (block, stride) pair is a separate task
+    std::vector<size_t> big;
+    for (size_t b = 0; b < blocks; ++b) {
+      if (starts[b + 1] - starts[b] >= block_thr)
+        big.push_back(b);
+    }
+
+#   pragma omp parallel for num_threads(nthreads) schedule(dynamic) reduction(+:nblocks2, big_blocks2)
+    for (size_t t = 0; t < big.size() * (tau_ + 1); ++t) {
+      size_t b = big[t / (tau_ + 1)];
+      SubKMerStridedSerializer strided(t % (tau_ + 1), tau_ + 1);
+
+      std::vector<size_t> block(idx.begin() + starts[b], idx.begin() + starts[b + 1]);
+      std::vector<SubKMer> bkeys(block.size());
+      for (size_t j = 0; j < block.size(); ++j)
+        bkeys[j] = strided.serialize(data.kmer(block[j]));
+      std::vector<size_t> bstarts = sortBlocks(bkeys, block.begin(), 1);
+
+      for (size_t sb = 0; sb + 1 < bstarts.size(); ++sb) {
+        size_t sz = bstarts[sb + 1] - bstarts[sb];
+        if (sz > 50)
+          big_blocks2 += 1;
+        processBlockQuadratic(uf, block.begin() + bstarts[sb], sz, data, tau_);
+      }
+      nblocks2 += bstarts.size() - 1;
+    }
+
+    nblocks += blocks;
+    big_blocks1 += big.size();
+  }
+
+  INFO("Splitting done."
+       " Produced " << nblocks << " blocks, " << big_blocks1 << " of them were split once again into "
+       << nblocks2 << " blocks (" << big_blocks2 << " big blocks).");
+
+  return true;
+}
+
 void KMerHamClusterer::cluster(const std::string &prefix,
                                const KMerData &data,
                                dsu::ConcurrentDSU &uf) {
+  if (clusterInMemory(data, uf))
+    return;
+
   // First pass - split & sort the k-mers
   std::string fname = prefix + ".first", bfname = fname + ".blocks", kfname = fname + ".kmers";
   std::ofstream bfs(bfname, std::ios::out | std::ios::binary);
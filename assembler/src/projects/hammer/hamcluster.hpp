@@ -146,6 +146,10 @@ class KMerHamClusterer {
 
   void cluster(const std::string &prefix, const KMerData &data, dsu::ConcurrentDSU &uf);
  private:
+  // Same two-level splitting as cluster(), but sub-k-mers are kept in memory and blocks
+  // are processed in parallel. Returns false if sub-k-mers do not fit into the memory budget.
+  bool clusterInMemory(const KMerData &data, dsu::ConcurrentDSU &uf);
+
   DECL_LOGGER("Hamming Clustering");
 };
 
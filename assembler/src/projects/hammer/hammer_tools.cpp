@@ -84,7 +84,7 @@ CorrectionStats CorrectReadsBatch(std::vector<bool> &res,
   bool correct_threshold = cfg::get().correct_use_threshold;
   bool discard_bad = cfg::get().correct_discard_bad;
 
-  ReadCorrector corrector(data, cfg::get().correct_stats);
+  ReadCorrector corrector(data, correct_nthreads, cfg::get().correct_stats);
 # pragma omp parallel for shared(reads, res, data) num_threads(correct_nthreads)
   for (size_t i = 0; i < buf_size; ++i) {
     if (reads[i].size() >= K) {
@@ -221,6 +221,9 @@ size_t CorrectAllReads() {
 
   INFO("Starting read correction in " << correct_nthreads << " threads.");
 
+  // Good flags are final at this point
+  Globals::kmer_data->BuildSolidIndex();
+
   CorrectionStats stats;
 
   const io::DataSet<> &dataset = cfg::get().dataset;
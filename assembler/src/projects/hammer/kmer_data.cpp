@@ -366,6 +366,19 @@ void KMerDataCounter::BuildKMerIndex(KMerData &data) {
   }
 }
 
+void KMerData::BuildSolidIndex() {
+  size_t sz = size();
+  solid_.assign((sz + 63) / 64, 0);
+
+# pragma omp parallel for num_threads(cfg::get().general_max_nthreads)
+  for (size_t w = 0; w < solid_.size(); ++w) {
+    uint64_t word = 0;
+    for (size_t i = w * 64, e = std::min(sz, i + 64); i < e; ++i)
+      word |= uint64_t(operator[](i).good()) << (i & 63);
+    solid_[w] = word;
+  }
+}
+
 void KMerDataCounter::FillKMerData(KMerData &data) {
   // Now use the index to fill the kmer quality information.
   INFO("Collecting K-mer information, this takes a while.");
@@ -32,6 +32,7 @@ class KMerData {
   size_t size() const { return kmers_.size() + push_back_buffer_.size(); }
 
   void clear() {
+    solid_.clear();
     data_.clear();
     push_back_buffer_.clear();
     kmer_push_back_buffer_.clear();
@@ -73,6 +74,30 @@ class KMerData {
     return (s == kmer(idx) ? idx : -1ULL);
   }
 
+  // Same as checking_seq_idx() for n k-mers at once. Storage of all the candidates is
+  // prefetched before the k-mers are compared, so the random accesses overlap.
+  void checking_seq_idx(const hammer::KMer *s, size_t n, size_t *idx) const {
+    const size_t ksz = hammer::KMer::GetDataSize(hammer::K);
+    for (size_t i = 0; i < n; ++i) {
+      idx[i] = seq_idx(s[i]);
+      if (idx[i] < kmers_.size())
+        __builtin_prefetch(kmers_.data() + idx[i] * ksz);
+      if ((idx[i] >> 6) < solid_.size())
+        __builtin_prefetch(solid_.data() + (idx[i] >> 6));
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+      if (idx[i] >= size() || !(s[i] == kmer(idx[i])))
+        idx[i] = -1ULL;
+    }
+  }
+
+  // Dense snapshot of KMerStat::good() flags, should be rebuilt after the flags are changed
+  void BuildSolidIndex();
+  bool solid(size_t idx) const {
+    return (solid_[idx >> 6] >> (idx & 63)) & 1;
+  }
+
   KMerStat& operator[](hammer::KMer s) { return operator[](seq_idx(s)); }
   const KMerStat& operator[](hammer::KMer s) const { return operator[](seq_idx(s)); }
   size_t seq_idx(hammer::KMer s) const { return index_.seq_idx(s); }
@@ -123,6 +148,7 @@ class KMerData {
   KMerStorageType kmer_push_back_buffer_;
   KMerDataStorageType push_back_buffer_;
   HammerKMerIndex index_;
+  std::vector<uint64_t> solid_;
 
   friend class KMerDataCounter;
 };
@@ -11,6 +11,8 @@
 #include "kmer_stat.hpp"
 #include "valid_kmer_generator.hpp"
 
+#include "utils/parallel/openmp_wrapper.h"
+
 #include <string>
 #include <vector>
 #include <queue>
@@ -90,13 +92,13 @@ std::string ReadCorrector::CorrectReadRight(const std::string &seq, const std::s
             KMer last = correction.last << dignucl(c);
             size_t idx = data_.checking_seq_idx(last);
             if (idx != -1ULL) {
-                const KMerStat &kmer_data = data_[idx];
+                bool solid = data_.solid(idx);
                 candidates.emplace(pos, correction.str,
-                                   correction.penalty - (kmer_data.good() ?
+                                   correction.penalty - (solid ?
                                                          0.0 :
                                                          (qual[pos] >= 20 ? 1.0 : 2.0)),
                                     last, cpos);
-                if (kmer_data.good() && qual[pos] >= 20)
+                if (solid && qual[pos] >= 20)
                     extended = true;
             } else {
                 candidates.emplace(pos, correction.str,
@@ -128,18 +130,28 @@ std::string ReadCorrector::CorrectReadRight(const std::string &seq, const std::s
         positions_t cpos = correction.cpos;
         std::copy(cpos.begin() + 1, cpos.end(), cpos.begin());
         cpos.back() = (uint16_t)pos;
+        // Look up all the substitutions at once
+        KMer subst[4];
+        size_t idx[4];
+        size_t nsubst = 0;
+        for (char cc = 0; cc < 4; ++cc) {
+            if (c != nucl(cc))
+                subst[nsubst++] = correction.last << cc;
+        }
+        data_.checking_seq_idx(subst, nsubst, idx);
+
+        size_t i = 0;
         for (char cc = 0; cc < 4; ++cc) {
             char ncc = nucl(cc);
             if (c == ncc)
                 continue;
 
-            KMer last = correction.last << cc;
-            size_t idx = data_.checking_seq_idx(last);
-            if (idx == -1ULL)
+            KMer last = subst[i];
+            size_t kidx = idx[i++];
+            if (kidx == -1ULL)
                 continue;
 
-            const KMerStat &kmer_data = data_[idx];
-            if (kmer_data.good()) {
+            if (data_.solid(kidx)) {
                 std::string corrected = correction.str; corrected[pos] = ncc;
                 double penalty = correction.penalty - (is_nucl(c) ?
                                                        (qual[pos] >= 20 ? 5.0 : 1.0) :
@@ -151,8 +163,7 @@ std::string ReadCorrector::CorrectReadRight(const std::string &seq, const std::s
         FlushCandidates(corrections, candidates, size_thr);
     }
 
-#   pragma omp atomic
-    uncorrected_nucleotides_ += read_size - right_pos;
+    stats_[omp_get_thread_num()].uncorrected_nucleotides += read_size - right_pos;
 
     return seq;
 }
@@ -167,36 +178,39 @@ bool ReadCorrector::CorrectOneRead(Read & r,
     // Find the longest "solid island"
     size_t lleft_pos = -1ULL, lright_pos = -1ULL, solid_len = 0;
 
+    // Collect all the valid k-mers of the read and look them up in a single batch
+    std::vector<hammer::KMer> kmers;
+    std::vector<size_t> positions;
     ValidKMerGenerator<K> gen(seq.data(), qual.data(), read_size);
-    size_t left_pos = 0, right_pos = 0;
     while (gen.HasMore()) {
-        size_t read_pos = gen.pos() - 1;
-        hammer::KMer kmer = gen.kmer();
-        size_t idx = data_.checking_seq_idx(kmer);
-        if (idx != -1ULL) {
-            const KMerStat &kmer_data = data_[idx];
-            if (kmer_data.good()) {
-                if (read_pos != right_pos - K + 2) {
-                    left_pos = read_pos;
-                    right_pos = left_pos + K - 1;
-                } else
-                    right_pos += 1;
-
-                if (right_pos - left_pos + 1 > solid_len) {
-                    lleft_pos = left_pos;
-                    lright_pos = right_pos;
-                    solid_len = right_pos - left_pos + 1;
-                }
+        kmers.push_back(gen.kmer());
+        positions.push_back(gen.pos() - 1);
+        gen.Next();
+    }
+    std::vector<size_t> indices(kmers.size());
+    data_.checking_seq_idx(kmers.data(), kmers.size(), indices.data());
+
+    size_t left_pos = 0, right_pos = 0;
+    for (size_t i = 0; i < kmers.size(); ++i) {
+        size_t read_pos = positions[i];
+        size_t idx = indices[i];
+        if (idx != -1ULL && data_.solid(idx)) {
+            if (read_pos != right_pos - K + 2) {
+                left_pos = read_pos;
+                right_pos = left_pos + K - 1;
+            } else
+                right_pos += 1;
+
+            if (right_pos - left_pos + 1 > solid_len) {
+                lleft_pos = left_pos;
+                lright_pos = right_pos;
+                solid_len = right_pos - left_pos + 1;
             }
         }
-
-        // INFO("" << left_pos << ":" << right_pos << ":" << read_pos << ", " << lleft_pos << ":" << lright_pos << "(" << solid_len << "), " << (kmer_data.good() ? "solid" : "non-solid"));
-
-        gen.Next();
     }
 
-#   pragma omp atomic
-    total_nucleotides_ += read_size;
+    Stats &stats = stats_[omp_get_thread_num()];
+    stats.total_nucleotides += read_size;
 
     // Now iterate over all the k-mers of a read trying to make all the stuff solid and good.
     if (solid_len && solid_len != read_size) {
@@ -212,11 +226,8 @@ bool ReadCorrector::CorrectOneRead(Read & r,
             corrected += seq[i] != newseq[i];
 
         if (corrected) {
-#           pragma omp atomic
-            changed_reads_ += 1;
-
-#           pragma omp atomic
-            changed_nucleotides_ += corrected;
+            stats.changed_reads += 1;
+            stats.changed_nucleotides += corrected;
             if (correct_stats_) {
                 std::string name = r.getName();
                 name += " BH:changed:" + std::to_string(corrected);
@@ -17,33 +17,47 @@ class Read;
 #include <cstddef>
 
 class ReadCorrector {
+  // Per-thread statistics, padded to a cache line to avoid false sharing
+  struct Stats {
+    size_t changed_reads = 0;
+    size_t changed_nucleotides = 0;
+    size_t uncorrected_nucleotides = 0;
+    size_t total_nucleotides = 0;
+    char padding[64 - 4 * sizeof(size_t)];
+  };
+
   const KMerData &data_;
-  size_t changed_reads_;
-  size_t changed_nucleotides_;
-  size_t uncorrected_nucleotides_;
-  size_t total_nucleotides_;
+  std::vector<Stats> stats_;
   bool   correct_stats_;
 
+  template<class F>
+  size_t sum(F f) const {
+    size_t res = 0;
+    for (const auto &stat : stats_)
+      res += f(stat);
+    return res;
+  }
+
  public:
-    ReadCorrector(const KMerData& data, bool correct_stats = false)
-            : data_(data),
-              changed_reads_(0), changed_nucleotides_(0), uncorrected_nucleotides_(0), total_nucleotides_(0),
+    // KMerData::BuildSolidIndex() should be called before the correction
+    ReadCorrector(const KMerData& data, unsigned nthreads, bool correct_stats = false)
+            : data_(data), stats_(nthreads),
               correct_stats_(correct_stats) {}
 
   size_t changed_reads() const {
-    return changed_reads_;
+    return sum([](const Stats &s) { return s.changed_reads; });
   }
 
   size_t changed_nucleotides() const {
-    return changed_nucleotides_;
+    return sum([](const Stats &s) { return s.changed_nucleotides; });
   }
 
   size_t uncorrected_nucleotides() const {
-    return uncorrected_nucleotides_;
+    return sum([](const Stats &s) { return s.uncorrected_nucleotides; });
   }
 
   size_t total_nucleotides() const {
-    return total_nucleotides_;
+    return sum([](const Stats &s) { return s.total_nucleotides; });
   }
 
   bool CorrectOneRead(Read & r,
@@ -56,8 +56,31 @@ class ReadCorrector {
   mutable size_t skipped_reads = 0;
   mutable size_t queue_overflow_reads = 0;
 
-  inline bool Flush(std::priority_queue<State>& candidates,
-                    std::priority_queue<State>& corrections,
+  // Search containers reused by all the reads corrected by a thread
+  struct Workspace {
+    StateQueue<State> corrections;
+    StateQueue<State> candidates;
+    VisitedSet visited;
+
+    void clear() {
+      corrections.clear();
+      candidates.clear();
+      visited.clear();
+    }
+  };
+
+  static Workspace& GetWorkspace() {
+    static thread_local Workspace workspace;
+    return workspace;
+  }
+
+  static void ReverseComplementInPlace(std::string& read) {
+    std::transform(read.begin(), read.end(), read.begin(), nucl_complement);
+    std::reverse(read.begin(), read.end());
+  }
+
+  inline bool Flush(StateQueue<State>& candidates,
+                    StateQueue<State>& corrections,
                     size_t limit,
                     size_t readSize) const {
 
@@ -66,7 +89,7 @@ class ReadCorrector {
       if (!std::isinf(top.Penalty())) {
         corrections.emplace(std::move(top));
       }
-      std::priority_queue<State>().swap(candidates);
+      candidates.clear();
       return true;
     } else {
       while (!candidates.empty()) {
@@ -92,8 +115,11 @@ class ReadCorrector {
       return read;
     }
 
-    std::priority_queue<State> corrections;
-    std::priority_queue<State> candidates;
+    Workspace& workspace = GetWorkspace();
+    workspace.clear();
+    auto& corrections = workspace.corrections;
+    auto& candidates = workspace.candidates;
+    auto& visited = workspace.visited;
 
     CorrectionContext context(data, read, reverse);
     {
@@ -101,22 +127,20 @@ class ReadCorrector {
           context, penalty_calcer, (uint)offset));
     }
 
-    std::map<uint, std::set<size_t> > visited;
     const size_t queue_limit =  (const size_t)(cfg::get().queue_limit_multiplier * log2(read.size() - offset + 1));//(const size_t)(100 * read.size());
 
     bool queue_overflow = false;
 
     while (!corrections.empty()) {
 
-      auto state = std::pop_queue(corrections);
+      auto state = corrections.pop();
       assert(state.Position() <= read.size());
 
       {
         size_t hash = state.GetHKMer().GetHash();
-        if (visited[state.Position()].count(hash) && corrections.size()) {
+        if (!visited.insert(state.Position(), hash) && corrections.size()) {
           continue;
         }
-        visited[state.Position()].insert(hash);
       }
 
       if (state.Position() < read.size()) {
@@ -194,7 +218,7 @@ class ReadCorrector {
       const bool reverse = pass % 2 == 0;  // tail has more errors, so let's start with "simple" part
       const bool only_simple = pass < 2 * simple_passes_count;
       if (reverse) {
-        current_read = ReverseComplement(current_read);
+        ReverseComplementInPlace(current_read);
       }
       const auto solid_island = penalty_calcer.SolidIsland(current_read);
       const size_t solid_length = solid_island.right_ - solid_island.left_;
@@ -231,7 +255,7 @@ class ReadCorrector {
       overflow  |= pass_overflow;
 
       if (reverse) {
-        current_read = ReverseComplement(current_read);
+        ReverseComplementInPlace(current_read);
       }
     }
 
@@ -5,8 +5,10 @@
 #ifndef PROJECT_READ_CORRECTOR_INFO_H
 #define PROJECT_READ_CORRECTOR_INFO_H
 
+#include <algorithm>
 #include <functional>
 #include <queue>
+#include <vector>
 #include "hkmer.hpp"
 
 namespace hammer {
@@ -22,6 +24,93 @@ inline Moveable pop_queue(std::priority_queue<Moveable>& queue) {
   return result;
 }
 
+// Same heap discipline as std::priority_queue (so states are popped in exactly the same
+// order), but clear() keeps the storage for the next read
+template <class T>
+class StateQueue {
+  std::vector<T> heap_;
+
+ public:
+  bool empty() const { return heap_.empty(); }
+  size_t size() const { return heap_.size(); }
+  const T& top() const { return heap_.front(); }
+
+  template <class... Args>
+  void emplace(Args&&... args) {
+    heap_.emplace_back(std::forward<Args>(args)...);
+    std::push_heap(heap_.begin(), heap_.end(), std::less<T>());
+  }
+
+  T pop() {
+    std::pop_heap(heap_.begin(), heap_.end(), std::less<T>());
+    T result(std::move(heap_.back()));
+    heap_.pop_back();
+    return result;
+  }
+
+  void clear() { heap_.clear(); }
+};
+
+template <class Moveable>
+inline Moveable pop_queue(StateQueue<Moveable>& queue) {
+  return queue.pop();
+}
+
+// Open addressing set of (position, hash) pairs. clear() resets only the occupied slots.
+class VisitedSet {
+  struct Entry {
+    size_t hash;
+    unsigned position;
+    bool used;
+  };
+
+  std::vector<Entry> table_;
+  std::vector<size_t> touched_;
+  size_t mask_;
+
+  size_t Slot(unsigned position, size_t hash) const {
+    return (hash ^ (size_t(position) * 0x9E3779B97F4A7C15ULL)) & mask_;
+  }
+
+  void Grow() {
+    std::vector<Entry> entries;
+    entries.reserve(touched_.size());
+    for (size_t slot : touched_)
+      entries.push_back(table_[slot]);
+
+    table_.assign(table_.size() * 2, Entry{0, 0, false});
+    mask_ = table_.size() - 1;
+    touched_.clear();
+    for (const auto& entry : entries)
+      insert(entry.position, entry.hash);
+  }
+
+ public:
+  VisitedSet() : table_(1024, Entry{0, 0, false}), mask_(1023) {}
+
+  // Returns false if the pair is already there
+  bool insert(unsigned position, size_t hash) {
+    if (2 * (touched_.size() + 1) > table_.size())
+      Grow();
+
+    size_t slot = Slot(position, hash);
+    while (table_[slot].used) {
+      if (table_[slot].position == position && table_[slot].hash == hash)
+        return false;
+      slot = (slot + 1) & mask_;
+    }
+    table_[slot] = Entry{hash, position, true};
+    touched_.push_back(slot);
+    return true;
+  }
+
+  void clear() {
+    for (size_t slot : touched_)
+      table_[slot].used = false;
+    touched_.clear();
+  }
+};
+
 struct IonEvent {
   
   IonEvent(const char nucl = 0, const char observed_size = 0,
@@ -464,7 +553,7 @@ class CorrectLastHRun {
  private:
   inline bool AddAnotherNuclInsertions(const HRun run,
                                        const TState& previous,
-                                       std::priority_queue<TState>& corrections) {
+                                       StateQueue<TState>& corrections) {
     bool found = false;
     const auto& kmer = previous.GetHKMer();
 
@@ -506,7 +595,7 @@ class CorrectLastHRun {
         calcer_(calcer),
         is_good_function_(calcer_.Good()) {}
 
-  inline void AddOnlySimpleCorrections(std::priority_queue<TState>& corrections,
+  inline void AddOnlySimpleCorrections(StateQueue<TState>& corrections,
                                        unsigned indel_size = 1) {
     const unsigned cursor = previous_.Position();
     const HRun run = context_.GetHRun(cursor);
@@ -579,7 +668,7 @@ class CorrectLastHRun {
     }
   }
 
-  inline bool AddPossibleCorrections(std::priority_queue<TState>& corrections) {
+  inline bool AddPossibleCorrections(StateQueue<TState>& corrections) {
     const unsigned cursor = previous_.Position();
     const HRun run = context_.GetHRun(cursor);
     bool found = false;
@@ -6,6 +6,7 @@
 #include "io/reads/file_reader.hpp"
 #include "io/reads/osequencestream.hpp"
 #include "logger.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 #include "formats.hpp"
 #include "contig_abundance.hpp"
 
@@ -13,32 +14,49 @@ using namespace debruijn_graph;
 
 //Helper class to have scoped DEBUG()
 class Runner {
+    static const size_t BATCH_SIZE = 1 << 14;
+
 public:
     template<typename T>
     static void Run(const ProfileCounter<T>& counter, size_t min_length_bound,
                     io::FileReadStream& contigs_stream, std::ofstream& out) {
-        io::SingleRead contig;
         out << std::defaultfloat << std::fixed << std::setprecision(2);
-        while (!contigs_stream.eof()) {
-            contigs_stream >> contig;
-            contig_id id = GetId(contig);
-            DEBUG("Analyzing contig " << id);
-
-            if (contig.size() < min_length_bound) {
-                DEBUG("Fragment is shorter than min_length_bound " << min_length_bound);
-                break;
+        std::vector<io::SingleRead> contigs;
+        std::vector<typename ClusterAnalyzer<T>::Result> profiles;
+        bool stop = false;
+        while (!stop && !contigs_stream.eof()) {
+            //Contigs are read in batches, abundances within a batch are estimated in parallel
+            contigs.clear();
+            while (contigs.size() < BATCH_SIZE && !contigs_stream.eof()) {
+                io::SingleRead contig;
+                contigs_stream >> contig;
+                if (contig.size() < min_length_bound) {
+                    DEBUG("Fragment " << GetId(contig) << " is shorter than min_length_bound " << min_length_bound);
+                    stop = true;
+                    break;
+                }
+                contigs.push_back(std::move(contig));
             }
 
-            auto profile = counter(contig.GetSequenceString(), contig.name());
+            profiles.assign(contigs.size(), boost::none);
+#           pragma omp parallel for schedule(guided)
+            for (size_t i = 0; i < contigs.size(); ++i) {
+                DEBUG("Analyzing contig " << GetId(contigs[i]));
+                profiles[i] = counter(contigs[i].GetSequenceString(), contigs[i].name());
+            }
 
-            if (profile) {
-                DEBUG("Successfully estimated abundance of " << id);
-                out << id << "\t";
-                std::copy(profile->begin(), profile->end(),
-                          std::ostream_iterator<T>(out, "\t"));
-                out << std::endl;
-            } else {
-                DEBUG("Failed to estimate abundance of " << id);
+            for (size_t i = 0; i < contigs.size(); ++i) {
+                contig_id id = GetId(contigs[i]);
+                const auto& profile = profiles[i];
+                if (profile) {
+                    DEBUG("Successfully estimated abundance of " << id);
+                    out << id << "\t";
+                    std::copy(profile->begin(), profile->end(),
+                              std::ostream_iterator<T>(out, "\t"));
+                    out << std::endl;
+                } else {
+                    DEBUG("Failed to estimate abundance of " << id);
+                }
             }
         }
     }
@@ -50,7 +68,7 @@ int main(int argc, char** argv) {
     using namespace GetOpt;
 
     unsigned k;
-    size_t sample_cnt, min_length_bound;
+    size_t sample_cnt, min_length_bound, nthreads;
     std::string contigs_path, kmer_mult_fn, contigs_abundance_fn;
     bool var;
 
@@ -63,16 +81,18 @@ int main(int argc, char** argv) {
             >> Option('m', kmer_mult_fn)
             >> Option('o', contigs_abundance_fn)
             >> Option('l', min_length_bound, size_t(0))
+            >> Option('t', "threads", nthreads, size_t(1))
             >> OptionPresent('v', var);
     } catch(GetOptEx &ex) {
         std::cout << "Usage: contig_abundance_counter -k <K> -c <contigs path> "
                 "-n <sample cnt> -m <kmer multiplicities path> -o <contigs abundance path> "
-                "[-v] [-l <contig length bound> (default: 0)]"  << std::endl;
+                "[-v] [-l <contig length bound> (default: 0)] [-t <threads> (default: 1)]"  << std::endl;
         exit(1);
     }
 
     //TmpFolderFixture fixture("tmp");
     create_console_logger();
+    omp_set_num_threads((int)nthreads);
 
     KmerProfileIndex::SetSampleCount(sample_cnt);
 
@@ -24,6 +24,9 @@ typedef io::SequencingLibrary<config::LibraryData> SequencingLib;
 using PairedInfoFilter = bf::counting_bloom_filter<std::pair<EdgeId, EdgeId>, 2>;
 using EdgePairCounter = hll::hll_with_hasher<std::pair<EdgeId, EdgeId>>;
 
+static constexpr size_t IS_SAMPLE_PORTIONS_PER_THREAD = 64;
+static constexpr size_t IS_SAMPLE_MIN_PAIRS = 100000;
+
 std::shared_ptr<SequenceMapper<Graph>> ChooseProperMapper(const conj_graph_pack& gp,
                                                           const SequencingLib& library) {
     if (library.type() == io::LibraryType::MatePairs) {
@@ -184,6 +187,23 @@ static bool ShouldObtainSingleReadsPaths(size_t ilib) {
     return false;
 }
 
+// The library is split into many small portions processed in bit-reversed order, so every
+// prefix of the order is spread evenly across the whole library
+static std::vector<size_t> SamplingOrder(size_t threads) {
+    unsigned bits = 0;
+    while ((size_t(1) << bits) < IS_SAMPLE_PORTIONS_PER_THREAD * threads)
+        ++bits;
+
+    std::vector<size_t> order(size_t(1) << bits);
+    for (size_t i = 0; i < order.size(); ++i) {
+        size_t r = 0;
+        for (unsigned b = 0; b < bits; ++b)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        order[i] = r;
+    }
+    return order;
+}
+
 static bool CollectLibInformation(const conj_graph_pack &gp,
                                   size_t &edgepairs,
                                   size_t ilib, size_t edge_length_threshold) {
@@ -197,14 +217,41 @@ static bool CollectLibInformation(const conj_graph_pack &gp,
 
     SequencingLib &reads = cfg::get_writable().ds.reads[ilib];
     auto &data = reads.data();
-    auto paired_streams = paired_binary_readers(reads, /*followed by rc*/false, /*insert_size*/0,
-                                                /*include_merged*/true);
-
-    notifier.ProcessLibrary(paired_streams, ilib, *ChooseProperMapper(gp, reads));
+    std::vector<size_t> order = SamplingOrder(cfg::get().max_threads);
+    double tolerance = cfg::get().is_count_tolerance;
+
+    // Edge pair cardinality observed after every sampling round
+    std::vector<std::pair<size_t, double>> cardinalities;
+    size_t processed = notifier.ProcessLibraryPortions<io::PairedReadSeq>(
+        [&](size_t portion) {
+            return io::paired_binary_reader(reads, /*insert_size*/0, /*include_merged*/true,
+                                            order.size(), portion);
+        },
+        order, ilib, *ChooseProperMapper(gp, reads), cfg::get().max_threads,
+        [&](size_t done) {
+            cardinalities.emplace_back(done, pcounter.cardinality());
+            return tolerance > 0 && hist_counter.Converged(tolerance, IS_SAMPLE_MIN_PAIRS);
+        });
     //Check read length after lib processing since mate pairs a not used until this step
     VERIFY(reads.data().unmerged_read_length != 0);
 
     edgepairs = size_t(pcounter.cardinality());
+    if (processed < order.size()) {
+        INFO("Insert size converged after " << hist_counter.total() << " paired reads ("
+             << processed << " of " << order.size() << " library portions)");
+        // The number of distinct edge pairs grows sublinearly with the number of reads, so both
+        // proportional extrapolation and the one along the growth rate over the second half of
+        // the sample overestimate it
+        const auto &half = *std::lower_bound(cardinalities.begin(), cardinalities.end(),
+                                             std::make_pair(processed / 2, 0.));
+        double card = pcounter.cardinality();
+        double estimate = card * double(order.size()) / double(processed);
+        if (half.first < processed) {
+            double slope = std::max(0., card - half.second) / double(processed - half.first);
+            estimate = std::min(estimate, card + slope * double(order.size() - processed));
+        }
+        edgepairs = size_t(estimate);
+    }
     INFO("Edge pairs: " << edgepairs);
 
     INFO(hist_counter.mapped() << " paired reads (" <<
@@ -302,7 +349,8 @@ static void ProcessPairedReads(conj_graph_pack &gp,
 
     LatePairedIndexFiller pif(gp.g,
                               weight, round_thr,
-                              gp.paired_indices[ilib]);
+                              gp.paired_indices[ilib],
+                              fs::tmp::make_temp_dir(gp.workdir, "paired_info"));
     notifier.Subscribe(ilib, &pif);
 
     auto paired_streams = paired_binary_readers(reads, /*followed by rc*/false, (size_t) data.mean_insert_size,
@@ -28,6 +28,8 @@
 #include "pipeline/config_struct.hpp"
 #include "pipeline/graph_pack.hpp"
 
+#include "utils/perf/timetracer.hpp"
+
 namespace spades {
 
 static bool MetaCompatibleLibraries() {
@@ -256,6 +258,10 @@ void assemble_genome() {
     // For informing spades.py about estimated params
     write_lib_data(fs::append_path(cfg::get().output_dir, "final"));
 
+    // Per-stage resource timeline for profiling and regression tracking
+    utils::TimeTracer::instance().dump_chrome_trace(fs::append_path(cfg::get().output_dir, "timeline.json"));
+    utils::TimeTracer::instance().dump_summary(fs::append_path(cfg::get().output_dir, "stage_stats.json"));
+
     INFO("SPAdes finished");
 }
 
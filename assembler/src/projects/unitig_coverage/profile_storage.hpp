@@ -8,6 +8,7 @@
 #include "assembly_graph/core/graph.hpp"
 #include "assembly_graph/handlers/id_track_handler.hpp"
 #include "toolchain/edge_label_helper.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
 #include <vector>
 
@@ -15,16 +16,51 @@ namespace debruijn_graph {
 namespace coverage_profiles {
 
 //TODO always working with doubles seems easier and more correct
+/**
+ * @brief Per-edge coverage profiles across samples.
+ *        Profiles are stored as a contiguous edges-by-samples matrix, rows are indexed by
+ *        dense edge ordinals. Rows of deleted edges are reused by the edges created later.
+ */
 class EdgeProfileStorage : public omnigraph::GraphActionHandler<Graph> {
     typedef Graph::EdgeId EdgeId;
     typedef Graph::VertexId VertexId;
     typedef std::vector<size_t> RawAbundanceVector;
     typedef std::vector<double> AbundanceVector;
+    static const size_t READ_BATCH_SIZE = 1 << 16;
 
     size_t sample_cnt_;
-    std::unordered_map<EdgeId, RawAbundanceVector> profiles_;
+    std::unordered_map<EdgeId, size_t> rows_;
+    std::vector<size_t> free_rows_;
+    // rows_.size() + free_rows_.size() rows of sample_cnt_ values
+    std::vector<size_t> matrix_;
 
-    AbundanceVector Normalize(const RawAbundanceVector &p, size_t length) const {
+    const size_t *row(EdgeId e) const {
+        return matrix_.data() + utils::get(rows_, e) * sample_cnt_;
+    }
+
+    RawAbundanceVector raw_profile(EdgeId e) const {
+        const size_t *r = row(e);
+        return RawAbundanceVector(r, r + sample_cnt_);
+    }
+
+    void SetProfile(EdgeId e, const RawAbundanceVector &p) {
+        auto it = rows_.find(e);
+        size_t r;
+        if (it != rows_.end()) {
+            r = it->second;
+        } else if (!free_rows_.empty()) {
+            r = free_rows_.back();
+            free_rows_.pop_back();
+            rows_[e] = r;
+        } else {
+            r = matrix_.size() / sample_cnt_;
+            matrix_.resize(matrix_.size() + sample_cnt_);
+            rows_[e] = r;
+        }
+        std::copy(p.begin(), p.end(), matrix_.begin() + r * sample_cnt_);
+    }
+
+    AbundanceVector Normalize(const size_t *p, size_t length) const {
         AbundanceVector answer(sample_cnt_);
         for (size_t i = 0; i < sample_cnt_; ++i) {
             answer[i] = double(p[i]) / double(length);
@@ -32,7 +68,7 @@ class EdgeProfileStorage : public omnigraph::GraphActionHandler<Graph> {
         return answer;
     }
 
-    void Add(RawAbundanceVector &p, const RawAbundanceVector &to_add) const {
+    void Add(RawAbundanceVector &p, const size_t *to_add) const {
         for (size_t i = 0; i < sample_cnt_; ++i) {
             p[i] += to_add[i];
         }
@@ -57,14 +93,34 @@ class EdgeProfileStorage : public omnigraph::GraphActionHandler<Graph> {
         return total;
     }
 
+    // Reads are mapped in parallel in batches, every thread collects (row, coverage) hits of the batch
+    // in its own buffer, so the memory consumed is proportional to the batch rather than to the
+    // number of edges. Buffers are then added up into the sample column of the matrix.
     template<class SingleStream, class Mapper>
     void Fill(SingleStream &reader, size_t stream_id, const Mapper &mapper) {
-        typename SingleStream::ReadT read;
+        std::vector<std::vector<std::pair<size_t, size_t>>> hits(omp_get_max_threads());
+
+        std::vector<typename SingleStream::ReadT> reads;
         while (!reader.eof()) {
-            reader >> read;
+            reads.clear();
+            typename SingleStream::ReadT read;
+            while (reads.size() < READ_BATCH_SIZE && !reader.eof()) {
+                reader >> read;
+                reads.push_back(std::move(read));
+            }
+
+#           pragma omp parallel for schedule(guided)
+            for (size_t i = 0; i < reads.size(); ++i) {
+                auto &local = hits[omp_get_thread_num()];
+                for (const auto &e_mr: mapper.MapSequence(reads[i].sequence())) {
+                    local.emplace_back(utils::get(rows_, e_mr.first), e_mr.second.mapped_range.size());
+                }
+            }
 
-            for (const auto &e_mr: mapper.MapSequence(read.sequence())) {
-                profiles_[e_mr.first][stream_id] += e_mr.second.mapped_range.size();
+            for (auto &local : hits) {
+                for (const auto &r_c : local)
+                    matrix_[r_c.first * sample_cnt_ + stream_id] += r_c.second;
+                local.clear();
             }
         }
     };
@@ -77,11 +133,14 @@ public:
     template<class SingleStreamList, class Mapper>
     void Fill(SingleStreamList &streams, const Mapper &mapper) {
         //Initialize profiles
+        rows_.clear();
+        free_rows_.clear();
         for (auto it = g().ConstEdgeBegin(); !it.IsEnd(); ++it) {
-            profiles_[*it] = RawAbundanceVector(sample_cnt_, 0);
+            size_t r = rows_.size();
+            rows_[*it] = r;
         }
+        matrix_.assign(rows_.size() * sample_cnt_, 0);
 
-#       pragma omp parallel for
         for (size_t i = 0; i < sample_cnt_; ++i) {
             Fill(streams[i], i, mapper);
         }
@@ -92,7 +151,7 @@ public:
     }
 
     AbundanceVector profile(EdgeId e) const {
-        return Normalize(utils::get(profiles_, e), g().length(e));
+        return Normalize(row(e), g().length(e));
     }
 
     void HandleDelete(EdgeId e) override;
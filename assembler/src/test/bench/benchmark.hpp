@@ -0,0 +1,104 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "utils/perf/perfcounter.hpp"
+#include "utils/logger/logger.hpp"
+#include "utils/verify.hpp"
+
+#include <cppformat/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+struct Measurement {
+    std::string name;
+    std::string unit;
+    unsigned threads;
+    size_t items;
+    std::vector<double> times;
+
+    double min() const { return *std::min_element(times.begin(), times.end()); }
+    double max() const { return *std::max_element(times.begin(), times.end()); }
+    double mean() const { return std::accumulate(times.begin(), times.end(), 0.0) / double(times.size()); }
+    double median() const {
+        VERIFY(!times.empty());
+        std::vector<double> t(times);
+        std::sort(t.begin(), t.end());
+        size_t n = t.size();
+        return n % 2 ? t[n / 2] : (t[n / 2 - 1] + t[n / 2]) / 2;
+    }
+    double stddev() const {
+        double m = mean(), s = 0;
+        for (double t : times)
+            s += (t - m) * (t - m);
+        return times.size() > 1 ? std::sqrt(s / double(times.size() - 1)) : 0;
+    }
+    double throughput() const {
+        double t = median();
+        return t > 0 ? double(items) / t : 0;
+    }
+};
+
+// Runs setup() (untimed) followed by timed run(state) for warmup + repeats
+// iterations. run() returns the number of processed items, which is used to
+// report throughput and keeps the compiler from discarding the work.
+template<class Setup, class Run>
+Measurement Measure(const std::string &name, const std::string &unit, unsigned threads,
+                    unsigned warmup, unsigned repeats,
+                    Setup setup, Run run) {
+    VERIFY_MSG(repeats > 0, "Benchmark " << name << " needs at least one timed repeat");
+    Measurement res{name, unit, threads, 0, {}};
+    for (unsigned i = 0; i < warmup + repeats; ++i) {
+        auto state = setup();
+        utils::perf_counter pc;
+        size_t items = run(state);
+        double t = pc.time();
+        if (i < warmup)
+            continue;
+
+        res.items = items;
+        res.times.push_back(t);
+    }
+
+    INFO(fmt::format("{}: threads {}, {} {}, median {:.4f}s (min {:.4f}s, max {:.4f}s), {:.1f} {}/s",
+                     name, threads, res.items, unit, res.median(), res.min(), res.max(),
+                     res.throughput(), unit));
+    return res;
+}
+
+inline void WriteCSV(const std::string &filename, const std::vector<Measurement> &results) {
+    std::ofstream os(filename);
+    os << "name,threads,unit,items,repeats,min_s,median_s,mean_s,max_s,stddev_s,items_per_s\n";
+    for (const auto &m : results)
+        os << fmt::format("{},{},{},{},{},{:.6f},{:.6f},{:.6f},{:.6f},{:.6f},{:.3f}\n",
+                          m.name, m.threads, m.unit, m.items, m.times.size(),
+                          m.min(), m.median(), m.mean(), m.max(), m.stddev(), m.throughput());
+}
+
+inline void WriteJSON(const std::string &filename, const std::vector<Measurement> &results) {
+    std::ofstream os(filename);
+    os << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto &m = results[i];
+        os << fmt::format("  {{\"name\":\"{}\",\"threads\":{},\"unit\":\"{}\",\"items\":{},\"times\":[",
+                          m.name, m.threads, m.unit, m.items);
+        for (size_t j = 0; j < m.times.size(); ++j)
+            os << (j ? "," : "") << fmt::format("{:.6f}", m.times[j]);
+        os << fmt::format("],\"median_s\":{:.6f},\"items_per_s\":{:.3f}}}", m.median(), m.throughput())
+           << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    os << "]\n";
+}
+
+}
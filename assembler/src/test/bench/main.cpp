@@ -0,0 +1,444 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "modules/graph_construction.hpp"
+#include "modules/alignment/sequence_mapper.hpp"
+#include "stages/simplification_pipeline/graph_simplification.hpp"
+#include "assembly_graph/dijkstra/dijkstra_helper.hpp"
+#include "paired_info/concurrent_pair_info_buffer.hpp"
+#include "paired_info/thread_local_pair_info_buffer.hpp"
+#include "paired_info/paired_info.hpp"
+#include "pipeline/graph_pack.hpp"
+
+#include "io/reads/io_helper.hpp"
+#include "io/reads/vector_reader.hpp"
+#include "io/reads/rc_reader_wrapper.hpp"
+#include "io/reads/read_stream_vector.hpp"
+
+#include "utils/kmer_mph/kmer_index_builder.hpp"
+#include "utils/kmer_mph/kmer_splitters.hpp"
+#include "utils/ph_map/perfect_hash_map_builder.hpp"
+#include "utils/filesystem/temporary.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/logger/log_writers.hpp"
+#include "utils/segfault_handler.hpp"
+
+#include "benchmark.hpp"
+
+#include "version.hpp"
+
+#include <clipp/clipp.h>
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace debruijn_graph;
+
+namespace bench {
+
+struct Args {
+    unsigned k = 55;
+    size_t genome_size = 1000000;
+    double coverage = 30;
+    unsigned read_length = 150;
+    double error_rate = 0.002;
+    unsigned seed = 42;
+    std::string reads;
+    std::string threads = "1";
+    unsigned warmup = 1;
+    unsigned repeats = 5;
+    std::string workdir = "spades_bench.tmp";
+    std::string csv, json;
+    std::vector<std::string> only;
+};
+
+static void process_cmdline(int argc, char **argv, Args &args) {
+    using namespace clipp;
+    bool print_help = false;
+
+    auto cli = (
+        (option("-k", "--kmer") & integer("value", args.k)) % "k-mer length (default: 55)",
+        (option("-g", "--genome-size") & integer("value", args.genome_size)) % "synthetic genome size (default: 1000000)",
+        (option("-c", "--coverage") & number("value", args.coverage)) % "synthetic read coverage (default: 30)",
+        (option("-l", "--read-length") & integer("value", args.read_length)) % "synthetic read length (default: 150)",
+        (option("-e", "--error-rate") & number("value", args.error_rate)) % "substitution rate of synthetic reads (default: 0.002)",
+        (option("-s", "--seed") & integer("value", args.seed)) % "random seed (default: 42)",
+        (option("-r", "--reads") & value("file", args.reads)) % "use reads from file (e.g. test_dataset/ecoli_1K_1.fq.gz) instead of synthetic ones",
+        (option("-t", "--threads") & value("list", args.threads)) % "comma-separated thread counts to sweep (default: 1)",
+        (option("--warmup") & integer("value", args.warmup)) % "# of warm-up runs (default: 1)",
+        (option("--repeats") & integer("value", args.repeats)) % "# of measured runs (default: 5)",
+        (option("-w", "--workdir") & value("dir", args.workdir)) % "scratch directory (default: spades_bench.tmp)",
+        (option("--csv") & value("file", args.csv)) % "write results in CSV format",
+        (option("--json") & value("file", args.json)) % "write results in JSON format",
+        (option("-h", "--help").set(print_help)) % "show help",
+        opt_values("benchmarks", args.only)
+    );
+
+    auto result = parse(argc, argv, cli);
+    if (!result || print_help) {
+        std::cout << make_man_page(cli, argv[0])
+                .prepend_section("DESCRIPTION",
+                                 "SPAdes core benchmarks. Available benchmarks: kmer_counting, mphf_build, "
+                                 "graph_construction, map_sequence, paired_index_insert (incl. sort-merge variant), dijkstra, simplification "
+                                 "(all by default)");
+        exit(print_help ? 0 : 1);
+    }
+}
+
+static std::vector<unsigned> ParseThreads(const std::string &s) {
+    std::vector<unsigned> res;
+    std::istringstream is(s);
+    std::string token;
+    while (std::getline(is, token, ','))
+        res.push_back((unsigned)std::stoul(token));
+    VERIFY_MSG(!res.empty(), "Empty thread list");
+    return res;
+}
+
+static io::SingleRead MakeRead(const std::string &name, std::string seq) {
+    return io::SingleRead(name, seq, std::string(seq.size(), 'I'));
+}
+
+static std::vector<io::SingleRead> SimulateReads(const Args &args) {
+    static const char nucls[] = "ACGT";
+    std::mt19937_64 rnd(args.seed);
+    std::uniform_int_distribution<unsigned> base(0, 3);
+    std::uniform_real_distribution<double> err(0, 1);
+
+    std::string genome(args.genome_size, 'A');
+    for (char &c : genome)
+        c = nucls[base(rnd)];
+
+    VERIFY(args.genome_size >= args.read_length);
+    size_t nreads = size_t(args.coverage * double(args.genome_size) / double(args.read_length));
+    std::uniform_int_distribution<size_t> pos(0, args.genome_size - args.read_length);
+
+    std::vector<io::SingleRead> reads;
+    reads.reserve(nreads);
+    for (size_t i = 0; i < nreads; ++i) {
+        std::string read = genome.substr(pos(rnd), args.read_length);
+        for (char &c : read)
+            if (err(rnd) < args.error_rate)
+                c = nucls[(unsigned(dignucl(c)) + 1 + base(rnd) % 3) % 4];
+        if (base(rnd) & 1)
+            read = ReverseComplement(read);
+        reads.push_back(MakeRead(std::to_string(i), std::move(read)));
+    }
+
+    INFO("Simulated " << reads.size() << " reads of length " << args.read_length
+         << " from random genome of length " << args.genome_size);
+    return reads;
+}
+
+static std::vector<io::SingleRead> LoadReads(const Args &args) {
+    std::vector<io::SingleRead> reads;
+    auto stream = io::EasyStream(args.reads, /* followed_by_rc */ false);
+    io::SingleRead r;
+    while (!stream.eof()) {
+        stream >> r;
+        if (r.IsValid())
+            reads.push_back(r);
+    }
+    INFO("Loaded " << reads.size() << " reads from " << args.reads);
+    return reads;
+}
+
+static io::ReadStreamList<io::SingleRead> MakeStreams(const std::vector<io::SingleRead> &reads,
+                                                      unsigned nthreads) {
+    io::ReadStreamList<io::SingleRead> streams;
+    size_t chunk = (reads.size() + nthreads - 1) / nthreads;
+    for (size_t i = 0; i < nthreads; ++i) {
+        auto b = reads.begin() + std::min(reads.size(), i * chunk);
+        auto e = reads.begin() + std::min(reads.size(), (i + 1) * chunk);
+        streams.push_back(io::RCWrap<io::SingleRead>(
+            io::VectorReadStream<io::SingleRead>(std::vector<io::SingleRead>(b, e))));
+    }
+    return streams;
+}
+
+typedef utils::DeBruijnReadKMerSplitter<io::SingleRead,
+                                        utils::StoringTypeFilter<utils::SimpleStoring>> ReadSplitter;
+
+struct CountingState {
+    fs::TmpDir workdir;
+    io::ReadStreamList<io::SingleRead> streams;
+    std::unique_ptr<ReadSplitter> splitter;
+    std::unique_ptr<utils::KMerDiskCounter<RtSeq>> counter;
+
+    CountingState(const std::string &basedir, const std::vector<io::SingleRead> &reads,
+                  unsigned k, unsigned nthreads)
+            : workdir(fs::tmp::make_temp_dir(basedir, "counting")),
+              streams(MakeStreams(reads, nthreads)),
+              splitter(new ReadSplitter(workdir, k, 0xDEADBEEF, streams)),
+              counter(new utils::KMerDiskCounter<RtSeq>(workdir, *splitter)) {}
+};
+
+class BenchmarkSuite {
+  public:
+    BenchmarkSuite(const Args &args, std::vector<io::SingleRead> reads)
+            : args_(args), reads_(std::move(reads)) {}
+
+    void Run(unsigned nthreads) {
+        omp_set_num_threads((int)nthreads);
+
+        if (Enabled("kmer_counting"))
+            BenchKMerCounting(nthreads);
+        if (Enabled("mphf_build"))
+            BenchMPHFBuild(nthreads);
+        if (Enabled("graph_construction"))
+            BenchGraphConstruction(nthreads);
+        if (Enabled("map_sequence"))
+            BenchMapSequence(nthreads);
+        if (Enabled("paired_index_insert"))
+            BenchPairedIndexInsert(nthreads);
+        if (Enabled("dijkstra"))
+            BenchDijkstra(nthreads);
+        if (Enabled("simplification"))
+            BenchSimplification(nthreads);
+    }
+
+    const std::vector<Measurement> &results() const { return results_; }
+
+  private:
+    bool Enabled(const std::string &name) const {
+        return args_.only.empty() ||
+               std::find(args_.only.begin(), args_.only.end(), name) != args_.only.end();
+    }
+
+    void Add(Measurement m) { results_.push_back(std::move(m)); }
+
+    std::unique_ptr<conj_graph_pack> ConstructGraphPack(unsigned nthreads) const {
+        std::unique_ptr<conj_graph_pack> gp(new conj_graph_pack(args_.k, args_.workdir, 0));
+        auto workdir = fs::tmp::make_temp_dir(args_.workdir, "construction");
+        auto streams = MakeStreams(reads_, nthreads);
+        ConstructGraphWithCoverage(config::debruijn_config::construction(), workdir, streams,
+                                   gp->g, gp->index, gp->flanking_cov);
+        return gp;
+    }
+
+    // Graph used by read-only benchmarks, built once
+    const conj_graph_pack &SharedGraphPack() {
+        if (!shared_gp_) {
+            shared_gp_ = ConstructGraphPack((unsigned)omp_get_max_threads());
+            INFO("Graph constructed: " << shared_gp_->g.size() << " vertices, "
+                 << shared_gp_->g.e_size() << " edges");
+        }
+        return *shared_gp_;
+    }
+
+    void BenchKMerCounting(unsigned nthreads) {
+        Add(Measure("kmer_counting", "kmers", nthreads, args_.warmup, args_.repeats,
+                    [&] { return std::make_shared<CountingState>(args_.workdir, reads_, args_.k + 1, nthreads); },
+                    [&](std::shared_ptr<CountingState> &s) {
+                        s->counter->CountAll(nthreads, nthreads, /* merge */ false);
+                        return s->counter->kmers();
+                    }));
+    }
+
+    void BenchMPHFBuild(unsigned nthreads) {
+        typedef utils::KeyIteratingMap<RtSeq, uint32_t> Index;
+        Add(Measure("mphf_build", "kmers", nthreads, args_.warmup, args_.repeats,
+                    [&] {
+                        auto s = std::make_shared<CountingState>(args_.workdir, reads_, args_.k + 1, nthreads);
+                        s->counter->CountAll(nthreads, nthreads, /* merge */ false);
+                        return s;
+                    },
+                    [&](std::shared_ptr<CountingState> &s) {
+                        Index index(args_.k + 1);
+                        utils::BuildIndex(index, *s->counter, nthreads, nthreads, /* save_final */ false);
+                        return index.size();
+                    }));
+    }
+
+    void BenchGraphConstruction(unsigned nthreads) {
+        Add(Measure("graph_construction", "reads", nthreads, args_.warmup, args_.repeats,
+                    [&] { return std::make_shared<conj_graph_pack>(args_.k, args_.workdir, 0); },
+                    [&](std::shared_ptr<conj_graph_pack> &gp) {
+                        auto workdir = fs::tmp::make_temp_dir(args_.workdir, "construction");
+                        auto streams = MakeStreams(reads_, nthreads);
+                        ConstructGraphWithCoverage(config::debruijn_config::construction(), workdir, streams,
+                                                   gp->g, gp->index, gp->flanking_cov);
+                        return reads_.size();
+                    }));
+    }
+
+    void BenchMapSequence(unsigned nthreads) {
+        const auto &gp = SharedGraphPack();
+        auto mapper = MapperInstance(gp);
+        Add(Measure("map_sequence", "reads", nthreads, args_.warmup, args_.repeats,
+                    [] { return 0; },
+                    [&](int) {
+                        size_t mapped = 0;
+#                       pragma omp parallel for num_threads(nthreads) schedule(guided) reduction(+:mapped)
+                        for (size_t i = 0; i < reads_.size(); ++i)
+                            mapped += mapper->MapSequence(reads_[i].sequence()).size() > 0;
+                        VERIFY(mapped <= reads_.size());
+                        return reads_.size();
+                    }));
+    }
+
+    void BenchPairedIndexInsert(unsigned nthreads) {
+        typedef omnigraph::de::ConcurrentPairedInfoBuffer<Graph> Buffer;
+        typedef omnigraph::de::UnclusteredPairedInfoIndexT<Graph> Index;
+
+        const auto &gp = SharedGraphPack();
+        std::vector<EdgeId> edges;
+        for (EdgeId e : gp.g.edges())
+            edges.push_back(e);
+        VERIFY(!edges.empty());
+
+        // Mimic pair info filling: pairs of edges close in the graph get many
+        // points at a handful of distances
+        struct Record { EdgeId e1, e2; float d, w; };
+        std::vector<Record> records(reads_.size());
+        std::mt19937_64 rnd(args_.seed);
+        std::uniform_int_distribution<size_t> edge(0, edges.size() - 1);
+        std::uniform_int_distribution<int> dist(0, 2 * (int)args_.read_length);
+        for (auto &r : records) {
+            EdgeId e1 = edges[edge(rnd)];
+            VertexId v = gp.g.EdgeEnd(e1);
+            EdgeId e2 = gp.g.OutgoingEdgeCount(v) ? *gp.g.OutgoingEdges(v).begin() : e1;
+            r = { e1, e2, float(dist(rnd)), 1.0f };
+        }
+
+        Add(Measure("paired_index_insert", "points", nthreads, args_.warmup, args_.repeats,
+                    [&] { return std::make_shared<std::pair<Buffer, Index>>(gp.g, gp.g); },
+                    [&](std::shared_ptr<std::pair<Buffer, Index>> &s) {
+#                       pragma omp parallel for num_threads(nthreads) schedule(static)
+                        for (size_t i = 0; i < records.size(); ++i) {
+                            const auto &r = records[i];
+                            s->first.Add(r.e1, r.e2, omnigraph::de::RawPoint(r.d, r.w));
+                        }
+                        s->second.Merge(s->first);
+                        return records.size();
+                    }));
+
+        // Same workload through per-thread buffers merged via sorting
+        typedef omnigraph::de::ThreadLocalPairedBuffer<Graph> LocalBuffer;
+        size_t expected_size = 0;
+        {
+            Buffer buffer(gp.g);
+            Index index(gp.g);
+            for (const auto &r : records)
+                buffer.Add(r.e1, r.e2, omnigraph::de::RawPoint(r.d, r.w));
+            index.Merge(buffer);
+            expected_size = index.size();
+        }
+        Add(Measure("paired_index_sort_merge", "points", nthreads, args_.warmup, args_.repeats,
+                    [&] { return std::make_shared<std::pair<LocalBuffer, Index>>(gp.g, gp.g); },
+                    [&](std::shared_ptr<std::pair<LocalBuffer, Index>> &s) {
+                        s->first.Init(nthreads);
+#                       pragma omp parallel for num_threads(nthreads) schedule(static)
+                        for (size_t i = 0; i < records.size(); ++i) {
+                            const auto &r = records[i];
+                            s->first.Add(omp_get_thread_num(), r.e1, r.e2, omnigraph::de::RawPoint(r.d, r.w));
+                        }
+                        s->first.MergeInto(s->second);
+                        VERIFY(s->second.size() == expected_size);
+                        return records.size();
+                    }));
+    }
+
+    void BenchDijkstra(unsigned nthreads) {
+        const auto &g = SharedGraphPack().g;
+        std::vector<VertexId> vertices;
+        for (VertexId v : g)
+            vertices.push_back(v);
+        size_t bound = 5 * args_.read_length;
+
+        Add(Measure("dijkstra", "runs", nthreads, args_.warmup, args_.repeats,
+                    [] { return 0; },
+                    [&](int) {
+                        size_t reached = 0;
+#                       pragma omp parallel for num_threads(nthreads) schedule(guided) reduction(+:reached)
+                        for (size_t i = 0; i < vertices.size(); ++i) {
+                            auto dijkstra = omnigraph::DijkstraHelper<Graph>::CreateBoundedDijkstra(g, bound, 1000);
+                            dijkstra.Run(vertices[i]);
+                            reached += dijkstra.ReachedVertices().size();
+                        }
+                        VERIFY(reached >= vertices.size());
+                        return vertices.size();
+                    }));
+    }
+
+    void BenchSimplification(unsigned nthreads) {
+        config::debruijn_config::simplification::tip_clipper tc_config;
+        tc_config.condition = "{ tc_lb 3.5 , cb 1000000 , rctc 2.0 }";
+
+        config::debruijn_config::simplification::bulge_remover br_config;
+        br_config.enabled = true;
+        br_config.main_iteration_only = false;
+        br_config.max_bulge_length_coefficient = 4;
+        br_config.max_additive_length_coefficient = 0;
+        br_config.max_coverage = 1000.;
+        br_config.max_relative_coverage = 1.1;
+        br_config.max_delta = 3;
+        br_config.max_number_edges = std::numeric_limits<size_t>::max();
+        br_config.dijkstra_vertex_limit = std::numeric_limits<size_t>::max();
+        br_config.max_relative_delta = 0.1;
+        br_config.parallel = nthreads > 1;
+        br_config.buff_size = 10000;
+        br_config.buff_cov_diff = 2.;
+        br_config.buff_cov_rel_diff = 0.2;
+
+        debruijn::simplification::SimplifInfoContainer info(config::pipeline_type::base);
+        info.set_read_length(args_.read_length)
+            .set_detected_coverage_bound(args_.coverage)
+            .set_main_iteration(true)
+            .set_chunk_cnt(nthreads * 16);
+
+        Add(Measure("simplification", "edges", nthreads, args_.warmup, args_.repeats,
+                    [&] { return std::shared_ptr<conj_graph_pack>(ConstructGraphPack(nthreads)); },
+                    [&](std::shared_ptr<conj_graph_pack> &gp) {
+                        size_t edges = gp->g.e_size();
+                        debruijn::simplification::TipClipperInstance(gp->g, tc_config, info)->Run();
+                        debruijn::simplification::BRInstance(gp->g, br_config, info)->Run();
+                        return edges;
+                    }));
+    }
+
+    const Args &args_;
+    std::vector<io::SingleRead> reads_;
+    std::unique_ptr<conj_graph_pack> shared_gp_;
+    std::vector<Measurement> results_;
+};
+
+}
+
+static void create_console_logger() {
+    using namespace logging;
+
+    logger *lg = create_logger("");
+    lg->add_writer(std::make_shared<console_writer>());
+    attach_logger(lg);
+}
+
+int main(int argc, char **argv) {
+    utils::segfault_handler sh;
+    bench::Args args;
+    bench::process_cmdline(argc, argv, args);
+
+    create_console_logger();
+    START_BANNER("SPAdes core benchmarks");
+
+    auto threads = bench::ParseThreads(args.threads);
+    unsigned max_threads = *std::max_element(threads.begin(), threads.end());
+    spades_set_omp_threads(max_threads);
+
+    fs::make_dirs(args.workdir);
+    bench::BenchmarkSuite suite(args, args.reads.empty() ? bench::SimulateReads(args) : bench::LoadReads(args));
+    for (unsigned t : threads)
+        suite.Run(t);
+
+    if (!args.csv.empty())
+        bench::WriteCSV(args.csv, suite.results());
+    if (!args.json.empty())
+        bench::WriteJSON(args.json, suite.results());
+
+    return 0;
+}
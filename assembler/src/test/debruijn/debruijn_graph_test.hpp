@@ -10,6 +10,9 @@
 #include <boost/test/unit_test.hpp>
 
 #include "test_utils.hpp"
+#include "random_graph.hpp"
+#include "assembly_graph/paths/path_processor.hpp"
+#include "assembly_graph/paths/reachable_lengths.hpp"
 
 namespace debruijn_graph {
 
@@ -227,6 +230,38 @@ BOOST_AUTO_TEST_CASE( TestSelfRCEdgeMerge ) {
     BOOST_CHECK_EQUAL(Sequence("AACGCTATTCACGTGAATAGCGTT"), g.EdgeNucls(g.GetUniqueOutgoingEdge(v1)));
 }
 
+BOOST_AUTO_TEST_CASE( ReachableLengthsMatchPathEnumeration ) {
+    srand(42);
+    size_t k = 11;
+    Graph g(k);
+    std::vector<VertexId> vertices;
+    for (size_t i = 0; i < 8; ++i)
+        vertices.push_back(g.AddVertex());
+    // Random graph with cycles and parallel edges
+    for (size_t i = 0; i < 14; ++i) {
+        VertexId v1 = vertices[rand() % vertices.size()], v2 = vertices[rand() % vertices.size()];
+        g.AddEdge(v1, v2, RandomSequence(k + 1 + rand() % 30));
+    }
+
+    size_t max_len = 150;
+    for (VertexId start : g) {
+        omnigraph::ReachableLengths<Graph> reachable(g, start, max_len);
+        omnigraph::PathProcessor<Graph> processor(g, start, max_len);
+        for (VertexId end : g) {
+            for (size_t min_len : { size_t(0), size_t(40) }) {
+                omnigraph::DistancesLengthsCallback<Graph> callback(g);
+                int error_code = processor.Process(end, min_len, max_len, callback);
+                auto enumerated = callback.distances(), lengths = reachable.Lengths(end, min_len);
+                // Enumeration might be cut by its limits, then it finds only a part of lengths
+                if (error_code)
+                    BOOST_CHECK(std::includes(lengths.begin(), lengths.end(), enumerated.begin(), enumerated.end()));
+                else
+                    BOOST_CHECK(enumerated == lengths);
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
@@ -0,0 +1,129 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "math/fft.hpp"
+#include "paired_info/peak_finder.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <complex>
+
+namespace math {
+
+namespace {
+
+typedef std::complex<double> complex_t;
+
+//Textbook transform with exp(sign * 2 pi i k t / n), the inverse one (sign < 0) is divided by n
+std::vector<complex_t> NaiveDFT(const std::vector<complex_t> &x, double sign) {
+    size_t n = x.size();
+    std::vector<complex_t> res(n);
+    for (size_t k = 0; k < n; ++k) {
+        for (size_t t = 0; t < n; ++t)
+            res[k] += x[t] * std::polar(1., sign * 2 * M_PI * (double) ((k * t) % n) / (double) n);
+        if (sign < 0)
+            res[k] /= (double) n;
+    }
+    return res;
+}
+
+std::vector<double> RandomSignal(size_t n) {
+    std::vector<double> x(n);
+    for (auto &v : x)
+        v = (double) (rand() % 2001 - 1000) / 100.;
+    return x;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(fft_tests)
+
+BOOST_AUTO_TEST_CASE(TestRealFFTAgainstDFT) {
+    for (size_t n = 2; n <= 512; n <<= 1) {
+        RealFFTPlan plan(n);
+        auto x = RandomSignal(n);
+        std::vector<double> re(n / 2 + 1), im(n / 2 + 1);
+        plan.Forward(x.data(), re.data(), im.data());
+
+        auto expected = NaiveDFT(std::vector<complex_t>(x.begin(), x.end()), 1.);
+        for (size_t k = 0; k <= n / 2; ++k) {
+            BOOST_CHECK_SMALL(re[k] - expected[k].real(), 1e-8);
+            BOOST_CHECK_SMALL(im[k] - expected[k].imag(), 1e-8);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestRealFFTRoundTrip) {
+    for (size_t n = 2; n <= 4096; n <<= 1) {
+        const RealFFTPlan &plan = RealFFTPlan::Get(n);
+        BOOST_CHECK_EQUAL(plan.size(), n);
+        auto x = RandomSignal(n);
+        std::vector<double> re(n / 2 + 1), im(n / 2 + 1), y(n);
+        plan.Forward(x.data(), re.data(), im.data());
+        plan.Backward(re.data(), im.data(), y.data());
+        for (size_t i = 0; i < n; ++i)
+            BOOST_CHECK_SMALL(x[i] - y[i], 1e-9);
+    }
+}
+
+//Smoothing of histograms of any length (padded to a power of two) against the complex transform
+BOOST_AUTO_TEST_CASE(TestPeakFinderSmoothing) {
+    typedef omnigraph::de::PairInfo<int> PairInfo;
+    const double cutoff = 20, percentage = 0.01;
+
+    for (size_t len : { 1, 2, 3, 7, 16, 33, 100, 129 }) {
+        std::vector<PairInfo> data;
+        for (size_t i = 0; i < len; ++i)
+            data.emplace_back(1, 2, (double) (i + 100), (double) (rand() % 100 + 1), 0.);
+
+        omnigraph::de::PeakFinder<int> smoothed(data, 0, len, 0, 0, percentage, 0);
+        omnigraph::de::PeakFinder<int> original(data, 0, len, 0, 0, percentage, 0);
+        smoothed.FFTSmoothing(cutoff);
+
+        //Same steps as in PeakFinder, done by the definition
+        std::vector<double> hist(original.getIn().begin(), original.getIn().begin() + len);
+        std::vector<double> expected(hist);
+        if (len == 1) {
+            expected[0] = data[0].weight();
+        } else {
+            size_t np = std::max<size_t>(1, (size_t) ((double) len * percentage));
+            double y1 = 0, y2 = 0;
+            for (size_t i = 0; i < np; ++i) {
+                y1 += hist[i] / (double) np;
+                y2 += hist[len - i - 1] / (double) np;
+            }
+            double x1 = (double) np / 2., x2 = (double) len - (double) np / 2.;
+            auto baseline = [&](size_t i) { return y1 + (y2 - y1) * ((double) i - x1) / (x2 - x1); };
+
+            size_t n = 1;
+            while (n < len)
+                n <<= 1;
+            std::vector<complex_t> spectrum(n);
+            for (size_t i = 0; i < len; ++i)
+                spectrum[i] = hist[i] - baseline(i);
+            spectrum = NaiveDFT(spectrum, 1.);
+
+            size_t ncrit = (size_t) cutoff;
+            for (size_t i = 0; i < len && i < ncrit; ++i)
+                spectrum[i] *= 1. - ((double) i * (double) i) / (double) (ncrit * ncrit);
+            for (size_t i = ncrit; i < n; ++i)
+                spectrum[i] = 0.;
+
+            spectrum = NaiveDFT(spectrum, -1.);
+            for (size_t i = 0; i < len; ++i)
+                expected[i] = spectrum[i].real() + baseline(i);
+        }
+
+        for (size_t i = 0; i < len; ++i)
+            BOOST_CHECK_SMALL(smoothed.getOut()[i] - expected[i], 1e-8);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
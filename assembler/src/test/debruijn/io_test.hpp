@@ -115,5 +115,38 @@ BOOST_AUTO_TEST_CASE(TestKmerMapperIO) {
     CompareContainers(kmer_mapper, new_mapper);
 }
 
+BOOST_AUTO_TEST_CASE(TestCompressedIO) {
+    typedef std::vector<uint64_t> Data;
+    //spans several compressed blocks
+    Data data(3 << 19);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (i * i) ^ (i >> 3);
+
+    for (const Data &value : { data, Data() }) {
+        for (bool compress : { false, true }) {
+            IOSingleDefault<Data> io("vector", ".vec");
+            io.SetCompression(compress);
+            io.Save("tmp/vector", value);
+
+            BlockCompressedIFStream probe(io.FileName("tmp/vector"));
+            BOOST_CHECK_EQUAL(probe.compressed(), compress);
+
+            Data loaded(1);
+            BOOST_CHECK(io.Load("tmp/vector", loaded));
+            BOOST_CHECK(loaded == value);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestEmptyFileIO) {
+    IOSingleDefault<std::vector<uint64_t>> io("vector", ".vec");
+    io.SaveEmpty("tmp/vector");
+
+    std::vector<uint64_t> loaded(1, 42);
+    BOOST_CHECK(!io.Load("tmp/vector", loaded));
+    BOOST_CHECK_EQUAL(loaded.size(), 1);
+    BOOST_CHECK_EQUAL(loaded[0], 42);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
@@ -0,0 +1,232 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "test_utils.hpp"
+#include "random_graph.hpp"
+#include "modules/alignment/kmer_mapper.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+namespace debruijn_graph {
+
+namespace {
+
+template<class Map>
+std::vector<std::pair<RtSeq, RtSeq>> Entries(const Map &map) {
+    return std::vector<std::pair<RtSeq, RtSeq>>(map.begin(), map.end());
+}
+
+//Pairs of sequences with chains of remaps and remaps back
+std::vector<std::pair<Sequence, Sequence>> RemapBatch(size_t k, size_t cnt) {
+    std::vector<Sequence> seqs;
+    for (size_t i = 0; i < cnt; ++i)
+        seqs.push_back(RandomSequence(rand() % 200 + k));
+
+    std::vector<std::pair<Sequence, Sequence>> batch;
+    for (size_t i = 0; i + 1 < seqs.size(); ++i) {
+        if (seqs[i].size() == seqs[i + 1].size())
+            continue;
+        batch.emplace_back(seqs[i], seqs[i + 1]);
+        if (i % 3 == 0)
+            batch.emplace_back(seqs[i + 1], seqs[i]);
+    }
+    return batch;
+}
+
+RtSeq RandomKmer(size_t k) {
+    return RtSeq(k, RandomSequence(k));
+}
+
+//Random k-mer with the given home slot in the table of given capacity
+RtSeq KmerWithHome(size_t k, size_t home, size_t capacity) {
+    RtSeq kmer = RandomKmer(k);
+    while ((kmer.GetHash() & (capacity - 1)) != home)
+        kmer = RandomKmer(k);
+    return kmer;
+}
+
+template<class Map>
+void CheckSame(const KMerMap &map, const Map &expected) {
+    BOOST_CHECK_EQUAL(map.size(), expected.size());
+    for (const auto &entry : expected) {
+        const auto *value = map.find(entry.first);
+        BOOST_REQUIRE(value != nullptr);
+        BOOST_CHECK_EQUAL(RtSeq(entry.first.size(), value), entry.second);
+    }
+    for (const auto &entry : map)
+        BOOST_CHECK(expected.count(entry.first));
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(kmer_map_tests)
+
+//Single shard of 16 slots with the cluster 14, 15, 0, 1 wrapping around the end
+BOOST_AUTO_TEST_CASE(TestKmerMapWrapAroundErase) {
+    const size_t k = 21, capacity = 16;
+    for (size_t attempt = 0; attempt < 10; ++attempt) {
+        KMerMap map(k, 0);
+        std::map<RtSeq, RtSeq> expected;
+        for (size_t home : { 14, 15, 15, 0 }) {
+            RtSeq key = KmerWithHome(k, home, capacity), value = RandomKmer(k);
+            map.set(key, value);
+            expected[key] = value;
+        }
+        CheckSame(map, expected);
+
+        //Erase in random order, the rest should be reachable after every backward shift
+        std::vector<RtSeq> keys;
+        for (const auto &entry : expected)
+            keys.push_back(entry.first);
+        std::random_shuffle(keys.begin(), keys.end());
+        for (const auto &key : keys) {
+            map.erase(key);
+            expected.erase(key);
+            BOOST_CHECK(!map.count(key));
+            CheckSame(map, expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestKmerMapOverwrite) {
+    const size_t k = 33;
+    KMerMap map(k);
+    RtSeq key = RandomKmer(k), value1 = RandomKmer(k), value2 = RandomKmer(k);
+    map.set(key, value1);
+    map.set(key, value2);
+    BOOST_CHECK_EQUAL(map.size(), 1);
+    BOOST_CHECK_EQUAL(RtSeq(k, map.find(key)), value2);
+}
+
+//Growth of the shards with interleaved erases against std::map
+BOOST_AUTO_TEST_CASE(TestKmerMapRehash) {
+    const size_t k = 55;
+    for (unsigned shard_bits : { 0, 3 }) {
+        KMerMap map(k, shard_bits);
+        std::map<RtSeq, RtSeq> expected;
+        std::vector<RtSeq> keys;
+        for (size_t i = 0; i < 20000; ++i) {
+            if (!keys.empty() && rand() % 4 == 0) {
+                size_t idx = rand() % keys.size();
+                map.erase(keys[idx]);
+                expected.erase(keys[idx]);
+                std::swap(keys[idx], keys.back());
+                keys.pop_back();
+            } else {
+                RtSeq key = RandomKmer(k), value = RandomKmer(k);
+                map.set(key, value);
+                expected[key] = value;
+                keys.push_back(key);
+            }
+        }
+        CheckSame(map, expected);
+        BOOST_CHECK_EQUAL(Entries(map).size(), expected.size());
+    }
+}
+
+//Long chain, branches into its middle and chains crossing the shards
+BOOST_AUTO_TEST_CASE(TestKmerMapNormalize) {
+    const size_t k = 21;
+    KMerMap map(k, 2);
+    std::vector<RtSeq> chain;
+    for (size_t i = 0; i < 1000; ++i)
+        chain.push_back(RandomKmer(k));
+    for (size_t i = 0; i + 1 < chain.size(); ++i)
+        map.set(chain[i], chain[i + 1]);
+
+    std::vector<RtSeq> branch;
+    for (size_t i = 0; i < 100; ++i) {
+        branch.push_back(RandomKmer(k));
+        map.set(branch.back(), chain[rand() % (chain.size() - 1)]);
+    }
+    RtSeq single = RandomKmer(k), target = RandomKmer(k);
+    map.set(single, target);
+
+    map.Normalize();
+    BOOST_CHECK_EQUAL(map.size(), chain.size() - 1 + branch.size() + 1);
+    for (size_t i = 0; i + 1 < chain.size(); ++i)
+        BOOST_CHECK_EQUAL(RtSeq(k, map.find(chain[i])), chain.back());
+    for (const auto &kmer : branch)
+        BOOST_CHECK_EQUAL(RtSeq(k, map.find(kmer)), chain.back());
+    BOOST_CHECK_EQUAL(RtSeq(k, map.find(single)), target);
+}
+
+BOOST_AUTO_TEST_CASE(TestKmerMapBinaryRoundTrip) {
+    const size_t k = 33;
+    KMerMap map(k);
+    for (size_t i = 0; i < 5000; ++i)
+        map.set(RandomKmer(k), RandomKmer(k));
+    for (size_t i = 0; i < 1000; ++i)
+        map.erase(map.begin()->first);
+
+    std::stringstream ss;
+    map.BinWrite(ss);
+    KMerMap loaded(k);
+    loaded.set(RandomKmer(k), RandomKmer(k));
+    loaded.BinRead(ss);
+
+    //Same entries in the same order
+    BOOST_CHECK_EQUAL(loaded.size(), map.size());
+    BOOST_CHECK(Entries(loaded) == Entries(map));
+}
+
+//Files written before the format marker start with 32-bit number of entries
+BOOST_AUTO_TEST_CASE(TestKmerMapLegacyFormat) {
+    const size_t k = 21;
+    std::map<RtSeq, RtSeq> expected;
+    for (size_t i = 0; i < 100; ++i)
+        expected[RandomKmer(k)] = RandomKmer(k);
+
+    std::stringstream ss;
+    uint32_t sz = (uint32_t) expected.size();
+    ss.write((const char *) &sz, sizeof(sz));
+    for (const auto &entry : expected) {
+        ss.write((const char *) entry.first.data(), RtSeq::GetDataSize(k) * sizeof(RtSeq::DataType));
+        ss.write((const char *) entry.second.data(), RtSeq::GetDataSize(k) * sizeof(RtSeq::DataType));
+    }
+
+    KMerMap map(k);
+    map.BinRead(ss);
+    CheckSame(map, expected);
+}
+
+BOOST_AUTO_TEST_CASE(TestKmerMapperBatchRemap) {
+    Graph graph(21);
+    KmerMapper<Graph> single(graph), batched(graph);
+    auto batch = RemapBatch(single.k(), 300);
+
+    for (const auto &pair : batch)
+        single.RemapKmers(pair.first, pair.second);
+    batched.RemapKmers(batch);
+
+    BOOST_CHECK(single.size() > 0);
+    BOOST_CHECK_EQUAL(single.size(), batched.size());
+    BOOST_CHECK(Entries(single) == Entries(batched));
+}
+
+BOOST_AUTO_TEST_CASE(TestKmerMapperConcurrentRemap) {
+    Graph graph(21);
+    KmerMapper<Graph> mapper(graph);
+    auto batch = RemapBatch(mapper.k(), 1000);
+
+    //Remaps of every pair (and its reverse) are submitted concurrently
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(4)
+    for (size_t i = 0; i < batch.size(); ++i)
+        mapper.RemapKmers(batch[i].first, batch[i].second);
+
+    //No cycles of substitutions
+    mapper.Normalize();
+    for (const auto &entry : mapper) {
+        BOOST_CHECK(!mapper.CanSubstitute(entry.second));
+        BOOST_CHECK_EQUAL(mapper.Substitute(entry.first), entry.second);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -8,6 +8,10 @@
 #pragma once
 #include <boost/test/unit_test.hpp>
 #include "sequence/nucl.hpp"
+#include "sequence/nucl_kernels.hpp"
+
+#include <string>
+#include <vector>
 
 BOOST_AUTO_TEST_CASE( TestNucl ) {
     BOOST_CHECK_EQUAL('A', nucl(0));
@@ -33,3 +37,26 @@ BOOST_AUTO_TEST_CASE( TestNucl ) {
     BOOST_CHECK(!is_nucl('0'));
     BOOST_CHECK(!is_nucl('1'));
 }
+
+BOOST_AUTO_TEST_CASE( TestNuclKernels ) {
+    const std::string s = "ACGTTGCAacgtNACGTACGTACGTTTTTGGGGCCCCAAAAACGTACGTACGTAGCTAGCTAGCTTAGC";
+    BOOST_CHECK(nucl_kernels::AllNucls(s.data(), 12));
+    BOOST_CHECK(!nucl_kernels::AllNucls(s.data(), 13));
+
+    const std::string t = s.substr(13);
+    std::string rc(t.rbegin(), t.rend());
+    for (auto &c : rc)
+        c = nucl_complement(c);
+
+    std::vector<uint64_t> packed(2), packed_rc(2), rc_of_packed(2);
+    nucl_kernels::Pack(t, 0, t.size(), packed.data());
+    nucl_kernels::PackRC(t, 0, t.size(), packed_rc.data());
+    nucl_kernels::ReverseComplement(packed.data(), t.size(), rc_of_packed.data());
+    BOOST_CHECK(packed_rc == rc_of_packed);
+
+    std::string unpacked(t.size(), '-'), unpacked_rc(t.size(), '-');
+    nucl_kernels::Unpack(packed.data(), 0, t.size(), &unpacked[0]);
+    nucl_kernels::Unpack(packed_rc.data(), 0, t.size(), &unpacked_rc[0]);
+    BOOST_CHECK_EQUAL(t, unpacked);
+    BOOST_CHECK_EQUAL(rc, unpacked_rc);
+}